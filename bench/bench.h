@@ -0,0 +1,82 @@
+/* bench.h -- what the benchmarks share
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+/* The clock, and a stand-in for x_window. core-bench also defines
+   BENCH_COUNT_ALLOCS and includes this ahead of the modules it builds,
+   so that they allocate through counting wrappers. Only their own
+   calls are counted, not pixman's. */
+
+#ifndef BENCH_H
+#define BENCH_H 1
+
+#include "x-chain.h"
+#include "x-stack.h"
+#include "x-grid.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+static inline double
+now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Stands in for x_window: where it is, and the nodes the modules keep
+   it on. Each benchmark uses the parts it needs. Levels are in
+   stacking order, as used by -[x_screen raise_windows:count:]. */
+typedef struct window_struct window;
+
+struct window_struct {
+    X11Rect frame;
+    int level;
+    int mapped;
+    x_chain_node window_node;
+    x_stack_node stack_node;
+    x_grid_item grid_item;
+    x_chain_node transient_node;
+    x_chain transients;
+    window *transient_for;
+    unsigned int visit_stamp;
+};
+
+#ifdef BENCH_COUNT_ALLOCS
+
+extern unsigned long bench_mallocs;
+
+extern void *bench_malloc (size_t size);
+extern void *bench_calloc (size_t n, size_t size);
+extern void *bench_realloc (void *ptr, size_t size);
+
+#define malloc(size) bench_malloc (size)
+#define calloc(n, size) bench_calloc (n, size)
+#define realloc(ptr, size) bench_realloc (ptr, size)
+
+#endif /* BENCH_COUNT_ALLOCS */
+
+#endif /* BENCH_H */
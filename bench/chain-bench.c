@@ -0,0 +1,177 @@
+/* chain-bench.c -- the window list, as a cons list and as an x_chain
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench.h"
+#include "x-list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_WINDOWS 200
+#define N_OPS 200000
+
+static window windows[N_WINDOWS];
+
+/* What each step does: 0 maps or unmaps a window, 1 publishes the
+   client list (needing its length), 2 cycles windows with Cmd-` */
+static int plan_op[N_OPS], plan_id[N_OPS];
+
+static void
+make_plan (void)
+{
+    int i;
+
+    for (i = 0; i < N_OPS; i++)
+    {
+        plan_op[i] = rand () % 3;
+        plan_id[i] = rand () % N_WINDOWS;
+    }
+}
+
+static void *
+list_next (x_list *lst, void *item)
+{
+    x_list *node = x_list_find (lst, item);
+
+    if (node != NULL)
+        node = node->next != NULL ? node->next : lst;
+
+    return node != NULL && node->data != item ? node->data : NULL;
+}
+
+static void
+bench_list (void)
+{
+    x_list *lst = NULL, *copy;
+    unsigned long sum = 0, allocated;
+    double start, elapsed;
+    int i;
+
+    for (i = 0; i < N_WINDOWS; i++)
+        windows[i].mapped = 0;
+
+    allocated = x_list_nodes_allocated;
+    start = now ();
+
+    for (i = 0; i < N_OPS; i++)
+    {
+        window *w = &windows[plan_id[i]];
+
+        switch (plan_op[i])
+        {
+        case 0:
+            if (w->mapped)
+                lst = x_list_remove (lst, w);
+            else
+                lst = x_list_append (lst, w);
+            w->mapped = !w->mapped;
+            break;
+        case 1:
+            sum += x_list_length (lst);
+            break;
+        case 2:
+            if (w->mapped)
+            {
+                copy = x_list_reverse (x_list_copy (lst));
+                sum += list_next (copy, w) != NULL;
+                x_list_free (copy);
+            }
+            break;
+        }
+    }
+
+    elapsed = now () - start;
+
+    printf ("x_list:  %.3f us/op, %lu nodes allocated (%lu)\n",
+            elapsed * 1e6 / N_OPS, x_list_nodes_allocated - allocated, sum);
+
+    x_list_free (lst);
+}
+
+static void
+bench_chain (void)
+{
+    x_chain chain;
+    unsigned long sum = 0, allocated;
+    double start, elapsed;
+    int i;
+
+    x_chain_init (&chain);
+    for (i = 0; i < N_WINDOWS; i++)
+    {
+        x_chain_node_init (&windows[i].window_node, &windows[i]);
+        windows[i].mapped = 0;
+    }
+
+    allocated = x_list_nodes_allocated;
+    start = now ();
+
+    for (i = 0; i < N_OPS; i++)
+    {
+        window *w = &windows[plan_id[i]];
+        x_chain_node *node;
+
+        switch (plan_op[i])
+        {
+        case 0:
+            if (w->mapped)
+                x_chain_remove (&chain, &w->window_node);
+            else
+                x_chain_append (&chain, &w->window_node);
+            w->mapped = !w->mapped;
+            break;
+        case 1:
+            sum += chain.length;
+            break;
+        case 2:
+            node = x_chain_cycle (&chain, &w->window_node, 1);
+            sum += node != NULL && node != &w->window_node;
+            break;
+        }
+    }
+
+    elapsed = now () - start;
+
+    printf ("x_chain: %.3f us/op, %lu nodes allocated (%lu)\n",
+            elapsed * 1e6 / N_OPS, x_list_nodes_allocated - allocated, sum);
+
+    x_chain_clear (&chain);
+}
+
+int
+main (int argc, char **argv)
+{
+    srand (argc > 1 ? atoi (argv[1]) : 1);
+    make_plan ();
+
+    bench_list ();
+    bench_chain ();
+
+    return 0;
+}
@@ -0,0 +1,544 @@
+/* core-bench.c -- how the window management algorithms scale
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* So that the modules' allocations can be counted, they're built
+   here rather than linked in */
+#define BENCH_COUNT_ALLOCS 1
+#include "bench.h"
+#include "x-list.c"
+#include "x-chain.c"
+#include "x-tree.c"
+#include "x-stack.c"
+#include "x-grid.c"
+#include "x-hash.c"
+#include "x-usable.c"
+#include "x11-geometry.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Runs the algorithms behind window placement, validation, raising and
+   the transient forest on synthetic sets of 10, 100 and 1000 windows,
+   on screens of 1, 2 and 4 heads, with nothing talking to a server.
+   Prints one tab-separated line per result:
+
+     benchmark  windows  heads  ns_per_op  mallocs_per_op  nodes_per_op
+
+   where heads is 0 if the layout doesn't come into it, mallocs counts
+   the calls the modules make to malloc and friends and nodes the
+   x_list nodes they take from the pool. */
+
+#define MAX_WINDOWS 1000
+#define MAX_HEADS 4
+#define MAX_GROUP 3
+
+/* Aim for about this many ops per result, within limits */
+#define TARGET_WORK 2000000
+#define MIN_OPS 200
+#define MAX_OPS 200000
+
+/* As in x-window.m and the Aqua theme */
+#define DELTA 20
+#define SLOP 8
+#define TITLEBAR_HEIGHT 22
+#define MENUBAR_HEIGHT 22
+#define DOCK_HEIGHT 64
+
+static window windows[MAX_WINDOWS];
+
+typedef struct {
+    int n_heads;
+    X11Rect heads[MAX_HEADS];		/* the first one is the main head */
+} layout;
+
+static const layout layouts[] = {
+    { 1, { { 0, 0, 1920, 1080 } } },
+    { 2, { { 0, 0, 1920, 1080 }, { 1920, 90, 1440, 900 } } },
+    { 4, { { 0, 0, 1920, 1080 }, { 1920, 0, 1920, 1080 },
+           { 0, 1080, 1920, 1080 }, { 1920, 1080, 2560, 1440 } } },
+};
+
+#define N_LAYOUTS (sizeof (layouts) / sizeof (layouts[0]))
+
+static const int window_counts[] = { 10, 100, 1000 };
+
+#define N_COUNTS (sizeof (window_counts) / sizeof (window_counts[0]))
+
+/* From here on, the real thing */
+#undef malloc
+#undef calloc
+#undef realloc
+
+unsigned long bench_mallocs;
+
+void *
+bench_malloc (size_t size)
+{
+    bench_mallocs++;
+    return malloc (size);
+}
+
+void *
+bench_calloc (size_t n, size_t size)
+{
+    bench_mallocs++;
+    return calloc (n, size);
+}
+
+void *
+bench_realloc (void *ptr, size_t size)
+{
+    bench_mallocs++;
+    return realloc (ptr, size);
+}
+
+/* Timing and counting one result */
+
+static struct {
+    double start;
+    unsigned long mallocs, nodes;
+} meter;
+
+static void
+meter_start (void)
+{
+    meter.mallocs = bench_mallocs;
+    meter.nodes = x_list_nodes_allocated;
+    meter.start = now ();
+}
+
+static void
+meter_stop (const char *name, int n_windows, int n_heads, int n_ops)
+{
+    double elapsed = now () - meter.start;
+
+    printf ("%s\t%d\t%d\t%.1f\t%.3f\t%.3f\n", name, n_windows, n_heads,
+            elapsed * 1e9 / n_ops,
+            (double) (bench_mallocs - meter.mallocs) / n_ops,
+            (double) (x_list_nodes_allocated - meter.nodes) / n_ops);
+}
+
+static int
+ops_for (int work_per_op)
+{
+    int n = TARGET_WORK / (work_per_op > 0 ? work_per_op : 1);
+
+    return n < MIN_OPS ? MIN_OPS : n > MAX_OPS ? MAX_OPS : n;
+}
+
+/* Window sets */
+
+static X11Rect
+bounds (const layout *l)
+{
+    int i, x1 = 0, y1 = 0;
+
+    for (i = 0; i < l->n_heads; i++)
+    {
+        if (l->heads[i].x + (int) l->heads[i].width > x1)
+            x1 = l->heads[i].x + l->heads[i].width;
+        if (l->heads[i].y + (int) l->heads[i].height > y1)
+            y1 = l->heads[i].y + l->heads[i].height;
+    }
+
+    return X11RectMake (0, 0, x1, y1);
+}
+
+static int
+random_level (void)
+{
+    int r = rand () % 100;
+
+    return r < 85 ? 0 : r < 93 ? 1 : r < 96 ? 2 : r < 98 ? -1 : -2;
+}
+
+/* N windows scattered over the layout, with the odd one hanging off
+   it. A third of them are transient for an earlier window. */
+static void
+make_windows (int n, const layout *l)
+{
+    X11Rect b = bounds (l);
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        window *w = &windows[i];
+
+        w->frame = X11RectMake (rand () % (b.width + 200) - 100,
+                                rand () % (b.height + 200) - 100,
+                                200 + rand () % 700, 150 + rand () % 550);
+        w->level = random_level ();
+        x_stack_node_init (&w->stack_node, w);
+        x_grid_item_init (&w->grid_item, w);
+        x_chain_node_init (&w->transient_node, w);
+        x_chain_init (&w->transients);
+        w->transient_for = NULL;
+        w->visit_stamp = 0;
+
+        if (i > 0 && rand () % 3 == 0)
+        {
+            w->transient_for = &windows[rand () % i];
+            x_chain_prepend (&w->transient_for->transients, &w->transient_node);
+        }
+    }
+}
+
+/* x-list */
+
+static int
+level_less (const void *a, const void *b)
+{
+    const window *x = a, *y = b;
+
+    return x->level > y->level;
+}
+
+static void
+bench_list (int n)
+{
+    x_list *lst;
+    int i, j, n_ops;
+
+    /* Adopting N windows, oldest first */
+    n_ops = ops_for (n * n / 2);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        lst = NULL;
+        for (j = 0; j < n; j++)
+            lst = x_list_append (lst, &windows[j]);
+        x_list_free (lst);
+    }
+    meter_stop ("list_append_all", n, 0, n_ops);
+
+    lst = NULL;
+    for (j = 0; j < n; j++)
+        lst = x_list_prepend (lst, &windows[j]);
+
+    /* Finding a window and moving it to the front */
+    n_ops = ops_for (n);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        window *w = &windows[rand () % n];
+
+        if (x_list_find (lst, w) != NULL)
+        {
+            lst = x_list_remove (lst, w);
+            lst = x_list_prepend (lst, w);
+        }
+    }
+    meter_stop ("list_find_remove", n, 0, n_ops);
+
+    n_ops = ops_for (n);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+        j += x_list_length (lst);
+    meter_stop ("list_length", n, 0, n_ops);
+
+    n_ops = ops_for (n * 10);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+        lst = x_list_sort (lst, level_less);
+    meter_stop ("list_sort", n, 0, n_ops);
+
+    x_list_free (lst);
+}
+
+/* x11-geometry: how much of each window is on each head */
+
+static void
+bench_geometry (int n, const layout *l)
+{
+    unsigned long area = 0;
+    int i, k, n_ops;
+
+    n_ops = ops_for (l->n_heads);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        X11Rect frame = windows[i % n].frame;
+
+        for (k = 0; k < l->n_heads; k++)
+        {
+            X11Rect r = X11RectIntersection (frame, l->heads[k]);
+            area += r.width * r.height;
+        }
+    }
+    meter_stop ("rect_intersect_heads", n, l->n_heads, n_ops);
+
+    if (area == 1)
+        putchar ('\n');
+}
+
+/* -[x_screen validate_window_position:titlebar_height:] */
+
+static void
+bench_validate (int n, const layout *l)
+{
+    x_usable_area u;
+    X11Region screen;
+    X11Rect main = l->heads[0], dock;
+    int i, k, n_ops;
+
+    pixman_region32_init (&screen);
+    for (k = 0; k < l->n_heads; k++)
+    {
+        pixman_region32_union_rect (&screen, &screen,
+                                    l->heads[k].x, l->heads[k].y,
+                                    l->heads[k].width, l->heads[k].height);
+    }
+
+    dock = X11RectMake (main.x + main.width / 4,
+                        main.y + main.height - DOCK_HEIGHT,
+                        main.width / 2, DOCK_HEIGHT);
+
+    meter_start ();
+    x_usable_area_init (&u);
+    x_usable_area_set_heads (&u, &screen, l->heads, l->n_heads, main);
+    x_usable_area_set_dock (&u, dock, X_USABLE_DOCK_BOTTOM);
+    meter_stop ("usable_area_setup", n, l->n_heads, 1);
+
+    n_ops = ops_for (l->n_heads * 10);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+        x_usable_area_validate (&u, windows[i % n].frame, TITLEBAR_HEIGHT);
+    meter_stop ("validate_position", n, l->n_heads, n_ops);
+
+    x_usable_area_fini (&u);
+    pixman_region32_fini (&screen);
+}
+
+/* -[x_window place_window], document windows with no group */
+
+static X11Rect
+work_area (const layout *l, int head)
+{
+    X11Rect r = l->heads[head];
+
+    if (head == 0)
+    {
+        r.y += MENUBAR_HEIGHT;
+        r.height -= MENUBAR_HEIGHT + DOCK_HEIGHT;
+    }
+
+    return r;
+}
+
+static void
+bench_place (int n, const layout *l)
+{
+    x_grid grid;
+    X11Rect zoom = work_area (l, 0), area;
+    X11Point p, best;
+    unsigned long overlap, best_overlap, sum = 0;
+    int i, k, n_ops;
+
+    meter_start ();
+    x_grid_init (&grid);
+    for (i = 0; i < n; i++)
+        x_grid_insert (&grid, &windows[i].grid_item, windows[i].frame);
+    meter_stop ("grid_insert", n, l->n_heads, n);
+
+    /* Cascading from the top left of the main head */
+    n_ops = ops_for (n / 4);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        p = X11PointMake (zoom.x, zoom.y);
+        for (k = 0; k < n && x_grid_find_origin (&grid, p, SLOP) != NULL; k++)
+        {
+            p.x += DELTA;
+            p.y += DELTA;
+        }
+    }
+    meter_stop ("place_cascade", n, l->n_heads, n_ops);
+
+    /* -[x_screen least_overlapped_rect:] */
+    n_ops = ops_for (l->n_heads * 2000);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        X11Rect r = windows[i % n].frame;
+
+        best = x_grid_least_covered (&grid, zoom, r.width, r.height,
+                                     &best_overlap);
+        for (k = 1; k < l->n_heads && best_overlap > 0; k++)
+        {
+            area = work_area (l, k);
+            p = x_grid_least_covered (&grid, area, r.width, r.height,
+                                      &overlap);
+            if (overlap < best_overlap)
+            {
+                best = p;
+                best_overlap = overlap;
+            }
+        }
+
+        sum += best.x + best.y;
+    }
+    meter_stop ("place_least_overlapped", n, l->n_heads, n_ops);
+
+    /* Dragging windows about */
+    n_ops = ops_for (1);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        window *w = &windows[i % n];
+
+        w->frame.x += (i & 1) ? 7 : -7;
+        x_grid_move (&grid, &w->grid_item, w->frame);
+    }
+    meter_stop ("grid_move", n, l->n_heads, n_ops);
+
+    x_grid_free (&grid);
+
+    if (sum == 1)
+        putchar ('\n');
+}
+
+/* -[x_screen raise_windows:count:] */
+
+static void
+no_restack (x_stack_node *node, x_stack_node *above, void *closure)
+{
+}
+
+static void
+bench_raise (int n)
+{
+    x_stack stack;
+    x_stack_node *nodes[MAX_GROUP];
+    int levels[MAX_GROUP];
+    int i, j, count, n_ops;
+
+    x_stack_init (&stack);
+    for (i = 0; i < n; i++)
+        x_stack_insert (&stack, &windows[i].stack_node, windows[i].level, 1);
+
+    n_ops = ops_for (MAX_GROUP);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        /* A window, and sometimes a couple of its dialogs */
+        count = rand () % 8 == 0 ? MAX_GROUP : 1;
+        for (j = 0; j < count; j++)
+        {
+            window *w = &windows[(i + j * 7919) % n];
+
+            nodes[j] = &w->stack_node;
+            levels[j] = w->level;
+        }
+
+        x_stack_raise (&stack, nodes, levels, count, no_restack, NULL);
+    }
+    meter_stop ("stack_raise", n, 0, n_ops);
+}
+
+/* As -[x_window transient_group] has x_tree_collect walk the windows */
+
+static void *
+transient_parent (void *data)
+{
+    return ((window *) data)->transient_for;
+}
+
+static x_chain *
+transient_children (void *data)
+{
+    return &((window *) data)->transients;
+}
+
+static unsigned int *
+transient_visit_stamp (void *data)
+{
+    return &((window *) data)->visit_stamp;
+}
+
+static const x_tree_ops transient_tree_ops = {
+    transient_parent, transient_children, transient_visit_stamp
+};
+
+static x_list *
+transient_group (window *self, unsigned int *stamp)
+{
+    *stamp += 2;
+    return x_tree_collect (self, &transient_tree_ops, *stamp - 1, *stamp);
+}
+
+static void
+bench_transients (int n)
+{
+    unsigned int stamp = 0;
+    unsigned long members = 0;
+    int i, n_ops;
+    x_list *group;
+
+    n_ops = ops_for (16);
+    meter_start ();
+    for (i = 0; i < n_ops; i++)
+    {
+        group = transient_group (&windows[rand () % n], &stamp);
+        members += x_list_length (group);
+        x_list_free (group);
+    }
+    meter_stop ("transient_group", n, 0, n_ops);
+}
+
+int
+main (int argc, char **argv)
+{
+    unsigned int c, l;
+    int n;
+
+    srand (argc > 1 ? atoi (argv[1]) : 1);
+
+    printf ("# benchmark\twindows\theads\tns_per_op\tmallocs_per_op\tnodes_per_op\n");
+
+    for (c = 0; c < N_COUNTS; c++)
+    {
+        n = window_counts[c];
+
+        make_windows (n, &layouts[0]);
+        bench_list (n);
+        bench_raise (n);
+        bench_transients (n);
+
+        for (l = 0; l < N_LAYOUTS; l++)
+        {
+            make_windows (n, &layouts[l]);
+            bench_geometry (n, &layouts[l]);
+            bench_validate (n, &layouts[l]);
+            bench_place (n, &layouts[l]);
+        }
+    }
+
+    return 0;
+}
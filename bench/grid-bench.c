@@ -0,0 +1,155 @@
+/* grid-bench.c -- placing new windows among many
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_WINDOWS 2000
+#define N_PLACEMENTS 2000
+
+/* As in -[x_window place_window] */
+#define SLOP 8
+#define DELTA 20
+
+static const X11Rect work_area = { 0, 22, 1920, 1058 };
+
+static window windows[MAX_WINDOWS];
+
+/* Mostly cascaded from the top left, as the default placement leaves
+   them, with the rest anywhere. */
+static void
+make_windows (int n)
+{
+    int i, k;
+
+    for (i = 0; i < n; i++)
+    {
+        k = i % 40;
+
+        if (rand () % 4 != 0)
+            windows[i].frame = X11RectMake (k * DELTA, 22 + k * DELTA,
+                                            400 + rand () % 400,
+                                            300 + rand () % 300);
+        else
+            windows[i].frame = X11RectMake (rand () % 1600, 22 + rand () % 800,
+                                            200 + rand () % 800,
+                                            150 + rand () % 600);
+    }
+}
+
+/* The linear scan find_window_at:slop: used to make */
+static void *
+list_find_origin (int n, X11Point p, int slop)
+{
+    int i, dx, dy;
+
+    for (i = 0; i < n; i++)
+    {
+        dx = p.x - windows[i].frame.x;
+        dy = p.y - windows[i].frame.y;
+
+        if (dx * dx + dy * dy <= slop * slop)
+            return &windows[i];
+    }
+
+    return NULL;
+}
+
+static void
+bench (int n)
+{
+    x_grid grid;
+    X11Point p;
+    double start, list_time, grid_time, smart_time;
+    unsigned long steps = 0, overlap = 0, o;
+    int i;
+
+    make_windows (n);
+
+    x_grid_init (&grid);
+    for (i = 0; i < n; i++)
+    {
+        x_grid_item_init (&windows[i].grid_item, &windows[i]);
+        x_grid_insert (&grid, &windows[i].grid_item, windows[i].frame);
+    }
+
+    start = now ();
+    for (i = 0; i < N_PLACEMENTS; i++)
+    {
+        p = X11RectOrigin (work_area);
+        while (list_find_origin (n, p, SLOP) != NULL)
+        {
+            p.x += DELTA;
+            p.y += DELTA;
+            steps++;
+        }
+    }
+    list_time = now () - start;
+
+    start = now ();
+    for (i = 0; i < N_PLACEMENTS; i++)
+    {
+        p = X11RectOrigin (work_area);
+        while (x_grid_find_origin (&grid, p, SLOP) != NULL)
+        {
+            p.x += DELTA;
+            p.y += DELTA;
+        }
+    }
+    grid_time = now () - start;
+
+    start = now ();
+    for (i = 0; i < N_PLACEMENTS; i++)
+    {
+        x_grid_least_covered (&grid, work_area, 640, 480, &o);
+        overlap += o;
+    }
+    smart_time = now () - start;
+
+    printf ("%4d windows: cascade %.2f us (list) %.2f us (grid), %lu steps;"
+            " least overlap %.2f us, %lu px\n", n,
+            list_time * 1e6 / N_PLACEMENTS, grid_time * 1e6 / N_PLACEMENTS,
+            steps / N_PLACEMENTS, smart_time * 1e6 / N_PLACEMENTS,
+            overlap / N_PLACEMENTS);
+
+    x_grid_free (&grid);
+}
+
+int
+main (int argc, char **argv)
+{
+    srand (argc > 1 ? atoi (argv[1]) : 1);
+
+    bench (100);
+    bench (500);
+    bench (MAX_WINDOWS);
+
+    return 0;
+}
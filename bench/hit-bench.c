@@ -0,0 +1,242 @@
+/* hit-bench.c -- answering frame hit tests without asking the server
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench.h"
+#include "x-hit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define N_PRESSES 100000
+#define TITLEBAR_HEIGHT 22
+#define GROWBOX_SIZE 15
+
+/* Attrs as Xplugin hands them back; the values don't matter here */
+#define ATTR_TITLE 0x0004
+#define ATTR_CLOSE_BOX 0x0100
+#define ATTR_COLLAPSE 0x0200
+#define ATTR_ZOOM 0x0400
+#define ATTR_GROW_BOX 0x2000
+
+typedef struct {
+    X11Rect outer_r, inner_r;
+    X11Point p;
+} press;
+
+static press presses[N_PRESSES];
+
+/* Something like the Aqua document frame: three 12x12 buttons at the
+   top left, the rest of the titlebar, and a growbox at the bottom
+   right. */
+static unsigned int
+aqua_hit_test (X11Rect outer_r, X11Rect inner_r, X11Point p, void *data)
+{
+    int x = p.x - outer_r.x, y = p.y - outer_r.y, i;
+    int width = outer_r.width, height = outer_r.height;
+    static const unsigned int buttons[] = {
+        ATTR_CLOSE_BOX, ATTR_COLLAPSE, ATTR_ZOOM
+    };
+
+    if (x < 0 || y < 0 || x >= width || y >= height)
+        return 0;
+
+    if (y < inner_r.y - outer_r.y)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            if (x >= 8 + i * 20 && x < 20 + i * 20 && y >= 5 && y < 17)
+                return ATTR_TITLE | buttons[i];
+        }
+
+        return ATTR_TITLE;
+    }
+
+    if (x >= width - GROWBOX_SIZE && y >= height - GROWBOX_SIZE)
+        return ATTR_GROW_BOX;
+
+    return 0;
+}
+
+/* Stands in for the X server: answers hit tests from the other end of
+   a socket, so that asking costs a round trip between processes. */
+static int server_fd;
+
+static void
+serve (int fd)
+{
+    press pr;
+    unsigned int attr;
+
+    while (read (fd, &pr, sizeof (pr)) == sizeof (pr))
+    {
+        attr = aqua_hit_test (pr.outer_r, pr.inner_r, pr.p, NULL);
+        if (write (fd, &attr, sizeof (attr)) != sizeof (attr))
+            break;
+    }
+
+    _exit (0);
+}
+
+static unsigned int
+server_hit_test (X11Rect outer_r, X11Rect inner_r, X11Point p, void *data)
+{
+    press pr;
+    unsigned int attr = 0;
+
+    pr.outer_r = outer_r;
+    pr.inner_r = inner_r;
+    pr.p = p;
+
+    if (write (server_fd, &pr, sizeof (pr)) != sizeof (pr)
+        || read (server_fd, &attr, sizeof (attr)) != sizeof (attr))
+    {
+        perror ("server");
+        exit (1);
+    }
+
+    return attr;
+}
+
+/* Presses land mostly in titlebars, around the buttons and on the
+   growbox, as they do when people move, close and resize windows. */
+static void
+make_presses (void)
+{
+    int i, w, h;
+
+    for (i = 0; i < N_PRESSES; i++)
+    {
+        press *pr = &presses[i];
+
+        w = 200 + rand () % 1000;
+        h = TITLEBAR_HEIGHT + 50 + rand () % 800;
+        pr->outer_r = X11RectMake (rand () % 1000, rand () % 600, w, h);
+        pr->inner_r = X11RectMake (pr->outer_r.x,
+                                   pr->outer_r.y + TITLEBAR_HEIGHT,
+                                   w, h - TITLEBAR_HEIGHT);
+
+        switch (rand () % 4)
+        {
+        case 0:			/* anywhere in the titlebar */
+            pr->p = X11PointMake (rand () % w, rand () % TITLEBAR_HEIGHT);
+            break;
+        case 1:			/* near the buttons */
+            pr->p = X11PointMake (rand () % 80, rand () % TITLEBAR_HEIGHT);
+            break;
+        case 2:			/* near the growbox */
+            pr->p = X11PointMake (w - 1 - rand () % 30, h - 1 - rand () % 30);
+            break;
+        default:		/* anywhere, and a bit beyond */
+            pr->p = X11PointMake (rand () % (w + 10) - 5,
+                                  rand () % (h + 10) - 5);
+            break;
+        }
+
+        pr->p.x += pr->outer_r.x;
+        pr->p.y += pr->outer_r.y;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    x_hit_map map = { 0 };
+    int fds[2], i, n_probes;
+    unsigned long mismatches = 0;
+    unsigned int sum = 0;
+    double start, local, remote;
+    pid_t pid;
+
+    srand (argc > 1 ? atoi (argv[1]) : 1);
+    make_presses ();
+
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        perror ("socketpair");
+        return 1;
+    }
+
+    pid = fork ();
+    if (pid == 0)
+    {
+        close (fds[0]);
+        serve (fds[1]);
+    }
+    close (fds[1]);
+    server_fd = fds[0];
+
+    /* What frame.m gets back from XAppleWMFrameGetRect at its two
+       reference sizes */
+    map.titlebar_height = TITLEBAR_HEIGHT;
+    x_hit_spec_derive (&map.tracking, X11RectMake (7, 3, 54, 16), 400, 300,
+                       X11RectMake (7, 3, 54, 16));
+    x_hit_spec_derive (&map.growbox,
+                       X11RectMake (400 - GROWBOX_SIZE, 300 - GROWBOX_SIZE,
+                                    GROWBOX_SIZE, GROWBOX_SIZE), 400, 300,
+                       X11RectMake (600 - GROWBOX_SIZE, 500 - GROWBOX_SIZE,
+                                    GROWBOX_SIZE, GROWBOX_SIZE));
+
+    start = now ();
+    n_probes = x_hit_map_scan (&map, 400, 300, server_hit_test, NULL);
+    printf ("map: %d buttons from %d server queries in %.3f ms\n",
+            map.n_buttons, n_probes, (now () - start) * 1e3);
+
+    for (i = 0; i < N_PRESSES; i++)
+    {
+        press *pr = &presses[i];
+
+        if (x_hit_map_test (&map, pr->outer_r, pr->inner_r, pr->p)
+            != aqua_hit_test (pr->outer_r, pr->inner_r, pr->p, NULL))
+            mismatches++;
+    }
+
+    start = now ();
+    for (i = 0; i < N_PRESSES; i++)
+        sum += x_hit_map_test (&map, presses[i].outer_r,
+                               presses[i].inner_r, presses[i].p);
+    local = now () - start;
+
+    start = now ();
+    for (i = 0; i < N_PRESSES; i++)
+        sum -= server_hit_test (presses[i].outer_r, presses[i].inner_r,
+                                presses[i].p, NULL);
+    remote = now () - start;
+
+    printf ("%d presses: %.3f us/press local, %.3f us/press asking the server, "
+            "%lu mismatches\n", N_PRESSES, local * 1e6 / N_PRESSES,
+            remote * 1e6 / N_PRESSES, mismatches);
+
+    close (server_fd);
+    waitpid (pid, NULL, 0);
+
+    return mismatches != 0 || sum != 0;
+}
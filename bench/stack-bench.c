@@ -0,0 +1,199 @@
+/* stack-bench.c -- raising windows at random in a deep stack
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench.h"
+#include "x-list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_WINDOWS 1000
+#define N_RAISES 100000
+#define MAX_GROUP 4
+
+static window windows[N_WINDOWS];
+
+/* The raises to make, shared by both implementations */
+static int plan_n[N_RAISES];
+static int plan_ids[N_RAISES][MAX_GROUP];
+
+static unsigned long restack_calls;
+
+static int
+random_level (void)
+{
+    int r = rand () % 100;
+
+    /* Mostly normal windows, a few floating palettes and torn-off
+       menus, the odd dock or desktop window. */
+    return r < 85 ? 0 : r < 93 ? 1 : r < 96 ? 2 : r < 98 ? -1 : -2;
+}
+
+static void
+make_plan (void)
+{
+    int i, j, k;
+
+    for (i = 0; i < N_RAISES; i++)
+    {
+        /* One in eight raises is a window with its transients */
+        plan_n[i] = (rand () % 8 == 0) ? 2 + rand () % (MAX_GROUP - 1) : 1;
+
+        for (j = 0; j < plan_n[i]; j++)
+        {
+            do {
+                plan_ids[i][j] = rand () % N_WINDOWS;
+                for (k = 0; k < j; k++)
+                    if (plan_ids[i][k] == plan_ids[i][j])
+                        break;
+            } while (k < j);
+        }
+    }
+}
+
+static void
+count_restack (x_stack_node *node, x_stack_node *above, void *closure)
+{
+    restack_calls++;
+}
+
+/* The level-bucketed stack, as used now */
+
+static void
+bench_stack (void)
+{
+    x_stack stack;
+    x_stack_node *nodes[MAX_GROUP];
+    int levels[MAX_GROUP];
+    double start, elapsed;
+    int i, j;
+
+    x_stack_init (&stack);
+    for (i = 0; i < N_WINDOWS; i++)
+    {
+        x_stack_node_init (&windows[i].stack_node, &windows[i]);
+        x_stack_insert (&stack, &windows[i].stack_node, windows[i].level, 1);
+    }
+
+    restack_calls = 0;
+    start = now ();
+
+    for (i = 0; i < N_RAISES; i++)
+    {
+        for (j = 0; j < plan_n[i]; j++)
+        {
+            nodes[j] = &windows[plan_ids[i][j]].stack_node;
+            levels[j] = windows[plan_ids[i][j]].level;
+        }
+
+        x_stack_raise (&stack, nodes, levels, plan_n[i], count_restack, NULL);
+    }
+
+    elapsed = now () - start;
+
+    printf ("x_stack: %d raises of %d windows: %.3f us/raise, %.2f restacks/raise\n",
+            N_RAISES, N_WINDOWS, elapsed * 1e6 / N_RAISES,
+            (double) restack_calls / N_RAISES);
+}
+
+/* The sorted list it replaced */
+
+static int
+window_level_less (const void *a, const void *b)
+{
+    const window *x = a, *y = b;
+
+    return x->level > y->level;
+}
+
+static void
+bench_list (void)
+{
+    x_list *stacking = NULL, *node;
+    double start, elapsed;
+    unsigned long restacked = 0;
+    int i, j, seen;
+
+    for (i = 0; i < N_WINDOWS; i++)
+        stacking = x_list_prepend (stacking, &windows[i]);
+    stacking = x_list_sort (stacking, window_level_less);
+
+    start = now ();
+
+    for (i = 0; i < N_RAISES; i++)
+    {
+        for (j = plan_n[i] - 1; j >= 0; j--)
+        {
+            stacking = x_list_remove (stacking, &windows[plan_ids[i][j]]);
+            stacking = x_list_prepend (stacking, &windows[plan_ids[i][j]]);
+        }
+
+        stacking = x_list_sort (stacking, window_level_less);
+
+        /* Everything down to the lowest raised window was restacked */
+        for (node = stacking, seen = 0; node != NULL && seen < plan_n[i];
+             node = node->next)
+        {
+            restacked++;
+            for (j = 0; j < plan_n[i]; j++)
+            {
+                if (node->data == &windows[plan_ids[i][j]])
+                {
+                    seen++;
+                    break;
+                }
+            }
+        }
+    }
+
+    elapsed = now () - start;
+
+    printf ("x_list:  %d raises of %d windows: %.3f us/raise, %.2f restacks/raise\n",
+            N_RAISES, N_WINDOWS, elapsed * 1e6 / N_RAISES,
+            (double) restacked / N_RAISES);
+
+    x_list_free (stacking);
+}
+
+int
+main (int argc, char **argv)
+{
+    int i;
+
+    srand (argc > 1 ? atoi (argv[1]) : 1);
+
+    for (i = 0; i < N_WINDOWS; i++)
+        windows[i].level = random_level ();
+
+    make_plan ();
+
+    bench_stack ();
+    bench_list ();
+
+    return 0;
+}
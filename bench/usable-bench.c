@@ -0,0 +1,130 @@
+/* usable-bench.c -- keeping windows reachable on 1 to 6 heads
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench.h"
+#include "x-usable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_HEADS 6
+#define N_CALLS 200000
+#define TITLEBAR_HEIGHT 22
+
+static X11Rect rects[N_CALLS];
+
+/* A drag across all the heads, as validate_window_position:titlebar_height:
+   sees it from the motion handler, with the odd jump off the screen. */
+static void
+make_rects (int width, int height)
+{
+    int i, x = 100, y = 100;
+
+    for (i = 0; i < N_CALLS; i++)
+    {
+        if (rand () % 100 == 0)
+        {
+            x = rand () % (width + 1000) - 500;
+            y = rand () % (height + 600) - 300;
+        }
+        else
+        {
+            x = (x + rand () % 21 - 10 + width) % width;
+            y = (y + rand () % 21 - 10 + height) % height;
+        }
+
+        rects[i] = X11RectMake (x, y, 640, 480);
+    }
+}
+
+static void
+bench (int n_heads)
+{
+    x_usable_area u;
+    X11Rect heads[MAX_HEADS], dock;
+    X11Region screen;
+    double start, cached, rebuilt;
+    unsigned long moved = 0;
+    int i;
+
+    pixman_region32_init (&screen);
+    for (i = 0; i < n_heads; i++)
+    {
+        /* Side by side, alternating sizes, some a little lower */
+        heads[i] = X11RectMake (i * 1920, (i % 2) * 120,
+                                i % 2 ? 1440 : 1920, i % 2 ? 900 : 1080);
+        pixman_region32_union_rect (&screen, &screen, heads[i].x, heads[i].y,
+                                    heads[i].width, heads[i].height);
+    }
+    dock = X11RectMake (560, 1080 - 64, 800, 64);
+
+    make_rects (n_heads * 1920, 1080);
+
+    x_usable_area_init (&u);
+    x_usable_area_set_heads (&u, &screen, heads, n_heads, heads[0]);
+    x_usable_area_set_dock (&u, dock, X_USABLE_DOCK_BOTTOM);
+
+    start = now ();
+    for (i = 0; i < N_CALLS; i++)
+    {
+        if (!X11RectEqualToRect (x_usable_area_validate (&u, rects[i], TITLEBAR_HEIGHT),
+                                 rects[i]))
+            moved++;
+    }
+    cached = now () - start;
+
+    /* What it cost when the dock was asked about and the usable region
+       worked out again on every call */
+    start = now ();
+    for (i = 0; i < N_CALLS; i++)
+    {
+        x_usable_area_set_dock (&u, dock, X_USABLE_DOCK_BOTTOM);
+        x_usable_area_validate (&u, rects[i], TITLEBAR_HEIGHT);
+    }
+    rebuilt = now () - start;
+
+    printf ("%d head%s: %.3f us/call cached, %.3f us/call rebuilt, %lu%% moved\n",
+            n_heads, n_heads == 1 ? " " : "s", cached * 1e6 / N_CALLS,
+            rebuilt * 1e6 / N_CALLS, moved * 100 / N_CALLS);
+
+    x_usable_area_fini (&u);
+    pixman_region32_fini (&screen);
+}
+
+int
+main (int argc, char **argv)
+{
+    int n;
+
+    srand (argc > 1 ? atoi (argv[1]) : 1);
+
+    for (n = 1; n <= MAX_HEADS; n++)
+        bench (n);
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* atoms.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "atoms.h"
+#include "x-hash.h"
+
+#include <stddef.h>
+#include <string.h>
+
+struct atoms_struct_t atoms;
+
+#define X_ATOM_ENUM(field, name) X_ATOM_INDEX_ ## field,
+#define X_ATOM_NAME(field, name) name,
+#define X_ATOM_OFFSET(field, name) offsetof (struct atoms_struct_t, field),
+
+enum {
+    X_ATOMS (X_ATOM_ENUM)
+    X_ATOM_COUNT
+};
+
+static const char *atom_names[X_ATOM_COUNT] = {
+    X_ATOMS (X_ATOM_NAME)
+};
+
+static const size_t atom_offsets[X_ATOM_COUNT] = {
+    X_ATOMS (X_ATOM_OFFSET)
+};
+
+#define ATOM_FIELD(i) (*(Atom *) ((char *) &atoms + atom_offsets[i]))
+
+/* Atom -> table index */
+static x_hash_table *atom_index;
+
+/* Name -> table index + 1, open addressing. Twice the size of the
+   table rounded up to a power of two, so probes stay short. */
+#define NAME_SLOTS 256
+static unsigned char name_slots[NAME_SLOTS];
+
+static unsigned int
+hash_name (const char *name)
+{
+    unsigned int h = 2166136261U;
+
+    while (*name != 0)
+    {
+        h ^= (unsigned char) *name++;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+Bool
+x_atoms_init (Display *dpy)
+{
+    Atom values[X_ATOM_COUNT];
+    unsigned int i, slot;
+
+    if (!XInternAtoms (dpy, (char **) atom_names, X_ATOM_COUNT, False, values))
+        return False;
+
+    if (atom_index == NULL)
+        atom_index = x_hash_table_new ();
+
+    memset (name_slots, 0, sizeof (name_slots));
+
+    for (i = 0; i < X_ATOM_COUNT; i++)
+    {
+        ATOM_FIELD (i) = values[i];
+        x_hash_table_insert (atom_index, values[i], (void *) atom_names[i], i);
+
+        slot = hash_name (atom_names[i]) & (NAME_SLOTS - 1);
+        while (name_slots[slot] != 0)
+            slot = (slot + 1) & (NAME_SLOTS - 1);
+        name_slots[slot] = i + 1;
+    }
+
+    return True;
+}
+
+const char *
+x_atom_name (Atom atom)
+{
+    if (atom_index == NULL || atom == None)
+        return NULL;
+
+    return x_hash_table_lookup (atom_index, atom, NULL);
+}
+
+Atom
+x_atom_for_name (const char *name)
+{
+    unsigned int slot;
+
+    slot = hash_name (name) & (NAME_SLOTS - 1);
+
+    while (name_slots[slot] != 0)
+    {
+        unsigned int i = name_slots[slot] - 1;
+
+        if (strcmp (atom_names[i], name) == 0)
+            return ATOM_FIELD (i);
+
+        slot = (slot + 1) & (NAME_SLOTS - 1);
+    }
+
+    return None;
+}
@@ -0,0 +1,119 @@
+/* atoms.h -- the atoms we use, interned once at startup
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef ATOMS_H
+#define ATOMS_H 1
+
+#include <X11/Xlib.h>
+
+/* Every atom we use, as ATOM (field, "NAME"). Expanded to declare the
+   fields of struct atoms_struct_t and to build the name tables in
+   atoms.c, so adding an atom means adding one line here. */
+
+#define X_ATOMS(ATOM) \
+    ATOM (apple_no_order_in,                "_APPLE_NO_ORDER_IN") \
+    ATOM (atom,                             "ATOM") \
+    ATOM (clipboard,                        "CLIPBOARD") \
+    ATOM (cstring,                          "CSTRING") \
+    ATOM (motif_wm_hints,                   "_MOTIF_WM_HINTS") \
+    ATOM (multiple,                         "MULTIPLE") \
+    ATOM (native_screen_origin,             "_NATIVE_SCREEN_ORIGIN") \
+    ATOM (native_window_id,                 "_NATIVE_WINDOW_ID") \
+    ATOM (net_active_window,                "_NET_ACTIVE_WINDOW") \
+    ATOM (net_client_list,                  "_NET_CLIENT_LIST") \
+    ATOM (net_client_list_stacking,         "_NET_CLIENT_LIST_STACKING") \
+    ATOM (net_close_window,                 "_NET_CLOSE_WINDOW") \
+    ATOM (net_supported,                    "_NET_SUPPORTED") \
+    ATOM (net_supporting_wm_check,          "_NET_SUPPORTING_WM_CHECK") \
+    ATOM (net_wm_action_close,              "_NET_WM_ACTION_CLOSE") \
+    ATOM (net_wm_action_fullscreen,         "_NET_WM_ACTION_FULLSCREEN") \
+    ATOM (net_wm_action_maximize_horz,      "_NET_WM_ACTION_MAXIMIZE_HORZ") \
+    ATOM (net_wm_action_maximize_vert,      "_NET_WM_ACTION_MAXIMIZE_VERT") \
+    ATOM (net_wm_action_minimize,           "_NET_WM_ACTION_MINIMIZE") \
+    ATOM (net_wm_action_move,               "_NET_WM_ACTION_MOVE") \
+    ATOM (net_wm_action_resize,             "_NET_WM_ACTION_RESIZE") \
+    ATOM (net_wm_action_shade,              "_NET_WM_ACTION_SHADE") \
+    ATOM (net_wm_allowed_actions,           "_NET_WM_ALLOWED_ACTIONS") \
+    ATOM (net_wm_name,                      "_NET_WM_NAME") \
+    ATOM (net_wm_state,                     "_NET_WM_STATE") \
+    ATOM (net_wm_state_fullscreen,          "_NET_WM_STATE_FULLSCREEN") \
+    ATOM (net_wm_state_hidden,              "_NET_WM_STATE_HIDDEN") \
+    ATOM (net_wm_state_maximized_horz,      "_NET_WM_STATE_MAXIMIZED_HORZ") \
+    ATOM (net_wm_state_maximized_vert,      "_NET_WM_STATE_MAXIMIZED_VERT") \
+    ATOM (net_wm_state_modal,               "_NET_WM_STATE_MODAL") \
+    ATOM (net_wm_state_shaded,              "_NET_WM_STATE_SHADED") \
+    ATOM (net_wm_state_skip_pager,          "_NET_WM_STATE_SKIP_PAGER") \
+    ATOM (net_wm_state_skip_taskbar,        "_NET_WM_STATE_SKIP_TASKBAR") \
+    ATOM (net_wm_state_sticky,              "_NET_WM_STATE_STICKY") \
+    ATOM (net_wm_sync_request,              "_NET_WM_SYNC_REQUEST") \
+    ATOM (net_wm_sync_request_counter,      "_NET_WM_SYNC_REQUEST_COUNTER") \
+    ATOM (net_wm_window_type,               "_NET_WM_WINDOW_TYPE") \
+    ATOM (net_wm_window_type_combo,         "_NET_WM_WINDOW_TYPE_COMBO") \
+    ATOM (net_wm_window_type_desktop,       "_NET_WM_WINDOW_TYPE_DESKTOP") \
+    ATOM (net_wm_window_type_dialog,        "_NET_WM_WINDOW_TYPE_DIALOG") \
+    ATOM (net_wm_window_type_dropdown_menu, "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU") \
+    ATOM (net_wm_window_type_dnd,           "_NET_WM_WINDOW_TYPE_DND") \
+    ATOM (net_wm_window_type_dock,          "_NET_WM_WINDOW_TYPE_DOCK") \
+    ATOM (net_wm_window_type_menu,          "_NET_WM_WINDOW_TYPE_MENU") \
+    ATOM (net_wm_window_type_normal,        "_NET_WM_WINDOW_TYPE_NORMAL") \
+    ATOM (net_wm_window_type_notification,  "_NET_WM_WINDOW_TYPE_NOTIFICATION") \
+    ATOM (net_wm_window_type_popup_menu,    "_NET_WM_WINDOW_TYPE_POPUP_MENU") \
+    ATOM (net_wm_window_type_splash,        "_NET_WM_WINDOW_TYPE_SPLASH") \
+    ATOM (net_wm_window_type_toolbar,       "_NET_WM_WINDOW_TYPE_TOOLBAR") \
+    ATOM (net_wm_window_type_tooltip,       "_NET_WM_WINDOW_TYPE_TOOLTIP") \
+    ATOM (net_wm_window_type_utility,       "_NET_WM_WINDOW_TYPE_UTILITY") \
+    ATOM (primary,                          "PRIMARY") \
+    ATOM (string,                           "STRING") \
+    ATOM (targets,                          "TARGETS") \
+    ATOM (text,                             "TEXT") \
+    ATOM (utf8_string,                      "UTF8_STRING") \
+    ATOM (wm_change_state,                  "WM_CHANGE_STATE") \
+    ATOM (wm_colormap_windows,              "WM_COLORMAP_WINDOWS") \
+    ATOM (wm_delete_window,                 "WM_DELETE_WINDOW") \
+    ATOM (wm_hints,                         "WM_HINTS") \
+    ATOM (wm_name,                          "WM_NAME") \
+    ATOM (wm_normal_hints,                  "WM_NORMAL_HINTS") \
+    ATOM (wm_protocols,                     "WM_PROTOCOLS") \
+    ATOM (wm_state,                         "WM_STATE") \
+    ATOM (wm_take_focus,                    "WM_TAKE_FOCUS") \
+    ATOM (wm_transient_for,                 "WM_TRANSIENT_FOR")
+
+#define X_ATOM_FIELD(field, name) Atom field;
+
+struct atoms_struct_t {
+    X_ATOMS (X_ATOM_FIELD)
+};
+
+#undef X_ATOM_FIELD
+
+extern struct atoms_struct_t atoms;
+
+/* Interns the whole table in a single round trip */
+extern Bool x_atoms_init (Display *dpy);
+
+/* Both return None/NULL for atoms not in the table */
+extern const char *x_atom_name (Atom atom);
+extern Atom x_atom_for_name (const char *name);
+
+#endif /* ATOMS_H */
@@ -36,7 +36,8 @@
 #include "dock-support.h"
 
 void dock_event_handler(xp_dock_event *event) {
-    x_list *s_node = NULL, *w_node = NULL;
+    x_list *s_node = NULL;
+    x_chain_node *w_node = NULL;
     x_window *w = NULL;
     x_screen *s = NULL;
     xp_native_window_id *native_wid;
@@ -45,7 +46,7 @@ void dock_event_handler(xp_dock_event *event) {
         case XP_DOCK_EVENT_RESTORE_ALL_WINDOWS:
             for (s_node = screen_list; s_node != NULL; s_node = s_node->next) {
                 s = s_node->data;
-                for (w_node = s->_window_list; w_node != NULL; w_node = w_node->next) {
+                for (w_node = s->_window_list.head; w_node != NULL; w_node = w_node->next) {
                     w = w_node->data;
                     if (w->_minimized) {
                         DB("  restoring window wid:%x\n", [w get_osx_id]);
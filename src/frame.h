@@ -67,16 +67,36 @@
 #define XP_FRAME_ATTRS_POINTER XP_FRAME_POINTER_ATTRS
 #endif
 
-extern void draw_frame (int screen, Window xwindow_id, X11Rect outer_r,
+/* What was last drawn into a frame, so that identical draws can be
+   skipped, and the encoded title it was drawn with */
+typedef struct {
+    unsigned drawn :1;
+    unsigned title_prefixed :1;		/* with the shortcut prefix */
+    xp_frame_class class;
+    xp_frame_attr attr;
+    X11Rect outer_r, inner_r;
+    CFStringRef title;
+    int shortcut_index;
+    unsigned char *title_bytes;
+    CFIndex title_length;
+} frame_draw_state;
+
+extern Bool draw_frame (int screen, Window xwindow_id, X11Rect outer_r,
                         X11Rect inner_r, xp_frame_class class,
                         xp_frame_attr attr, CFStringRef title,
-                        int shortcut_index);
+                        int shortcut_index, frame_draw_state *state);
+extern void frame_draw_state_reset (frame_draw_state *state);
+extern void frame_draw_state_free (frame_draw_state *state);
+extern unsigned long frame_draws, frame_draws_avoided;
 extern int frame_titlebar_height (xp_frame_class class);
+extern void frame_metrics_invalidate (void);
+extern unsigned long frame_metrics_queries, frame_metrics_hits;
 extern X11Rect frame_tracking_rect (X11Rect outer_r, X11Rect inner_r,
                                     xp_frame_class class);
 extern X11Rect frame_growbox_rect (X11Rect outer_r, X11Rect inner_r,
                                    xp_frame_class class);
 extern unsigned int frame_hit_test (X11Rect outer_r, X11Rect inner_r,
                                     xp_frame_class class, X11Point p);
+extern unsigned long frame_hit_tests, frame_hit_test_queries, frame_hit_test_mismatches;
 
 #endif /* XP_FRAME_H */
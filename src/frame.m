@@ -28,38 +28,164 @@
 
 #include "frame.h"
 #include "quartz-wm.h"
+#include "x-hit.h"
 #include <X11/extensions/applewm.h>
 
+/* Frame metrics, by frame class
+
+   For a given class, the rects the server hands back are fixed offsets
+   from the edges of the outer rect (the inner rect being the outer one
+   less the titlebar). So each rect is queried once per class, at two
+   different sizes to see which edge each side follows, and from then on
+   is computed locally. The cache is emptied by frame_metrics_invalidate()
+   when the appearance changes.
+
+   Hit tests work the same way: the first time a frame of a class is
+   drawn, a reference frame is probed to find where its buttons are
+   (see x-hit.c), and hit tests are answered from that. */
+
+/* Two sizes comfortably bigger than any frame decoration */
+#define REF_WIDTH_1 400
+#define REF_HEIGHT_1 300
+#define REF_WIDTH_2 600
+#define REF_HEIGHT_2 500
+
+#define FRAME_METRICS_MAX 16
+
+typedef struct {
+    xp_frame_class class;
+    unsigned have_titlebar_height :1;
+    unsigned have_tracking :1;
+    unsigned have_growbox :1;
+    unsigned have_hit_map :1;
+    int titlebar_height;
+    x_hit_spec tracking;
+    x_hit_spec growbox;
+    x_hit_map hit_map;
+} frame_metrics;
+
+static frame_metrics metrics_cache[FRAME_METRICS_MAX];
+static int n_metrics;
+
+unsigned long frame_metrics_queries, frame_metrics_hits;
+unsigned long frame_hit_tests, frame_hit_test_queries, frame_hit_test_mismatches;
+
+void
+frame_metrics_invalidate (void)
+{
+    n_metrics = 0;
+}
+
+static frame_metrics *
+get_metrics (xp_frame_class class)
+{
+    frame_metrics *m;
+    int i;
+
+    for (i = 0; i < n_metrics; i++)
+    {
+        if (metrics_cache[i].class == class)
+            return &metrics_cache[i];
+    }
+
+    /* There are only a handful of classes in use, so if we fill up
+       something odd is going on; just start again. */
+    if (n_metrics == FRAME_METRICS_MAX)
+        n_metrics = 0;
+
+    m = &metrics_cache[n_metrics++];
+    memset (m, 0, sizeof (*m));
+    m->class = class;
+
+    return m;
+}
+
+static X11Rect
+query_rect (xp_frame_class class, unsigned int type,
+            int width, int height, int titlebar_height)
+{
+    short x, y, w, h;
+
+    frame_metrics_queries++;
+
+    XAppleWMFrameGetRect (x_dpy, class, type,
+                          0, titlebar_height,
+                          width, height - titlebar_height,
+                          0, 0, width, height,
+                          &x, &y, &w, &h);
+
+    return X11RectMake (x, y, w, h);
+}
+
+static void
+query_rect_spec (x_hit_spec *spec, xp_frame_class class,
+                 unsigned int type, int titlebar_height)
+{
+    X11Rect r1, r2;
+
+    r1 = query_rect (class, type, REF_WIDTH_1, REF_HEIGHT_1, titlebar_height);
+    r2 = query_rect (class, type, REF_WIDTH_2, REF_HEIGHT_2, titlebar_height);
+
+    x_hit_spec_derive (spec, r1, REF_WIDTH_1, REF_HEIGHT_1, r2);
+}
+
 int
 frame_titlebar_height (xp_frame_class class)
 {
+    frame_metrics *m = get_metrics (class);
     short x, y, w, h;
 
+    if (m->have_titlebar_height)
+    {
+        frame_metrics_hits++;
+        return m->titlebar_height;
+    }
+
+    frame_metrics_queries++;
+
     XAppleWMFrameGetRect (x_dpy, class, XP_FRAME_RECT_TITLEBAR,
                           0, 0, 0, 0, 0, 0, 0, 0, &x, &y, &w, &h);
 
+    m->titlebar_height = h;
+    m->have_titlebar_height = YES;
+
     return h;
 }
 
+unsigned long frame_draws, frame_draws_avoided;
+
+/* Forget what was drawn, e.g. because the frame was exposed or
+   replaced, but keep the encoded title. */
 void
-draw_frame (int screen, Window xwindow_id, X11Rect outer_r, X11Rect inner_r,
-            xp_frame_class class, xp_frame_attr attr, CFStringRef title,
-            int shortcut_index)
+frame_draw_state_reset (frame_draw_state *state)
+{
+    state->drawn = NO;
+}
+
+void
+frame_draw_state_free (frame_draw_state *state)
+{
+    if (state->title != NULL)
+        CFRelease (state->title);
+
+    free (state->title_bytes);
+    memset (state, 0, sizeof (*state));
+}
+
+static CFIndex
+encode_title (CFStringRef title, int shortcut_index, BOOL prefixed,
+              unsigned char *title_bytes, size_t size)
 {
-    unsigned char title_bytes[512];
     CFIndex title_length;
     size_t prefix_length = 0;
 
-    if (show_shortcut && enable_key_equivalents)
+    if (prefixed && shortcut_index > 0)
     {
-        if (shortcut_index > 0)
-        {
-            // E2 8C 98 = PLACE OF INTEREST SIGN
-            snprintf((char *)title_bytes, sizeof title_bytes, "\xE2\x8C\x98%d%s",
-                     shortcut_index, title == NULL ? "" : " - ");
+        // E2 8C 98 = PLACE OF INTEREST SIGN
+        snprintf((char *)title_bytes, size, "\xE2\x8C\x98%d%s",
+                 shortcut_index, title == NULL ? "" : " - ");
 
-            prefix_length = strlen((char *)title_bytes);
-        }
+        prefix_length = strlen((char *)title_bytes);
     }
 
     if (title == NULL)
@@ -70,15 +196,85 @@
         CFStringGetBytes (title, CFRangeMake (0, CFStringGetLength (title)),
                           kCFStringEncodingUTF8, 0,
                           FALSE, title_bytes + prefix_length,
-                          sizeof (title_bytes) - prefix_length,
+                          size - prefix_length,
                           &title_length);
     }
 
-    title_length += prefix_length;
+    return title_length + prefix_length;
+}
+
+static x_hit_map *get_hit_map (xp_frame_class class);
+
+/* Draws the frame, unless STATE (if non-null) says exactly this has
+   already been drawn. Returns True if it was drawn. */
 
-    DB("id: 0x%ld outer_r: (%d,%d %dx%d) inner_r: (%d,%d %dx%d) class: 0x%d attr: 0x%d title: %s",
+Bool
+draw_frame (int screen, Window xwindow_id, X11Rect outer_r, X11Rect inner_r,
+            xp_frame_class class, xp_frame_attr attr, CFStringRef title,
+            int shortcut_index, frame_draw_state *state)
+{
+    unsigned char buffer[512];
+    unsigned char *title_bytes;
+    CFIndex title_length;
+    BOOL prefixed = show_shortcut && enable_key_equivalents;
+    BOOL title_changed = YES;
+
+    /* Probe for the class's buttons now, so a press doesn't have to */
+    get_hit_map (class);
+
+    if (state != NULL && state->title_bytes != NULL
+        && state->shortcut_index == shortcut_index
+        && state->title_prefixed == prefixed
+        && (state->title == title
+            || (state->title != NULL && title != NULL
+                && CFEqual (state->title, title))))
+    {
+        title_bytes = state->title_bytes;
+        title_length = state->title_length;
+        title_changed = NO;
+    }
+    else
+    {
+        title_bytes = buffer;
+        title_length = encode_title (title, shortcut_index, prefixed,
+                                     buffer, sizeof (buffer));
+
+        if (state != NULL)
+        {
+            if (state->title_bytes != NULL
+                && state->title_length == title_length
+                && memcmp (state->title_bytes, buffer, title_length) == 0)
+            {
+                title_changed = NO;
+            }
+
+            if (state->title != NULL)
+                CFRelease (state->title);
+            free (state->title_bytes);
+
+            state->title = title != NULL ? CFStringCreateCopy (NULL, title) : NULL;
+            state->shortcut_index = shortcut_index;
+            state->title_prefixed = prefixed;
+            state->title_bytes = malloc (MAX (title_length, 1));
+            memcpy (state->title_bytes, buffer, title_length);
+            state->title_length = title_length;
+            title_bytes = state->title_bytes;
+        }
+    }
+
+    if (state != NULL && state->drawn && !title_changed
+        && state->class == class && state->attr == attr
+        && X11RectEqualToRect (state->outer_r, outer_r)
+        && X11RectEqualToRect (state->inner_r, inner_r))
+    {
+        frame_draws_avoided++;
+        return False;
+    }
+
+    DB("id: 0x%ld outer_r: (%d,%d %dx%d) inner_r: (%d,%d %dx%d) class: 0x%d attr: 0x%d title: %.*s",
        xwindow_id, outer_r.x, outer_r.y, outer_r.width, outer_r.height,
        inner_r.x, inner_r.y, inner_r.width, inner_r.height, class, attr,
+       title_length ? (int) title_length : 6,
        title_length ? (char *)title_bytes : "(none)");
 
     XAppleWMFrameDraw (x_dpy, screen, xwindow_id, class, attr,
@@ -87,44 +283,139 @@
                        outer_r.x, outer_r.y,
                        outer_r.width, outer_r.height,
                        title_length, title_bytes);
+    frame_draws++;
+
+    if (state != NULL)
+    {
+        state->drawn = YES;
+        state->class = class;
+        state->attr = attr;
+        state->outer_r = outer_r;
+        state->inner_r = inner_r;
+    }
+
+    return True;
 }
 
-X11Rect
-frame_tracking_rect (X11Rect outer_r, X11Rect inner_r, xp_frame_class class)
+static frame_metrics *
+get_tracking_metrics (xp_frame_class class)
 {
-    short x, y, w, h;
+    frame_metrics *m = get_metrics (class);
 
-    XAppleWMFrameGetRect (x_dpy, class, XP_FRAME_RECT_TRACKING,
-                          inner_r.x, inner_r.y,
-                          inner_r.width, inner_r.height,
-                          outer_r.x, outer_r.y,
-                          outer_r.width, outer_r.height,
-                          &x, &y, &w, &h);
+    if (!m->have_tracking)
+    {
+        query_rect_spec (&m->tracking, class, XP_FRAME_RECT_TRACKING,
+                         frame_titlebar_height (class));
+        m->have_tracking = YES;
+    }
+    else
+        frame_metrics_hits++;
 
-    return X11RectMake (x, y, w, h);
+    return m;
 }
 
-X11Rect
-frame_growbox_rect (X11Rect outer_r, X11Rect inner_r, xp_frame_class class)
+static frame_metrics *
+get_growbox_metrics (xp_frame_class class)
 {
-    short x, y, w, h;
+    frame_metrics *m = get_metrics (class);
 
-    XAppleWMFrameGetRect (x_dpy, class, XP_FRAME_RECT_GROWBOX,
-                          inner_r.x, inner_r.y,
-                          inner_r.width, inner_r.height,
-                          outer_r.x, outer_r.y,
-                          outer_r.width, outer_r.height,
-                          &x, &y, &w, &h);
+    if (!m->have_growbox)
+    {
+        query_rect_spec (&m->growbox, class, XP_FRAME_RECT_GROWBOX,
+                         frame_titlebar_height (class));
+        m->have_growbox = YES;
+    }
+    else
+        frame_metrics_hits++;
 
-    return X11RectMake (x, y, w, h);
+    return m;
 }
 
-unsigned int
-frame_hit_test (X11Rect outer_r, X11Rect inner_r, unsigned int class, X11Point p)
+X11Rect
+frame_tracking_rect (X11Rect outer_r, X11Rect inner_r, xp_frame_class class)
 {
+    return x_hit_spec_apply (&get_tracking_metrics (class)->tracking, outer_r);
+}
+
+X11Rect
+frame_growbox_rect (X11Rect outer_r, X11Rect inner_r, xp_frame_class class)
+{
+    return x_hit_spec_apply (&get_growbox_metrics (class)->growbox, outer_r);
+}
+
+static unsigned int
+server_hit_test (X11Rect outer_r, X11Rect inner_r, xp_frame_class class,
+                 X11Point p)
+{
+    frame_hit_test_queries++;
+
     return XAppleWMFrameHitTest (x_dpy, class, p.x, p.y,
                                  inner_r.x, inner_r.y,
                                  inner_r.width, inner_r.height,
                                  outer_r.x, outer_r.y,
                                  outer_r.width, outer_r.height);
 }
+
+static unsigned int
+hit_map_probe (X11Rect outer_r, X11Rect inner_r, X11Point p, void *data)
+{
+    return server_hit_test (outer_r, inner_r, *(xp_frame_class *) data, p);
+}
+
+static x_hit_map *
+get_hit_map (xp_frame_class class)
+{
+    frame_metrics *m = get_metrics (class);
+    int n_probes;
+
+    if (m->have_hit_map)
+        return &m->hit_map;
+
+    m->hit_map.titlebar_height = frame_titlebar_height (class);
+    m->hit_map.tracking = get_tracking_metrics (class)->tracking;
+    m->hit_map.growbox = get_growbox_metrics (class)->growbox;
+
+    n_probes = x_hit_map_scan (&m->hit_map, REF_WIDTH_1, REF_HEIGHT_1,
+                               hit_map_probe, &class);
+
+    /* The metrics could have been recycled underneath us by the queries
+       above, in which case just do it again next time. */
+    if (m->class == class)
+        m->have_hit_map = YES;
+
+    DB("class: 0x%x, %d buttons found with %d probes",
+       class, m->hit_map.n_buttons, n_probes);
+
+    return &m->hit_map;
+}
+
+unsigned int
+frame_hit_test (X11Rect outer_r, X11Rect inner_r, unsigned int class, X11Point p)
+{
+    unsigned int attr, server_attr;
+
+    attr = x_hit_map_test (get_hit_map (class), outer_r, inner_r, p);
+    frame_hit_tests++;
+
+    if (verify_hit_test)
+    {
+        server_attr = server_hit_test (outer_r, inner_r, class, p);
+
+        if (server_attr != attr)
+        {
+            frame_hit_test_mismatches++;
+            asl_log (aslc, NULL, ASL_LEVEL_WARNING,
+                     "Frame hit test mismatch: class 0x%x, point (%d,%d) "
+                     "in (%d,%d %dx%d): 0x%x locally, 0x%x from the server",
+                     class, p.x, p.y, outer_r.x, outer_r.y,
+                     outer_r.width, outer_r.height, attr, server_attr);
+            attr = server_attr;
+
+            /* Don't keep using a map known to be wrong */
+            get_metrics (class)->have_hit_map = NO;
+            get_hit_map (class);
+        }
+    }
+
+    return attr;
+}
@@ -29,6 +29,9 @@
 #include "quartz-wm.h"
 #include "x-list.h"
 #include "frame.h"
+#include "utils.h"
+#include "x-stats.h"
+#include "x-trace.h"
 #import "x-screen.h"
 #import "x-window.h"
 
@@ -41,17 +44,26 @@
 #include <X11/keysym.h>
 #include <X11/extensions/applewm.h>
 #include <X11/extensions/Xinerama.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/sync.h>
 
 Display *x_dpy;
 unsigned int x_meta_mod;
 int x_shape_event_base, x_shape_error_base;
 int x_apple_wm_event_base, x_apple_wm_error_base;
 int x_xinerama_event_base, x_xinerama_error_base;
-
-struct atoms_struct_t atoms;
+int x_sync_event_base, x_sync_error_base;
+int x_randr_event_base, x_randr_error_base;
+BOOL x_have_sync;
+BOOL x_have_randr_monitors;
 
 static int x_grab_count;
 static Bool x_grab_synced;
+static uint64_t x_grab_start;
+static int grab_stats_slot = -1, flush_stats_slot = -1;
+
+unsigned long x_server_grabs;
+double x_server_grab_time;
 
 x_list *screen_list;
 
@@ -74,12 +86,21 @@
                                     * se, but it queries it so it knows
                                     * not to display shortcuts when key
                                     * equivalents are disabled. */
+BOOL smart_placement = NO;
+BOOL debug_trace = YES;
+BOOL verify_hit_test = NO;
 
 aslclient aslc;
 
+/* Only used by the thread writing out trace records */
+static aslclient trace_aslc;
+
 XAppleWMSendPSNProcPtr _XAppleWMSendPSN;
 XAppleWMAttachTransientProcPtr _XAppleWMAttachTransient;
 
+static void trace_emit (const char *file, const char *function, int line,
+                        uint64_t time, const char *text, void *data);
+
 /* X11 code */
 _X_NORETURN
 static void x_error_shutdown(void);
@@ -93,10 +114,13 @@
     if (x_grab_count++ == 0)
     {
         XGrabServer (x_dpy);
+        x_grab_start = x_stats_now ();
+        x_server_grabs++;
     }
 
     if (do_sync && !x_grab_synced)
     {
+        x_stats_round_trip ();
         XSync (x_dpy, False);
         x_grab_synced = True;
     }
@@ -107,9 +131,17 @@
 {
     if (--x_grab_count == 0)
     {
+        uint64_t held;
+
         XUngrabServer (x_dpy);
         XFlush (x_dpy);
         x_grab_synced = False;
+
+        held = x_stats_now () - x_grab_start;
+        x_stats_record (grab_stats_slot, held);
+        x_server_grab_time += held / 1e9;
+        DB("held server grab for %.2fms (%lu grabs, %.2fms total)",
+           held / 1e6, x_server_grabs, x_server_grab_time * 1000.0);
     }
 }
 
@@ -147,8 +179,9 @@
     } else {
         DB("%s", bufferA);
 
-        XGetErrorDatabaseText(dpy, "XlibMessage", "MinorCode", "Request Minor code %d", bufferA, sizeof(bufferA));
-        DB(bufferA, e->minor_code);
+        XGetErrorDatabaseText(dpy, "XlibMessage", "MinorCode", "Request Minor code %d", bufferB, sizeof(bufferB));
+        snprintf(bufferA, sizeof(bufferA), bufferB, e->minor_code);
+        DB("%s", bufferA);
     }
 
     if (e->resourceid == 0)
@@ -250,6 +283,9 @@
     x_list *node;
     unsigned applewm_mask;
 
+    grab_stats_slot = x_stats_register ("server grab", "x_grab_server");
+    flush_stats_slot = x_stats_register ("deferred writes", "x_flush_deferred");
+
     x_dpy = XOpenDisplay (NULL);
     if (x_dpy == NULL)
     {
@@ -260,66 +296,11 @@
     XSetErrorHandler (x_error_handler);
     XSetIOErrorHandler (x_io_error_handler);
 
-    atoms.apple_no_order_in = XInternAtom (x_dpy, "_APPLE_NO_ORDER_IN", False);
-    atoms.atom = XInternAtom (x_dpy, "ATOM", False);
-    atoms.clipboard = XInternAtom (x_dpy, "CLIPBOARD", False);
-    atoms.cstring = XInternAtom (x_dpy, "CSTRING", False);
-    atoms.motif_wm_hints = XInternAtom (x_dpy, "_MOTIF_WM_HINTS", False);
-    atoms.multiple = XInternAtom (x_dpy, "MULTIPLE", False);
-    atoms.native_screen_origin = XInternAtom (x_dpy, "_NATIVE_SCREEN_ORIGIN", False);
-    atoms.native_window_id = XInternAtom (x_dpy, "_NATIVE_WINDOW_ID", False);
-    atoms.net_active_window = XInternAtom (x_dpy, "_NET_ACTIVE_WINDOW", False);
-    atoms.net_close_window = XInternAtom (x_dpy, "_NET_CLOSE_WINDOW", False);
-    atoms.net_wm_action_close = XInternAtom (x_dpy, "_NET_WM_ACTION_CLOSE", False);
-    atoms.net_wm_action_fullscreen = XInternAtom (x_dpy, "_NET_WM_ACTION_FULLSCREEN", False);
-    atoms.net_wm_action_maximize_horz = XInternAtom (x_dpy, "_NET_WM_ACTION_MAXIMIZE_HORZ", False);
-    atoms.net_wm_action_maximize_vert = XInternAtom (x_dpy, "_NET_WM_ACTION_MAXIMIZE_VERT", False);
-    atoms.net_wm_action_minimize = XInternAtom (x_dpy, "_NET_WM_ACTION_MINIMIZE", False);
-    atoms.net_wm_action_move = XInternAtom (x_dpy, "_NET_WM_ACTION_MOVE", False);
-    atoms.net_wm_action_resize = XInternAtom (x_dpy, "_NET_WM_ACTION_RESIZE", False);
-    atoms.net_wm_action_shade = XInternAtom (x_dpy, "_NET_WM_ACTION_SHADE", False);
-    atoms.net_wm_allowed_actions = XInternAtom (x_dpy, "_NET_WM_ALLOWED_ACTIONS", False);
-    atoms.net_wm_name = XInternAtom (x_dpy, "_NET_WM_NAME", False);
-    atoms.net_wm_state = XInternAtom (x_dpy, "_NET_WM_STATE", False);
-    atoms.net_wm_state_fullscreen = XInternAtom (x_dpy, "_NET_WM_STATE_FULLSCREEN", False);
-    atoms.net_wm_state_hidden = XInternAtom (x_dpy, "_NET_WM_STATE_HIDDEN", False);
-    atoms.net_wm_state_maximized_horz = XInternAtom (x_dpy, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
-    atoms.net_wm_state_maximized_vert = XInternAtom (x_dpy, "_NET_WM_STATE_MAXIMIZED_VERT", False);
-    atoms.net_wm_state_modal = XInternAtom (x_dpy, "_NET_WM_STATE_MODAL", False);
-    atoms.net_wm_state_shaded = XInternAtom (x_dpy, "_NET_WM_STATE_SHADED", False);
-    atoms.net_wm_state_skip_pager = XInternAtom (x_dpy, "_NET_WM_STATE_SKIP_PAGER", False);
-    atoms.net_wm_state_skip_taskbar = XInternAtom (x_dpy, "_NET_WM_STATE_SKIP_TASKBAR", False);
-    atoms.net_wm_state_sticky = XInternAtom (x_dpy, "_NET_WM_STATE_STICKY", False);
-    atoms.net_wm_window_type = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE", False);
-    atoms.net_wm_window_type_combo = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_COMBO", False);
-    atoms.net_wm_window_type_desktop = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
-    atoms.net_wm_window_type_dialog = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
-    atoms.net_wm_window_type_dock = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_DOCK", False);
-    atoms.net_wm_window_type_dnd = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_DND", False);
-    atoms.net_wm_window_type_dropdown_menu = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU", False);
-    atoms.net_wm_window_type_menu = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_MENU", False);
-    atoms.net_wm_window_type_normal = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_NORMAL", False);
-    atoms.net_wm_window_type_notification = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_NOTIFICATION", False);
-    atoms.net_wm_window_type_popup_menu = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_POPUP_MENU", False);
-    atoms.net_wm_window_type_splash = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_SPLASH", False);
-    atoms.net_wm_window_type_tooltip = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_TOOLTIP", False);
-    atoms.net_wm_window_type_toolbar = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_TOOLBAR", False);
-    atoms.net_wm_window_type_utility = XInternAtom (x_dpy, "_NET_WM_WINDOW_TYPE_UTILITY", False);
-    atoms.primary = XInternAtom (x_dpy, "PRIMARY", False);;
-    atoms.targets = XInternAtom (x_dpy, "STRING", False);
-    atoms.targets = XInternAtom (x_dpy, "TARGETS", False);
-    atoms.text = XInternAtom (x_dpy, "TEXT", False);
-    atoms.utf8_string = XInternAtom (x_dpy, "UTF8_STRING", False);
-    atoms.wm_change_state = XInternAtom (x_dpy, "WM_CHANGE_STATE", False);
-    atoms.wm_colormap_windows = XInternAtom (x_dpy, "WM_COLORMAP_WINDOWS", False);
-    atoms.wm_delete_window = XInternAtom (x_dpy, "WM_DELETE_WINDOW", False);
-    atoms.wm_hints = XInternAtom (x_dpy, "WM_HINTS", False);
-    atoms.wm_name = XInternAtom (x_dpy, "WM_NAME", False);
-    atoms.wm_normal_hints = XInternAtom (x_dpy, "WM_NORMAL_HINTS", False);
-    atoms.wm_protocols = XInternAtom (x_dpy, "WM_PROTOCOLS", False);
-    atoms.wm_state = XInternAtom (x_dpy, "WM_STATE", False);
-    atoms.wm_take_focus = XInternAtom (x_dpy, "WM_TAKE_FOCUS", False);
-    atoms.wm_transient_for = XInternAtom (x_dpy, "WM_TRANSIENT_FOR", False);
+    if (!x_atoms_init (x_dpy))
+    {
+        asl_log(aslc, NULL, ASL_LEVEL_ERR, "can't intern atoms");
+        exit(EXIT_FAILURE);
+    }
 
     if (!XShapeQueryExtension (x_dpy, &x_shape_event_base,
                                &x_shape_error_base))
@@ -338,6 +319,28 @@
     XineramaQueryExtension (x_dpy, &x_xinerama_event_base,
                             &x_xinerama_error_base);
 
+    /* Only needed for _NET_WM_SYNC_REQUEST, which we can live without */
+    if (XSyncQueryExtension (x_dpy, &x_sync_event_base, &x_sync_error_base))
+    {
+        int major, minor;
+
+        x_have_sync = XSyncInitialize (x_dpy, &major, &minor);
+    }
+
+    /* Heads come from RandR 1.5 monitors if we can get them, else from
+       Xinerama */
+#if RANDR_MAJOR > 1 || (RANDR_MAJOR == 1 && RANDR_MINOR >= 5)
+    {
+        int major, minor;
+
+        if (XRRQueryExtension (x_dpy, &x_randr_event_base, &x_randr_error_base)
+            && XRRQueryVersion (x_dpy, &major, &minor))
+        {
+            x_have_randr_monitors = major > 1 || (major == 1 && minor >= 5);
+        }
+    }
+#endif
+
     x_update_meta_modifier ();
 
     XAppleWMQueryVersion(x_dpy, &AppleWMMajorVersion, &AppleWMMinorVersion, &AppleWMPatchVersion);
@@ -400,6 +403,7 @@ static void x_shutdown (void) {
 
     XCloseDisplay (x_dpy);
     x_dpy = NULL;
+    x_trace_drain (trace_emit, NULL);
     exit(EXIT_SUCCESS);
 }
 
@@ -411,6 +415,7 @@ static void x_error_shutdown (void) {
         x_screen *s = node->data;
         [s error_shutdown];
     }
+    x_trace_drain (trace_emit, NULL);
     exit(EXIT_FAILURE);
 }
 
@@ -423,103 +428,197 @@ static void x_error_shutdown (void) {
 }
 
 
-/* Window menu management */
+/* Window menu management
+
+   The menu is kept here as an array of windows, each knowing its own
+   index, along with the UTF-8 titles and shortcuts last sent. Changes
+   only mark the menu dirty; x_flush_window_menu() sends it to the
+   server at most once per event batch. */
+
+typedef struct {
+    x_window *window;
+    char *title;			/* NULL if the window has no title */
+    char shortcut;
+} x_window_menu_item;
+
+static x_window_menu_item *window_menu;
+static int window_menu_length, window_menu_size;
+
+static BOOL window_menu_dirty, window_menu_check_dirty;
+static int window_menu_check = -1;	/* as last sent */
 
-static x_list *window_menu;
+unsigned long x_window_menu_updates, x_window_menu_updates_avoided;
 
 static void
 x_update_window_menu_focused (void)
 {
-    int n, m;
-
-    n = x_list_length (window_menu);
-    if (_is_active)
-        m = x_list_length (x_list_find (window_menu, _active_window));
-    else
-        m = 0;
-
-    if (m > 0)
-        XAppleWMSetWindowMenuCheck (x_dpy, n - m);
-    else
-        XAppleWMSetWindowMenuCheck (x_dpy, -1);
+    window_menu_check_dirty = YES;
 }
 
-static void
-x_update_window_menu (void)
+static BOOL
+x_update_window_menu_item (x_window_menu_item *item)
+{
+    x_window *w = item->window;
+    const char *title;
+    BOOL changed = NO;
+
+    title = w->_title != nil ? [w->_title UTF8String] : NULL;
+
+    if (title == NULL ? item->title != NULL
+        : item->title == NULL || strcmp (title, item->title) != 0)
+    {
+        free (item->title);
+        item->title = title != NULL ? strdup (title) : NULL;
+        changed = YES;
+    }
+
+    if (item->shortcut != w->_shortcut_index)
+    {
+        item->shortcut = w->_shortcut_index;
+        changed = YES;
+    }
+
+    return changed;
+}
+
+static BOOL
+x_flush_window_menu (void)
 {
     int nitems, i;
     const char **items = NULL;
     char *shortcuts = NULL;
-    x_list *node;
+    x_window *active;
+    int check;
+    BOOL wrote = NO;
 
-    nitems = x_list_length (window_menu);
-    if (nitems > 0)
+    if (window_menu_dirty)
     {
-        items = alloca (sizeof (char *) * nitems);
-        shortcuts = alloca (sizeof (char) * nitems);
-
-        for (i = 0, node = window_menu; node != NULL; node = node->next)
+        if (window_menu_length > 0)
         {
-            x_window *w = node->data;
+            items = alloca (sizeof (char *) * window_menu_length);
+            shortcuts = alloca (sizeof (char) * window_menu_length);
+        }
 
-            if (w->_title != nil)
+        for (nitems = i = 0; i < window_menu_length; i++)
+        {
+            if (window_menu[i].title != NULL)
             {
-                items[i] = [w->_title UTF8String];
-                shortcuts[i] = w->_shortcut_index;
-                i++;
+                items[nitems] = window_menu[i].title;
+                shortcuts[nitems] = window_menu[i].shortcut;
+                nitems++;
             }
-            else
-                nitems--;
         }
+
+        XAppleWMSetWindowMenuWithShortcuts (x_dpy, nitems, items, shortcuts);
+        x_window_menu_updates++;
+
+        /* Setting the menu clears the check mark */
+        window_menu_dirty = NO;
+        window_menu_check_dirty = YES;
+        window_menu_check = -1;
+        wrote = YES;
     }
 
-    XAppleWMSetWindowMenuWithShortcuts (x_dpy, nitems, items, shortcuts);
+    if (window_menu_check_dirty)
+    {
+        active = _is_active ? _active_window : nil;
+        check = active != nil ? active->_window_menu_index : -1;
 
-    x_update_window_menu_focused ();
+        if (check != window_menu_check || wrote)
+        {
+            XAppleWMSetWindowMenuCheck (x_dpy, check);
+            window_menu_check = check;
+            wrote = YES;
+        }
+
+        window_menu_check_dirty = NO;
+    }
+
+    return wrote;
 }
 
 void
 x_update_window_in_menu (id w)
 {
-    if (x_list_find (window_menu, w))
-    {
-        x_update_window_menu ();
-    }
+    x_window *xw = w;
+    BOOL changed;
+
+    if (xw->_window_menu_index < 0)
+        return;
+
+    changed = x_update_window_menu_item (&window_menu[xw->_window_menu_index]);
+    if (!changed || window_menu_dirty)
+        x_window_menu_updates_avoided++;
+
+    window_menu_dirty |= changed;
 }
 
 void
 x_add_window_to_menu (id w)
 {
-    if (!x_list_find (window_menu, w))
+    x_window *xw = w;
+    x_window_menu_item *item;
+
+    if (xw->_window_menu_index >= 0)
     {
-        window_menu = x_list_append (window_menu, [w retain]);
+        x_update_window_in_menu (w);
+        return;
     }
 
-    x_update_window_menu ();
+    if (window_menu_length == window_menu_size)
+    {
+        window_menu_size = MAX (16, window_menu_size * 2);
+        window_menu = realloc (window_menu, window_menu_size
+                               * sizeof (x_window_menu_item));
+    }
+
+    xw->_window_menu_index = window_menu_length;
+    item = &window_menu[window_menu_length++];
+    item->window = [xw retain];
+    item->title = NULL;
+    item->shortcut = 0;
+    x_update_window_menu_item (item);
+
+    if (window_menu_dirty)
+        x_window_menu_updates_avoided++;
+
+    window_menu_dirty = YES;
 }
 
 void
 x_remove_window_from_menu (id w)
 {
-    if (x_list_find (window_menu, w))
-    {
-        window_menu = x_list_remove (window_menu, w);
-        [w release];
-        x_update_window_menu ();
-    }
+    x_window *xw = w;
+    int i;
+
+    if (xw->_window_menu_index < 0)
+        return;
+
+    i = xw->_window_menu_index;
+    free (window_menu[i].title);
+
+    window_menu_length--;
+    memmove (window_menu + i, window_menu + i + 1,
+             (window_menu_length - i) * sizeof (x_window_menu_item));
+
+    for (; i < window_menu_length; i++)
+        window_menu[i].window->_window_menu_index = i;
+
+    xw->_window_menu_index = -1;
+    [xw release];
+
+    if (window_menu_dirty)
+        x_window_menu_updates_avoided++;
+
+    window_menu_dirty = YES;
 }
 
 void
 x_activate_window_in_menu (int n, Time timestamp)
 {
-    x_list *node;
-    x_window *w;
-
-    node = x_list_nth (window_menu, n);
-    if (node != nil)
+    if (n >= 0 && n < window_menu_length)
     {
-        w = node->data;
-        [w activate:timestamp];
+        [window_menu[n].window activate:timestamp];
     }
 }
 
@@ -559,7 +658,7 @@ static void x_error_shutdown (void) {
 }
 
 id
-x_get_window (Window xwindow_id)
+x_get_window_with_role (Window xwindow_id, x_window_role *role_ret)
 {
     x_list *node;
 
@@ -568,7 +667,7 @@ static void x_error_shutdown (void) {
         x_screen *s = node->data;
         x_window *w;
 
-        w = [s get_window:xwindow_id];
+        w = [s get_window:xwindow_id role:role_ret];
         if (w != nil)
             return w;
     }
@@ -576,6 +675,12 @@ static void x_error_shutdown (void) {
     return nil;
 }
 
+id
+x_get_window (Window xwindow_id)
+{
+    return x_get_window_with_role (xwindow_id, NULL);
+}
+
 id
 x_get_window_by_osx_id (xp_native_window_id osxwindow_id)
 {
@@ -851,6 +956,7 @@ static void start_auto_quit(void) {
 
 BOOL prefs_reload = NO;
 static BOOL do_shutdown = NO;
+static BOOL do_dump_stats = NO;
 
 static BOOL prefs_get_bool (CFStringRef key, BOOL def) {
     int ret;
@@ -883,6 +989,94 @@ static inline void prefs_read(void) {
     minimize_on_double_click = prefs_get_bool (CFSTR(PREFS_MINIMIZE_ON_DOUBLE_CLICK), minimize_on_double_click);
     show_shortcut       = prefs_get_bool (CFSTR (PREFS_SHOW_SHORTCUT), show_shortcut);
     enable_key_equivalents = prefs_get_bool (CFSTR (PREFS_ENABLE_KEY_EQUIVALENTS), enable_key_equivalents);
+    smart_placement     = prefs_get_bool (CFSTR (PREFS_SMART_PLACEMENT), smart_placement);
+    debug_trace         = prefs_get_bool (CFSTR (PREFS_DEBUG_TRACE), debug_trace);
+    verify_hit_test     = prefs_get_bool (CFSTR (PREFS_VERIFY_HIT_TEST), verify_hit_test);
+
+    x_trace_set_enabled (debug_trace);
+}
+
+/* Write out whatever was left to do at the end of a batch of work */
+void x_flush_deferred (void) {
+    x_list *node;
+    BOOL wrote = NO;
+
+    x_stats_begin (flush_stats_slot);
+
+    if (x_flush_properties ())
+        wrote = YES;
+
+    if (x_flush_window_menu ())
+        wrote = YES;
+
+    for (node = screen_list; node != NULL; node = node->next) {
+        x_screen *s = node->data;
+        wrote |= [s flush_deferred];
+    }
+
+    if (wrote)
+        XFlush (x_dpy);
+
+    x_stats_end ();
+}
+
+/* Log everything we've been counting, for SIGUSR1 */
+static void dump_stats (void) {
+    char buf[512];
+    int i;
+
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE, "statistics:");
+
+    for (i = 0; i < x_stats_length (); i++) {
+        const x_stats_slot *slot = x_stats_get (i);
+
+        if (slot->count == 0 && slot->round_trips == 0)
+            continue;
+
+        x_stats_format (slot, buf, sizeof (buf));
+        asl_log(aslc, NULL, ASL_LEVEL_NOTICE, "  %s", buf);
+    }
+
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  events: %lu dispatched, %lu coalesced, %lu of our own suppressed",
+            x_input_events_dispatched, x_input_events_coalesced,
+            x_input_events_suppressed);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  server grabs: %lu, held %.3fms in all",
+            x_server_grabs, x_server_grab_time * 1000.0);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  property cache: %lu hits, %lu misses; writes: %lu, %lu suppressed",
+            x_property_cache_hits, x_property_cache_misses,
+            x_property_writes, x_property_writes_suppressed);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  root lists: %lu writes, %lu appends, %lu avoided",
+            x_root_list_writes, x_root_list_appends, x_root_list_writes_avoided);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  window menu: %lu updates, %lu avoided",
+            x_window_menu_updates, x_window_menu_updates_avoided);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  frames: %lu draws, %lu avoided, %lu decorations coalesced; "
+            "metrics: %lu queries, %lu cached",
+            frame_draws, frame_draws_avoided, x_decorations_coalesced,
+            frame_metrics_queries, frame_metrics_hits);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  frame hit tests: %lu, %lu server queries, %lu mismatches",
+            frame_hit_tests, frame_hit_test_queries, frame_hit_test_mismatches);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  sync requests: %lu, %lu timed out",
+            x_sync_requests, x_sync_timeouts);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  frame shapes: %lu requests, %lu avoided, %lu reshapes coalesced",
+            x_shape_requests, x_shape_requests_avoided, x_reshapes_coalesced);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  screen changes: %lu geometry updates, %lu debounced; "
+            "windows %lu revalidated, %lu skipped",
+            x_geometry_updates, x_screen_changes_debounced,
+            x_windows_revalidated, x_windows_revalidation_skipped);
+    asl_log(aslc, NULL, ASL_LEVEL_NOTICE,
+            "  list nodes: %lu allocated, %lu freed, from %lu blocks",
+            x_list_nodes_allocated, x_list_nodes_freed,
+            x_list_blocks_allocated);
 }
 
 static void signal_handler_cb(CFRunLoopObserverRef observer,
@@ -891,8 +1085,14 @@ static void signal_handler_cb(CFRunLoopObserverRef observer,
     if(do_shutdown)
         x_shutdown();
 
+    if(do_dump_stats) {
+        do_dump_stats = NO;
+        dump_stats();
+    }
+
     if(prefs_reload) {
-        x_list *s_node, *w_node;
+        x_list *s_node;
+        x_chain_node *w_node;
         x_window *w;
         x_screen *s;
 
@@ -902,7 +1102,7 @@ static void signal_handler_cb(CFRunLoopObserverRef observer,
         /* We need to update the click_through/shading policy on our windows */
         for (s_node = screen_list; s_node != NULL; s_node = s_node->next) {
             s = s_node->data;
-            for(w_node = s->_window_list; w_node != NULL; w_node = w_node->next) {
+            for(w_node = s->_window_list.head; w_node != NULL; w_node = w_node->next) {
                 w = w_node->data;
                 if(w->_shadable) {
                     if(!window_shading)
@@ -914,6 +1114,9 @@ static void signal_handler_cb(CFRunLoopObserverRef observer,
             }
         }
     }
+
+    /* Catch anything done outside of x_input_run, by timers or the dock */
+    x_flush_deferred();
 }
 
 static void signal_handler_cb_init(void) {
@@ -926,10 +1129,31 @@ static void signal_handler_cb_init(void) {
     CFRunLoopAddObserver(CFRunLoopGetCurrent(), ref, kCFRunLoopDefaultMode);
 }
 
+static void dock_pref_changed_cb(CFNotificationCenterRef center, void *observer,
+                CFStringRef name, const void *object, CFDictionaryRef userInfo)
+{
+    x_list *node;
+
+    for (node = screen_list; node != NULL; node = node->next) {
+        x_screen *s = node->data;
+        [s update_dock];
+    }
+}
+
 static void appearance_pref_changed_cb(CFNotificationCenterRef center, void *observer,
                 CFStringRef name, const void *object, CFDictionaryRef userInfo)
 {
+    x_list *node;
+
+    frame_metrics_invalidate();
     prefs_read();
+
+    /* Redrawing measures the frames again, hit maps and all, ahead of
+       the next press */
+    for (node = screen_list; node != NULL; node = node->next) {
+        x_screen *s = node->data;
+        [s foreach_window:@selector (decorate)];
+    }
 }
 
 
@@ -940,6 +1164,9 @@ static void signal_handler (int sig) {
         case SIGHUP:
             prefs_reload = YES;
             break;
+        case SIGUSR1:
+            do_dump_stats = YES;
+            break;
         default:
             do_shutdown = YES;
             break;
@@ -999,11 +1226,18 @@ int main (int argc, const char *argv[]) {
         asl_opts |= ASL_OPT_STDERR;
 
     aslc = asl_open("quartz-wm", asl_facility, asl_opts);
+    trace_aslc = asl_open("quartz-wm", asl_facility, asl_opts);
+
+    if(!x_trace_start_thread(trace_emit, NULL, 100))
+        asl_log(aslc, NULL, ASL_LEVEL_WARNING, "couldn't start the trace thread, debug logging will be lost.");
 
     signal_handler_cb_init();
     CFNotificationCenterAddObserver(CFNotificationCenterGetDistributedCenter(),
         NULL, appearance_pref_changed_cb, CFSTR("AppleNoRedisplayAppearancePreferenceChanged"),
         NULL, CFNotificationSuspensionBehaviorDeliverImmediately);
+    CFNotificationCenterAddObserver(CFNotificationCenterGetDistributedCenter(),
+        NULL, dock_pref_changed_cb, CFSTR("com.apple.dock.prefchanged"),
+        NULL, CFNotificationSuspensionBehaviorDeliverImmediately);
     qwm_dock_event_set_handler(dock_event_handler);
     qwm_dock_init(0);
     x_init ();
@@ -1011,6 +1245,7 @@ int main (int argc, const char *argv[]) {
     signal (SIGINT, signal_handler);
     signal (SIGTERM, signal_handler);
     signal (SIGHUP, signal_handler);
+    signal (SIGUSR1, signal_handler);
     signal (SIGPIPE, SIG_IGN);
 
     while (1) {
@@ -1026,150 +1261,27 @@ int main (int argc, const char *argv[]) {
     return 0;
 }
 
-// for atom in $(grep XInternAtom main.m | grep \" | cut -f2 -d\" | sort -u); do printf "    if(atom == atoms.$(echo ${atom} | sed 's/^_//' | tr [:upper:] [:lower:]))\n        return \"${atom}\";\n"; done
 const char *str_for_atom(Atom atom) {
-    if(atom == atoms.atom)
-        return "ATOM";
-    if(atom == atoms.clipboard)
-        return "CLIPBOARD";
-    if(atom == atoms.cstring)
-        return "CSTRING";
-    if(atom == atoms.multiple)
-        return "MULTIPLE";
-    if(atom == atoms.primary)
-        return "PRIMARY";
-    if(atom == atoms.string)
-        return "STRING";
-    if(atom == atoms.targets)
-        return "TARGETS";
-    if(atom == atoms.text)
-        return "TEXT";
-    if(atom == atoms.utf8_string)
-        return "UTF8_STRING";
-    if(atom == atoms.wm_change_state)
-        return "WM_CHANGE_STATE";
-    if(atom == atoms.wm_colormap_windows)
-        return "WM_COLORMAP_WINDOWS";
-    if(atom == atoms.wm_delete_window)
-        return "WM_DELETE_WINDOW";
-    if(atom == atoms.wm_hints)
-        return "WM_HINTS";
-    if(atom == atoms.wm_name)
-        return "WM_NAME";
-    if(atom == atoms.wm_normal_hints)
-        return "WM_NORMAL_HINTS";
-    if(atom == atoms.wm_protocols)
-        return "WM_PROTOCOLS";
-    if(atom == atoms.wm_state)
-        return "WM_STATE";
-    if(atom == atoms.wm_take_focus)
-        return "WM_TAKE_FOCUS";
-    if(atom == atoms.wm_transient_for)
-        return "WM_TRANSIENT_FOR";
-    if(atom == atoms.apple_no_order_in)
-        return "_APPLE_NO_ORDER_IN";
-    if(atom == atoms.motif_wm_hints)
-        return "_MOTIF_WM_HINTS";
-    if(atom == atoms.native_screen_origin)
-        return "_NATIVE_SCREEN_ORIGIN";
-    if(atom == atoms.native_window_id)
-        return "_NATIVE_WINDOW_ID";
-    if(atom == atoms.net_active_window)
-        return "_NET_ACTIVE_WINDOW";
-    if(atom == atoms.net_close_window)
-        return "_NET_CLOSE_WINDOW";
-    if(atom == atoms.net_wm_action_close)
-        return "_NET_WM_ACTION_CLOSE";
-    if(atom == atoms.net_wm_action_fullscreen)
-        return "_NET_WM_ACTION_FULLSCREEN";
-    if(atom == atoms.net_wm_action_maximize_horz)
-        return "_NET_WM_ACTION_MAXIMIZE_HORZ";
-    if(atom == atoms.net_wm_action_maximize_vert)
-        return "_NET_WM_ACTION_MAXIMIZE_VERT";
-    if(atom == atoms.net_wm_action_minimize)
-        return "_NET_WM_ACTION_MINIMIZE";
-    if(atom == atoms.net_wm_action_move)
-        return "_NET_WM_ACTION_MOVE";
-    if(atom == atoms.net_wm_action_resize)
-        return "_NET_WM_ACTION_RESIZE";
-    if(atom == atoms.net_wm_action_shade)
-        return "_NET_WM_ACTION_SHADE";
-    if(atom == atoms.net_wm_allowed_actions)
-        return "_NET_WM_ALLOWED_ACTIONS";
-    if(atom == atoms.net_wm_name)
-        return "_NET_WM_NAME";
-    if(atom == atoms.net_wm_state)
-        return "_NET_WM_STATE";
-    if(atom == atoms.net_wm_state_fullscreen)
-        return "_NET_WM_STATE_FULLSCREEN";
-    if(atom == atoms.net_wm_state_hidden)
-        return "_NET_WM_STATE_HIDDEN";
-    if(atom == atoms.net_wm_state_maximized_horz)
-        return "_NET_WM_STATE_MAXIMIZED_HORZ";
-    if(atom == atoms.net_wm_state_maximized_vert)
-        return "_NET_WM_STATE_MAXIMIZED_VERT";
-    if(atom == atoms.net_wm_state_modal)
-        return "_NET_WM_STATE_MODAL";
-    if(atom == atoms.net_wm_state_shaded)
-        return "_NET_WM_STATE_SHADED";
-    if(atom == atoms.net_wm_state_skip_pager)
-        return "_NET_WM_STATE_SKIP_PAGER";
-    if(atom == atoms.net_wm_state_skip_taskbar)
-        return "_NET_WM_STATE_SKIP_TASKBAR";
-    if(atom == atoms.net_wm_state_sticky)
-        return "_NET_WM_STATE_STICKY";
-    if(atom == atoms.net_wm_window_type)
-        return "_NET_WM_WINDOW_TYPE";
-    if(atom == atoms.net_wm_window_type_combo)
-        return "_NET_WM_WINDOW_TYPE_COMBO";
-    if(atom == atoms.net_wm_window_type_desktop)
-        return "_NET_WM_WINDOW_TYPE_DESKTOP";
-    if(atom == atoms.net_wm_window_type_dialog)
-        return "_NET_WM_WINDOW_TYPE_DIALOG";
-    if(atom == atoms.net_wm_window_type_dnd)
-        return "_NET_WM_WINDOW_TYPE_DND";
-    if(atom == atoms.net_wm_window_type_dock)
-        return "_NET_WM_WINDOW_TYPE_DOCK";
-    if(atom == atoms.net_wm_window_type_dropdown_menu)
-        return "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU";
-    if(atom == atoms.net_wm_window_type_menu)
-        return "_NET_WM_WINDOW_TYPE_MENU";
-    if(atom == atoms.net_wm_window_type_normal)
-        return "_NET_WM_WINDOW_TYPE_NORMAL";
-    if(atom == atoms.net_wm_window_type_notification)
-        return "_NET_WM_WINDOW_TYPE_NOTIFICATION";
-    if(atom == atoms.net_wm_window_type_popup_menu)
-        return "_NET_WM_WINDOW_TYPE_POPUP_MENU";
-    if(atom == atoms.net_wm_window_type_splash)
-        return "_NET_WM_WINDOW_TYPE_SPLASH";
-    if(atom == atoms.net_wm_window_type_toolbar)
-        return "_NET_WM_WINDOW_TYPE_TOOLBAR";
-    if(atom == atoms.net_wm_window_type_tooltip)
-        return "_NET_WM_WINDOW_TYPE_TOOLTIP";
-    if(atom == atoms.net_wm_window_type_utility)
-        return "_NET_WM_WINDOW_TYPE_UTILITY";
-    return "(unknown atom)";
+    const char *name = x_atom_name(atom);
+
+    return name != NULL ? name : "(unknown atom)";
 }
 
-void debug_asl (const char *file, const char *function, int line, const char *fmt, ...) {
-    va_list args;
-    aslmsg msg = asl_new(ASL_TYPE_MSG);
+/* Writes out a DB() record, from the trace thread or at exit */
+static void trace_emit (const char *file, const char *function, int line,
+                        uint64_t time, const char *text, void *data) {
+    aslmsg msg = NULL;
 
-    if(msg) {
-        char *_line;
+    if(file && (msg = asl_new(ASL_TYPE_MSG))) {
+        char _line[16];
 
         asl_set(msg, "File", file);
         asl_set(msg, "Function", function);
-        asprintf(&_line, "%d", line);
-        if(_line) {
-            asl_set(msg, "Line", _line);
-            free(_line);
-        }
+        snprintf(_line, sizeof(_line), "%d", line);
+        asl_set(msg, "Line", _line);
     }
 
-    va_start(args, fmt);
-    asl_vlog(aslc, msg, ASL_LEVEL_DEBUG, fmt, args);
-    va_end(args);
+    asl_log(trace_aslc, msg, ASL_LEVEL_DEBUG, "%s", text);
 
     if(msg)
         asl_free(msg);
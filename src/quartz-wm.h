@@ -40,6 +40,7 @@
 #include "x-list.h"
 #include "x11-geometry.h"
 #include "dock-support.h"
+#include "x-trace.h"
 
 #define X_ROOT_WINDOW_EVENTS				\
 (SubstructureRedirectMask | SubstructureNotifyMask	\
@@ -57,7 +58,7 @@
 | ButtonMotionMask | PointerMotionHintMask		\
 | SubstructureRedirectMask | FocusChangeMask	\
 | EnterWindowMask | LeaveWindowMask		\
-| ExposureMask)
+| ExposureMask | PropertyChangeMask)
 
 #define X_TRACKING_WINDOW_EVENTS			\
 (EnterWindowMask | LeaveWindowMask)
@@ -68,6 +69,15 @@
 
 #define DRAG_THRESHOLD 3
 
+/* What an XID in the window index is to the x_window it belongs to */
+typedef enum {
+    X_WINDOW_ROLE_CLIENT,
+    X_WINDOW_ROLE_FRAME,
+    X_WINDOW_ROLE_TRACKING,
+    X_WINDOW_ROLE_GROWBOX,
+    X_WINDOW_ROLE_SYNC_ALARM,		/* not a window, but an XID all the same */
+} x_window_role;
+
 #define PREFS_FFM "wm_ffm"
 #define PREFS_CLICK_THROUGH "wm_click_through"
 #define PREFS_LIMIT_SIZE "wm_limit_size"
@@ -79,10 +89,13 @@
 #define PREFS_MINIMIZE_ON_DOUBLE_CLICK "AppleMiniaturizeOnDoubleClick"
 #define PREFS_SHOW_SHORTCUT "wm_show_shortcut"
 #define PREFS_ENABLE_KEY_EQUIVALENTS "enable_key_equivalents"
+#define PREFS_SMART_PLACEMENT "wm_smart_placement"
+#define PREFS_DEBUG_TRACE "wm_debug_trace"
+#define PREFS_VERIFY_HIT_TEST "wm_verify_hit_test"
 
 /* from main.m */
 extern x_list *screen_list;
-extern BOOL focus_follows_mouse, focus_click_through, limit_window_size, focus_on_new_window, window_shading, rootless, auto_quit, minimize_on_double_click, show_shortcut, enable_key_equivalents;
+extern BOOL focus_follows_mouse, focus_click_through, limit_window_size, focus_on_new_window, window_shading, rootless, auto_quit, minimize_on_double_click, show_shortcut, enable_key_equivalents, smart_placement, debug_trace, verify_hit_test;
 extern int auto_quit_timeout;
 extern void x_grab_server (Bool do_sync);
 extern void x_ungrab_server (void);
@@ -91,6 +104,7 @@
 extern id x_get_screen (Screen *xs);
 extern id x_get_screen_with_root (Window xwindow_id);
 extern id x_get_window (Window xwindow_id);
+extern id x_get_window_with_role (Window xwindow_id, x_window_role *role_ret);
 extern id x_get_window_by_osx_id (xp_native_window_id osxwindow_id);
 extern void x_set_active_window (id w);
 extern id x_get_active_window (void);
@@ -108,6 +122,10 @@
 extern int x_allocate_window_shortcut (void);
 extern void x_release_window_shortcut (int x);
 extern Time x_current_timestamp (void);
+extern void x_flush_deferred (void);
+extern unsigned long x_window_menu_updates, x_window_menu_updates_avoided;
+extern unsigned long x_server_grabs;
+extern double x_server_grab_time;
 
 extern aslclient aslc;
 extern Display *x_dpy;
@@ -115,11 +133,28 @@
 extern int x_shape_event_base, x_shape_error_base;
 extern int x_apple_wm_event_base, x_apple_wm_error_base;
 extern int x_xinerama_event_base, x_xinerama_error_base;
+extern int x_sync_event_base, x_sync_error_base;
+extern int x_randr_event_base, x_randr_error_base;
+extern BOOL x_have_sync;
+extern BOOL x_have_randr_monitors;
 extern BOOL prefs_reload;
 
+/* from x-screen.m */
+extern unsigned long x_root_list_writes, x_root_list_appends, x_root_list_writes_avoided;
+extern unsigned long x_decorations_coalesced, x_reshapes_coalesced;
+extern unsigned long x_geometry_updates, x_screen_changes_debounced;
+extern unsigned long x_windows_revalidated, x_windows_revalidation_skipped;
+
+/* from x-window.m */
+extern unsigned long x_sync_requests, x_sync_timeouts;
+extern unsigned long x_shape_requests, x_shape_requests_avoided;
+
 /* from x-input.m */
 extern void x_input_register (void);
 extern void x_input_run (void);
+extern unsigned long x_input_events_dispatched, x_input_events_coalesced;
+extern void x_input_expect_event (Window id, unsigned long serial, int type);
+extern unsigned long x_input_events_suppressed;
 
 /* Try to work with older libAppleWM for Codeweavers support */
 typedef Bool (* XAppleWMSendPSNProcPtr)(Display *dpy);
@@ -128,70 +163,7 @@
 typedef Bool (* XAppleWMAttachTransientProcPtr)(Display *dpy, Window child, Window parent);
 extern XAppleWMAttachTransientProcPtr _XAppleWMAttachTransient;
 
-struct atoms_struct_t {
-    Atom apple_no_order_in;
-    Atom atom;
-    Atom clipboard;
-    Atom cstring;
-    Atom motif_wm_hints;
-    Atom multiple;
-    Atom native_screen_origin;
-    Atom native_window_id;
-    Atom net_active_window;
-    Atom net_close_window;
-    Atom net_wm_action_close;
-    Atom net_wm_action_fullscreen;
-    Atom net_wm_action_maximize_horz;
-    Atom net_wm_action_maximize_vert;
-    Atom net_wm_action_minimize;
-    Atom net_wm_action_move;
-    Atom net_wm_action_resize;
-    Atom net_wm_action_shade;
-    Atom net_wm_allowed_actions;
-    Atom net_wm_name;
-    Atom net_wm_state;
-    Atom net_wm_state_fullscreen;
-    Atom net_wm_state_hidden;
-    Atom net_wm_state_maximized_horz;
-    Atom net_wm_state_maximized_vert;
-    Atom net_wm_state_modal;
-    Atom net_wm_state_shaded;
-    Atom net_wm_state_skip_pager;
-    Atom net_wm_state_skip_taskbar;
-    Atom net_wm_state_sticky;
-    Atom net_wm_window_type;
-    Atom net_wm_window_type_combo;
-    Atom net_wm_window_type_desktop;
-    Atom net_wm_window_type_dialog;
-    Atom net_wm_window_type_dropdown_menu;
-    Atom net_wm_window_type_dnd;
-    Atom net_wm_window_type_dock;
-    Atom net_wm_window_type_menu;
-    Atom net_wm_window_type_normal;
-    Atom net_wm_window_type_notification;
-    Atom net_wm_window_type_popup_menu;
-    Atom net_wm_window_type_splash;
-    Atom net_wm_window_type_toolbar;
-    Atom net_wm_window_type_tooltip;
-    Atom net_wm_window_type_utility;
-    Atom primary;
-    Atom string;
-    Atom targets;
-    Atom text;
-    Atom utf8_string;
-    Atom wm_change_state;
-    Atom wm_colormap_windows;
-    Atom wm_delete_window;
-    Atom wm_hints;
-    Atom wm_name;
-    Atom wm_normal_hints;
-    Atom wm_protocols;
-    Atom wm_state;
-    Atom wm_take_focus;
-    Atom wm_transient_for;
-};
-
-extern struct atoms_struct_t atoms;
+#include "atoms.h"
 
 /* Dock Events */
 #include "dock-support.h"
@@ -199,10 +171,15 @@
 
 /* Debugging support */
 extern void debug_printf (const char *fmt, ...) _X_ATTRIBUTE_PRINTF(1,2);
-extern void debug_asl (const char *file, const char *function, int line, const char *fmt, ...) _X_ATTRIBUTE_PRINTF(4,5);
 extern const char *str_for_atom(Atom atom);
 
-#define DB(msg, args...) debug_asl(__FILE__, __FUNCTION__, __LINE__, msg, ##args);
+/* Nothing is evaluated unless tracing is on, see x-trace.h. Only the
+   format's address is recorded, so it has to be a string literal. */
+#define DB(msg, args...)						\
+do {									\
+    if (x_trace_enabled)						\
+        x_trace (__FILE__, __FUNCTION__, __LINE__, "" msg, ##args);	\
+} while (0)
 #define TRACE() DB("TRACE")
 
 #endif /* QUARTZ_WM_H */
@@ -31,8 +31,37 @@
 #include <X11/Xlib.h>
 #undef   Cursor
 
+#include <X11/Xutil.h>
+
 extern int x_get_property (Window xwindow_id, Atom atom, long *dest,
                            unsigned int dest_size, unsigned int min_items);
 extern NSString *x_get_string_property (Window xwindow_id, Atom atom);
+extern NSString *x_get_text_property (Window xwindow_id, Atom atom);
+extern XWMHints *x_get_wm_hints (Window xwindow_id);
+extern Status x_get_wm_normal_hints (Window xwindow_id, XSizeHints *hints,
+                                     long *supplied);
+extern Status x_get_id_list_property (Window xwindow_id, Atom atom, Atom type,
+                                      XID **list_ret, int *count_ret);
+extern Status x_get_window_attributes (Window xwindow_id,
+                                       XWindowAttributes *attr);
+extern Bool x_get_shape_extents (Window xwindow_id, Bool *bounding_shaped,
+                                 unsigned int *width, unsigned int *height);
+
+/* Batched fetching of the state needed to adopt windows */
+extern void x_prefetch_windows (const Window *ids, unsigned int n,
+                                Bool attributes, const Atom *property_atoms,
+                                unsigned int n_atoms);
+
+/* Properties of watched windows are cached until they change */
+extern void x_property_cache_watch (Window xwindow_id);
+extern void x_property_cache_invalidate (Window xwindow_id, Atom atom);
+extern void x_window_cache_forget (Window xwindow_id);
+extern unsigned long x_property_cache_hits, x_property_cache_misses;
+
+/* Write-back of the properties we own on client windows */
+extern void x_set_property_deferred (Window xwindow_id, Atom atom, Atom type,
+                                     const long *data, int n);
+extern Bool x_flush_properties (void);
+extern unsigned long x_property_writes, x_property_writes_suppressed;
 
 #endif /* UTILS_H */
@@ -28,48 +28,324 @@
 
 #include "utils.h"
 #include "quartz-wm.h"
+#include "x-hash.h"
+#include "x-stats.h"
 
 #include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/shape.h>
+
+#include <stdint.h>
+
+/* Properties are always fetched whole. This is in 32-bit units and is
+   kept small enough that the server can't overflow it into bytes. */
+#define PROPERTY_MAX_LENGTH 0x1000000
+
+/* Per-window store of state read from the server. Attributes and shape
+   extents gathered by x_prefetch_windows() are consumed by the first
+   x_get_... call that wants them. Properties are kept for as long as the
+   window is watched (we're selecting for its PropertyNotify events, so
+   x_property_cache_invalidate() will be called when one changes);
+   for other windows they're dropped once read.
+
+   Properties the window manager owns (WM_STATE, _NET_WM_STATE, ...) are
+   written through the store with x_set_property_deferred(). Their
+   entries hold the value we want, are never invalidated by the
+   client, and are written to the server by x_flush_properties() only
+   if they differ from what it already has. */
+
+typedef struct x_property_entry_struct x_property_entry;
+
+struct x_property_entry_struct {
+    x_property_entry *next;
+    unsigned cached :1;			/* owned by a window's store */
+    unsigned owned :1;			/* set by us, see above */
+    unsigned dirty :1;			/* not yet written to the server */
+    unsigned have_published :1;
+    Atom atom;
+    Atom type;				/* None if not set */
+    int format;
+    unsigned long nitems;
+    unsigned char *data;		/* format 32 data is stored as longs,
+					   format 8 data is NUL terminated */
+
+    /* For dirty entries, what the server has (if we know) */
+    Atom published_type;
+    unsigned long n_published;
+    long *published;
+};
+
+typedef struct {
+    unsigned watched :1;
+    unsigned dirty :1;			/* in dirty_windows */
+    unsigned have_attributes :1;
+    unsigned have_shape :1;
+    XWindowAttributes attributes;
+    Bool bounding_shaped;
+    unsigned int bounding_width, bounding_height;
+    x_property_entry *properties;
+} x_window_store;
+
+static x_hash_table *window_store;
+
+/* Windows with deferred property writes */
+static Window *dirty_windows;
+static unsigned int n_dirty_windows, dirty_windows_size;
+
+unsigned long x_property_cache_hits, x_property_cache_misses;
+unsigned long x_property_writes, x_property_writes_suppressed;
+
+static x_window_store *
+get_store (Window xwindow_id, Bool create)
+{
+    x_window_store *store;
+
+    if (window_store == NULL)
+    {
+        if (!create)
+            return NULL;
+        window_store = x_hash_table_new ();
+    }
+
+    store = x_hash_table_lookup (window_store, xwindow_id, NULL);
+    if (store == NULL && create)
+    {
+        store = calloc (1, sizeof (x_window_store));
+        x_hash_table_insert (window_store, xwindow_id, store, 0);
+    }
+
+    return store;
+}
+
+static void
+free_property_entry (x_property_entry *entry)
+{
+    free (entry->published);
+    free (entry->data);
+    free (entry);
+}
+
+static x_property_entry *
+find_property_entry (x_window_store *store, Atom atom)
+{
+    x_property_entry *entry;
+
+    for (entry = store->properties; entry != NULL; entry = entry->next)
+    {
+        if (entry->atom == atom)
+            return entry;
+    }
+
+    return NULL;
+}
+
+static void
+remove_property_entry (x_window_store *store, Atom atom)
+{
+    x_property_entry **prev, *entry;
+
+    for (prev = &store->properties; *prev != NULL; prev = &(*prev)->next)
+    {
+        entry = *prev;
+        if (entry->atom == atom)
+        {
+            *prev = entry->next;
+            free_property_entry (entry);
+            return;
+        }
+    }
+}
+
+/* Called when done with the result of get_property_entry() */
+static void
+release_property_entry (x_property_entry *entry)
+{
+    if (!entry->cached)
+        free_property_entry (entry);
+}
+
+void
+x_property_cache_watch (Window xwindow_id)
+{
+    x_window_store *store;
+    x_property_entry *entry;
+
+    store = get_store (xwindow_id, True);
+    store->watched = YES;
+
+    for (entry = store->properties; entry != NULL; entry = entry->next)
+        entry->cached = YES;
+}
+
+void
+x_property_cache_invalidate (Window xwindow_id, Atom atom)
+{
+    x_window_store *store;
+    x_property_entry *entry;
+
+    store = get_store (xwindow_id, False);
+    if (store == NULL)
+        return;
+
+    /* Notifications for properties we own are only echoes of our own
+       writes; the store already has the value. */
+    entry = find_property_entry (store, atom);
+    if (entry != NULL && !entry->owned)
+        remove_property_entry (store, atom);
+}
+
+static Bool flush_store (Window xwindow_id, x_window_store *store);
+
+void
+x_window_cache_forget (Window xwindow_id)
+{
+    x_window_store *store;
+    x_property_entry *entry, *next;
+
+    store = get_store (xwindow_id, False);
+    if (store == NULL)
+        return;
+
+    /* e.g. the WithdrawnState of a window being removed */
+    if (store->dirty)
+        flush_store (xwindow_id, store);
+
+    for (entry = store->properties; entry != NULL; entry = next)
+    {
+        next = entry->next;
+        free_property_entry (entry);
+    }
+
+    x_hash_table_remove (window_store, xwindow_id);
+    free (store);
+}
+
+static x_property_entry *
+property_entry_from_data (Atom atom, Atom type, int format,
+                          unsigned long nitems, const void *data,
+                          Bool data_is_long)
+{
+    x_property_entry *entry;
+    unsigned long i;
+
+    entry = calloc (1, sizeof (x_property_entry));
+    entry->atom = atom;
+    entry->type = type;
+    entry->format = format;
+    entry->nitems = nitems;
+
+    switch (format)
+    {
+        case 32:
+            entry->data = malloc ((nitems + 1) * sizeof (long));
+            for (i = 0; i < nitems; i++)
+            {
+                ((long *) entry->data)[i] = (data_is_long
+                                             ? ((const long *) data)[i]
+                                             : (long) ((const int32_t *) data)[i]);
+            }
+            break;
+
+        case 16:
+            entry->data = malloc ((nitems + 1) * sizeof (short));
+            memcpy (entry->data, data, nitems * sizeof (short));
+            break;
+
+        default:
+            entry->data = malloc (nitems + 1);
+            memcpy (entry->data, data, nitems);
+            entry->data[nitems] = 0;
+            break;
+    }
+
+    return entry;
+}
+
+/* Returns the whole property, either from the window's store or with
+   one GetProperty request. Pass the result to release_property_entry(). */
+
+static x_property_entry *
+get_property_entry (Window xwindow_id, Atom atom)
+{
+    x_window_store *store;
+    x_property_entry **prev, *entry;
+    Atom type;
+    int format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
+
+    store = get_store (xwindow_id, False);
+    if (store != NULL)
+    {
+        for (prev = &store->properties; *prev != NULL; prev = &(*prev)->next)
+        {
+            entry = *prev;
+            if (entry->atom == atom)
+            {
+                if (store->watched || entry->owned)
+                {
+                    x_property_cache_hits++;
+                }
+                else
+                {
+                    *prev = entry->next;
+                    entry->next = NULL;
+                }
+                return entry;
+            }
+        }
+    }
+
+    if (store != NULL && store->watched)
+        x_property_cache_misses++;
+
+    x_stats_round_trip ();
+    if (XGetWindowProperty (x_dpy, xwindow_id, atom, 0, PROPERTY_MAX_LENGTH,
+                            False, AnyPropertyType, &type, &format,
+                            &nitems, &bytes_after, &data) != Success)
+    {
+        return NULL;
+    }
+
+    entry = property_entry_from_data (atom, type, format,
+                                      type != None ? nitems : 0,
+                                      data, True);
+
+    if (data != NULL)
+        XFree (data);
+
+    if (store != NULL && store->watched)
+    {
+        entry->cached = YES;
+        entry->next = store->properties;
+        store->properties = entry;
+    }
+
+    return entry;
+}
 
 int
 x_get_property (Window xwindow_id, Atom atom, long *dest,
                 unsigned int dest_size, unsigned int min_items)
 {
-    Atom type;
-    int format;
+    x_property_entry *entry;
     unsigned int i;
-    unsigned long nitems;
-    unsigned char *data = 0;
     int ret = 0;
 
-    do {
-        long long_length = 32;
-        u_long bytes_after;
-        while (1)
-        {
-            if (data != NULL)
-                XFree (data);
-
-            if (XGetWindowProperty (x_dpy, xwindow_id, atom, 0, long_length, False,
-                                    AnyPropertyType, &type, &format,
-                                    &nitems, &bytes_after, &data) != Success)
-                return 0;
-            if (type == None)
-                return 0;
-            if (bytes_after == 0)
-                break;
-            long_length += (bytes_after / sizeof(unsigned long)) + 1;
-        }
-    } while (0);
+    entry = get_property_entry (xwindow_id, atom);
+    if (entry == NULL)
+        return 0;
 
-    if (format == 32 && nitems >= min_items)
+    if (entry->type != None && entry->format == 32 && entry->nitems >= min_items)
     {
-        for (i = 0; i < MIN (nitems, dest_size); i++)
-            dest[i] = ((unsigned long *) data)[i];
+        for (i = 0; i < MIN (entry->nitems, dest_size); i++)
+            dest[i] = ((long *) entry->data)[i];
         ret = i;
     }
 
-    XFree (data);
+    release_property_entry (entry);
 
     return ret;
 }
@@ -77,40 +353,563 @@
 NSString *
 x_get_string_property (Window xwindow_id, Atom atom)
 {
-    Atom type;
-    int format;
-    unsigned long nitems;
-    unsigned char *data = 0;
+    x_property_entry *entry;
     NSString *ret = nil;
 
-    do {
-        long long_length = 32;
-        u_long bytes_after;
-        while (1)
+    entry = get_property_entry (xwindow_id, atom);
+    if (entry == NULL)
+        return nil;
+
+    if (entry->type != None && entry->format == 8) {
+        if (entry->type == atoms.utf8_string)
+            ret = [NSString stringWithUTF8String:(char *) entry->data];
+        else
+            ret = [NSString stringWithCString:(char *) entry->data encoding:NSASCIIStringEncoding];
+    }
+
+    release_property_entry (entry);
+
+    return ret;
+}
+
+/* Like XGetWMName(), but decoded to a string. */
+NSString *
+x_get_text_property (Window xwindow_id, Atom atom)
+{
+    x_property_entry *entry;
+    XTextProperty prop;
+    NSString *ret = nil;
+
+    entry = get_property_entry (xwindow_id, atom);
+    if (entry == NULL)
+        return nil;
+
+    if (entry->type != None && entry->nitems > 0)
+    {
+        char **list;
+        int err, count;
+
+        prop.value = entry->data;
+        prop.encoding = entry->type;
+        prop.format = entry->format;
+        prop.nitems = entry->nitems;
+
+        err = Xutf8TextPropertyToTextList (x_dpy, &prop, &list, &count);
+
+        if (err >= Success)
         {
-            if (data != NULL)
-                XFree (data);
-
-            if (XGetWindowProperty (x_dpy, xwindow_id, atom, 0, long_length, False,
-                                    AnyPropertyType, &type, &format,
-                                    &nitems, &bytes_after, &data) != Success)
-                return nil;
-            if (type == None)
-                return nil;
-            if (bytes_after == 0)
-                break;
-            long_length += (bytes_after / sizeof(unsigned long)) + 1;
+            if (count > 0)
+            {
+                ret = [NSString stringWithUTF8String: list[0]];
+                XFreeStringList (list);
+            }
         }
-    } while (0);
+        else if (entry->format == 8)
+            ret = [NSString stringWithUTF8String:(char *) entry->data];
+    }
+
+    release_property_entry (entry);
 
-    if (format == 8) {
-        if (type == atoms.utf8_string)
-            ret = [NSString stringWithUTF8String:(char *) data];
+    return ret;
+}
+
+/* Like XGetWMHints() */
+XWMHints *
+x_get_wm_hints (Window xwindow_id)
+{
+    x_property_entry *entry;
+    XWMHints *hints = NULL;
+    long *prop;
+
+    entry = get_property_entry (xwindow_id, atoms.wm_hints);
+    if (entry == NULL)
+        return NULL;
+
+    /* The window_group field was added later; accept it missing. */
+    if (entry->type == XA_WM_HINTS && entry->format == 32
+        && entry->nitems >= 8 && (hints = XAllocWMHints ()) != NULL)
+    {
+        prop = (long *) entry->data;
+
+        hints->flags = prop[0];
+        hints->input = prop[1] ? True : False;
+        hints->initial_state = (int) prop[2];
+        hints->icon_pixmap = prop[3];
+        hints->icon_window = prop[4];
+        hints->icon_x = (int) prop[5];
+        hints->icon_y = (int) prop[6];
+        hints->icon_mask = prop[7];
+        hints->window_group = entry->nitems >= 9 ? prop[8] : 0;
+    }
+
+    release_property_entry (entry);
+
+    return hints;
+}
+
+/* Like XGetWMNormalHints(). HINTS is untouched on failure. */
+Status
+x_get_wm_normal_hints (Window xwindow_id, XSizeHints *hints, long *supplied)
+{
+    x_property_entry *entry;
+    long *prop;
+    Status ret = 0;
+
+    entry = get_property_entry (xwindow_id, atoms.wm_normal_hints);
+    if (entry == NULL)
+        return 0;
+
+    /* Pre-ICCCM clients set 15 elements, without base size and gravity */
+    if (entry->type == XA_WM_SIZE_HINTS && entry->format == 32
+        && entry->nitems >= 15)
+    {
+        prop = (long *) entry->data;
+
+        hints->flags = prop[0];
+        hints->x = (int) prop[1];
+        hints->y = (int) prop[2];
+        hints->width = (int) prop[3];
+        hints->height = (int) prop[4];
+        hints->min_width = (int) prop[5];
+        hints->min_height = (int) prop[6];
+        hints->max_width = (int) prop[7];
+        hints->max_height = (int) prop[8];
+        hints->width_inc = (int) prop[9];
+        hints->height_inc = (int) prop[10];
+        hints->min_aspect.x = (int) prop[11];
+        hints->min_aspect.y = (int) prop[12];
+        hints->max_aspect.x = (int) prop[13];
+        hints->max_aspect.y = (int) prop[14];
+
+        *supplied = USPosition | USSize | PAllHints;
+
+        if (entry->nitems >= 18)
+        {
+            *supplied |= PBaseSize | PWinGravity;
+            hints->base_width = (int) prop[15];
+            hints->base_height = (int) prop[16];
+            hints->win_gravity = (int) prop[17];
+        }
+
+        hints->flags &= *supplied;
+        ret = 1;
+    }
+
+    release_property_entry (entry);
+
+    return ret;
+}
+
+/* Fetches a list of XIDs or atoms (e.g. WM_PROTOCOLS, WM_COLORMAP_WINDOWS),
+   like XGetWMProtocols(). The list is freed with XFree(). */
+Status
+x_get_id_list_property (Window xwindow_id, Atom atom, Atom type,
+                        XID **list_ret, int *count_ret)
+{
+    x_property_entry *entry;
+    XID *list;
+    unsigned long i;
+    Status ret = 0;
+
+    entry = get_property_entry (xwindow_id, atom);
+    if (entry == NULL)
+        return 0;
+
+    if (entry->type == type && entry->format == 32 && entry->nitems > 0
+        && (list = malloc (entry->nitems * sizeof (XID))) != NULL)
+    {
+        for (i = 0; i < entry->nitems; i++)
+            list[i] = ((long *) entry->data)[i];
+
+        *list_ret = list;
+        *count_ret = (int) entry->nitems;
+        ret = 1;
+    }
+
+    release_property_entry (entry);
+
+    return ret;
+}
+
+Status
+x_get_window_attributes (Window xwindow_id, XWindowAttributes *attr)
+{
+    x_window_store *store;
+
+    store = get_store (xwindow_id, False);
+    if (store != NULL && store->have_attributes)
+    {
+        *attr = store->attributes;
+        store->have_attributes = NO;
+        return 1;
+    }
+
+    x_stats_round_trip ();
+    return XGetWindowAttributes (x_dpy, xwindow_id, attr);
+}
+
+/* Whether the window has a bounding shape, and its extents if so. */
+Bool
+x_get_shape_extents (Window xwindow_id, Bool *bounding_shaped,
+                     unsigned int *width, unsigned int *height)
+{
+    x_window_store *store;
+    int xws, yws, xbs, ybs;
+    unsigned int wbs, hbs;
+    int clip;
+
+    store = get_store (xwindow_id, False);
+    if (store != NULL && store->have_shape)
+    {
+        *bounding_shaped = store->bounding_shaped;
+        *width = store->bounding_width;
+        *height = store->bounding_height;
+        store->have_shape = NO;
+        return True;
+    }
+
+    x_stats_round_trip ();
+    return XShapeQueryExtents (x_dpy, xwindow_id, bounding_shaped, &xws, &yws,
+                               width, height, &clip, &xbs, &ybs, &wbs, &hbs);
+}
+
+static Visual *
+visual_for_id (VisualID id)
+{
+    int i, j, k;
+
+    for (i = 0; i < ScreenCount (x_dpy); i++)
+    {
+        Screen *s = ScreenOfDisplay (x_dpy, i);
+
+        for (j = 0; j < s->ndepths; j++)
+        {
+            Depth *d = &s->depths[j];
+
+            for (k = 0; k < d->nvisuals; k++)
+            {
+                if (d->visuals[k].visualid == id)
+                    return &d->visuals[k];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static Screen *
+screen_for_root (Window root)
+{
+    int i;
+
+    for (i = 0; i < ScreenCount (x_dpy); i++)
+    {
+        if (RootWindow (x_dpy, i) == root)
+            return ScreenOfDisplay (x_dpy, i);
+    }
+
+    return NULL;
+}
+
+typedef struct {
+    xcb_get_window_attributes_cookie_t attributes;
+    xcb_get_geometry_cookie_t geometry;
+    xcb_shape_query_extents_cookie_t shape;
+    xcb_get_property_cookie_t *properties;
+} x_prefetch_cookies;
+
+/* Issue all the requests adopting the windows IDS will need -- their
+   attributes if ATTRIBUTES is set, and their shape extents and the
+   properties in PROPERTY_ATOMS if N_ATOMS is non-zero -- before waiting
+   for any of the replies. This costs a single round trip however many
+   windows there are. Replies that are never consumed must be dropped
+   with x_window_cache_forget(). */
+
+void
+x_prefetch_windows (const Window *ids, unsigned int n, Bool attributes,
+                    const Atom *property_atoms, unsigned int n_atoms)
+{
+    xcb_connection_t *c = XGetXCBConnection (x_dpy);
+    x_prefetch_cookies *cookies;
+    unsigned int i, j;
+
+    if (n == 0)
+        return;
+
+    cookies = calloc (n, sizeof (x_prefetch_cookies));
+    x_stats_round_trip ();
+
+    for (i = 0; i < n; i++)
+    {
+        if (attributes)
+        {
+            cookies[i].attributes = xcb_get_window_attributes (c, ids[i]);
+            cookies[i].geometry = xcb_get_geometry (c, ids[i]);
+        }
+
+        if (n_atoms > 0)
+        {
+            cookies[i].shape = xcb_shape_query_extents (c, ids[i]);
+            cookies[i].properties = malloc (n_atoms * sizeof (xcb_get_property_cookie_t));
+
+            for (j = 0; j < n_atoms; j++)
+            {
+                cookies[i].properties[j] = xcb_get_property (c, False, ids[i],
+                                                             property_atoms[j],
+                                                             XCB_GET_PROPERTY_TYPE_ANY,
+                                                             0, PROPERTY_MAX_LENGTH);
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        x_window_store *store = get_store (ids[i], True);
+        xcb_generic_error_t *err = NULL;
+
+        if (attributes)
+        {
+            xcb_get_window_attributes_reply_t *ar;
+            xcb_get_geometry_reply_t *gr;
+
+            ar = xcb_get_window_attributes_reply (c, cookies[i].attributes, &err);
+            free (err);
+            err = NULL;
+            gr = xcb_get_geometry_reply (c, cookies[i].geometry, &err);
+            free (err);
+            err = NULL;
+
+            if (ar != NULL && gr != NULL)
+            {
+                XWindowAttributes *attr = &store->attributes;
+
+                attr->x = gr->x;
+                attr->y = gr->y;
+                attr->width = gr->width;
+                attr->height = gr->height;
+                attr->border_width = gr->border_width;
+                attr->depth = gr->depth;
+                attr->root = gr->root;
+                attr->screen = screen_for_root (gr->root);
+                attr->visual = visual_for_id (ar->visual);
+                attr->class = ar->_class;
+                attr->bit_gravity = ar->bit_gravity;
+                attr->win_gravity = ar->win_gravity;
+                attr->backing_store = ar->backing_store;
+                attr->backing_planes = ar->backing_planes;
+                attr->backing_pixel = ar->backing_pixel;
+                attr->save_under = ar->save_under;
+                attr->colormap = ar->colormap;
+                attr->map_installed = ar->map_is_installed;
+                attr->map_state = ar->map_state;
+                attr->all_event_masks = ar->all_event_masks;
+                attr->your_event_mask = ar->your_event_mask;
+                attr->do_not_propagate_mask = ar->do_not_propagate_mask;
+                attr->override_redirect = ar->override_redirect;
+
+                store->have_attributes = YES;
+            }
+
+            free (ar);
+            free (gr);
+        }
+
+        if (n_atoms > 0)
+        {
+            xcb_shape_query_extents_reply_t *sr;
+
+            sr = xcb_shape_query_extents_reply (c, cookies[i].shape, &err);
+            free (err);
+            err = NULL;
+
+            if (sr != NULL)
+            {
+                store->bounding_shaped = sr->bounding_shaped ? True : False;
+                store->bounding_width = sr->bounding_shape_extents_width;
+                store->bounding_height = sr->bounding_shape_extents_height;
+                store->have_shape = YES;
+                free (sr);
+            }
+
+            for (j = 0; j < n_atoms; j++)
+            {
+                xcb_get_property_reply_t *pr;
+                x_property_entry *entry;
+
+                pr = xcb_get_property_reply (c, cookies[i].properties[j], &err);
+                free (err);
+                err = NULL;
+
+                if (pr == NULL)
+                    continue;
+
+                remove_property_entry (store, property_atoms[j]);
+
+                entry = property_entry_from_data (property_atoms[j], pr->type,
+                                                  pr->format,
+                                                  pr->type != XCB_NONE ? pr->value_len : 0,
+                                                  xcb_get_property_value (pr),
+                                                  False);
+                entry->cached = store->watched;
+                entry->next = store->properties;
+                store->properties = entry;
+
+                free (pr);
+            }
+
+            free (cookies[i].properties);
+        }
+    }
+
+    free (cookies);
+}
+
+static Bool
+long_data_equal (Atom type_a, const long *a, unsigned long n_a,
+                 Atom type_b, const long *b, unsigned long n_b)
+{
+    return (type_a == type_b && n_a == n_b
+            && (n_a == 0 || memcmp (a, b, n_a * sizeof (long)) == 0));
+}
+
+/* Sets a format 32 property of a window we manage, as seen by the rest
+   of the window manager straight away. The server is only told by the
+   next x_flush_properties(), and only if the value really changed. */
+
+void
+x_set_property_deferred (Window xwindow_id, Atom atom, Atom type,
+                         const long *data, int n)
+{
+    x_window_store *store;
+    x_property_entry *entry;
+
+    store = get_store (xwindow_id, True);
+    entry = find_property_entry (store, atom);
+
+    if (entry != NULL && entry->format == 32
+        && long_data_equal (entry->type, (long *) entry->data, entry->nitems,
+                            type, data, n))
+    {
+        x_property_writes_suppressed++;
+        return;
+    }
+
+    if (entry == NULL)
+    {
+        entry = calloc (1, sizeof (x_property_entry));
+        entry->atom = atom;
+        entry->next = store->properties;
+        store->properties = entry;
+    }
+    else if (entry->dirty)
+    {
+        /* Replaces a write we hadn't made yet */
+        x_property_writes_suppressed++;
+        free (entry->data);
+    }
+    else
+    {
+        /* The entry holds what the server has; keep it to compare with */
+        if (entry->format == 32)
+        {
+            entry->published_type = entry->type;
+            entry->n_published = entry->nitems;
+            entry->published = (long *) entry->data;
+            entry->have_published = YES;
+        }
         else
-            ret = [NSString stringWithCString:(char *) data encoding:NSASCIIStringEncoding];
+            free (entry->data);
+    }
+
+    entry->type = type;
+    entry->format = 32;
+    entry->nitems = n;
+    entry->data = malloc ((n + 1) * sizeof (long));
+    memcpy (entry->data, data, n * sizeof (long));
+    entry->cached = entry->owned = YES;
+
+    if (!entry->dirty)
+    {
+        entry->dirty = YES;
+
+        if (!store->dirty)
+        {
+            if (n_dirty_windows == dirty_windows_size)
+            {
+                dirty_windows_size = MAX (16, dirty_windows_size * 2);
+                dirty_windows = realloc (dirty_windows, dirty_windows_size * sizeof (Window));
+            }
+
+            dirty_windows[n_dirty_windows++] = xwindow_id;
+            store->dirty = YES;
+        }
+    }
+}
+
+static Bool
+flush_store (Window xwindow_id, x_window_store *store)
+{
+    x_property_entry *entry;
+    Bool ret = False;
+
+    for (entry = store->properties; entry != NULL; entry = entry->next)
+    {
+        if (!entry->dirty)
+            continue;
+
+        if (entry->have_published
+            && long_data_equal (entry->type, (long *) entry->data,
+                                entry->nitems, entry->published_type,
+                                entry->published, entry->n_published))
+        {
+            x_property_writes_suppressed++;
+        }
+        else
+        {
+            XChangeProperty (x_dpy, xwindow_id, entry->atom, entry->type,
+                             32, PropModeReplace, entry->data,
+                             (int) entry->nitems);
+            x_property_writes++;
+            ret = True;
+        }
+
+        free (entry->published);
+        entry->published = NULL;
+        entry->have_published = NO;
+        entry->dirty = NO;
+    }
+
+    store->dirty = NO;
+
+    return ret;
+}
+
+/* Writes out everything set by x_set_property_deferred() since the last
+   call. Returns True if any requests were made. */
+
+Bool
+x_flush_properties (void)
+{
+    x_window_store *store;
+    unsigned int i;
+    Bool ret = False;
+
+    for (i = 0; i < n_dirty_windows; i++)
+    {
+        /* Already written if the window was forgotten in the meantime */
+        store = get_store (dirty_windows[i], False);
+        if (store == NULL || !store->dirty)
+            continue;
+
+        if (flush_store (dirty_windows[i], store))
+            ret = True;
+
+        /* Set after the window was removed; nothing else will free it */
+        if (!store->watched)
+            x_window_cache_forget (dirty_windows[i]);
     }
 
-    XFree (data);
+    n_dirty_windows = 0;
 
     return ret;
 }
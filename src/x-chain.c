@@ -0,0 +1,131 @@
+/* x-chain.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-chain.h"
+#include <stddef.h>
+#include <assert.h>
+
+X_EXTERN void
+X_PFX (chain_init) (x_chain *c)
+{
+    c->head = c->tail = NULL;
+    c->length = 0;
+}
+
+X_EXTERN void
+X_PFX (chain_node_init) (x_chain_node *node, void *data)
+{
+    node->next = node->prev = NULL;
+    node->data = data;
+    node->linked = 0;
+}
+
+X_EXTERN void
+X_PFX (chain_append) (x_chain *c, x_chain_node *node)
+{
+    assert (!node->linked);
+
+    node->next = NULL;
+    node->prev = c->tail;
+
+    if (c->tail != NULL)
+        c->tail->next = node;
+    else
+        c->head = node;
+
+    c->tail = node;
+    node->linked = 1;
+    c->length++;
+}
+
+X_EXTERN void
+X_PFX (chain_prepend) (x_chain *c, x_chain_node *node)
+{
+    assert (!node->linked);
+
+    node->prev = NULL;
+    node->next = c->head;
+
+    if (c->head != NULL)
+        c->head->prev = node;
+    else
+        c->tail = node;
+
+    c->head = node;
+    node->linked = 1;
+    c->length++;
+}
+
+X_EXTERN void
+X_PFX (chain_remove) (x_chain *c, x_chain_node *node)
+{
+    if (!node->linked)
+        return;
+
+    if (node->prev != NULL)
+        node->prev->next = node->next;
+    else
+        c->head = node->next;
+
+    if (node->next != NULL)
+        node->next->prev = node->prev;
+    else
+        c->tail = node->prev;
+
+    node->next = node->prev = NULL;
+    node->linked = 0;
+    c->length--;
+}
+
+X_EXTERN void
+X_PFX (chain_clear) (x_chain *c)
+{
+    x_chain_node *node, *next;
+
+    for (node = c->head; node != NULL; node = next)
+    {
+        next = node->next;
+        node->next = node->prev = NULL;
+        node->linked = 0;
+    }
+
+    X_PFX (chain_init) (c);
+}
+
+X_EXTERN x_chain_node *
+X_PFX (chain_cycle) (x_chain *c, x_chain_node *node, int reversed)
+{
+    if (node == NULL || !node->linked)
+        return NULL;
+
+    if (reversed)
+        return node->prev != NULL ? node->prev : c->tail;
+    else
+        return node->next != NULL ? node->next : c->head;
+}
@@ -0,0 +1,74 @@
+/* x-chain.h -- lists of objects that know their place in them
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef X_CHAIN_H
+#define X_CHAIN_H 1
+
+/* A doubly-linked list whose nodes are embedded in the objects on it,
+   like x_stack's, so adding and removing never allocates and removing
+   is O(1). It knows its length and its tail. An object can only be on
+   a chain once per node it embeds. */
+
+typedef struct x_chain_node_struct x_chain_node;
+
+struct x_chain_node_struct {
+    x_chain_node *next, *prev;
+    void *data;
+    unsigned linked :1;
+};
+
+typedef struct x_chain_struct x_chain;
+
+struct x_chain_struct {
+    x_chain_node *head, *tail;
+    unsigned int length;
+};
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+X_EXTERN void X_PFX (chain_init) (x_chain *c);
+X_EXTERN void X_PFX (chain_node_init) (x_chain_node *node, void *data);
+
+X_EXTERN void X_PFX (chain_append) (x_chain *c, x_chain_node *node);
+X_EXTERN void X_PFX (chain_prepend) (x_chain *c, x_chain_node *node);
+
+/* Does nothing if NODE isn't on a chain. */
+X_EXTERN void X_PFX (chain_remove) (x_chain *c, x_chain_node *node);
+
+/* Empties C, leaving each of its nodes unlinked. */
+X_EXTERN void X_PFX (chain_clear) (x_chain *c);
+
+/* The node after (or before, if REVERSED) NODE, wrapping around at
+   the ends. */
+X_EXTERN x_chain_node *X_PFX (chain_cycle) (x_chain *c, x_chain_node *node,
+                                            int reversed);
+
+#endif /* X_CHAIN_H */
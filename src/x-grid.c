@@ -0,0 +1,360 @@
+/* x-grid.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-grid.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#define CELL X_GRID_CELL_SIZE
+
+typedef struct {
+    unsigned long coverage;		/* total area of items over us */
+    unsigned int n_items, size;
+    x_grid_item **items;		/* those with their origin here */
+} grid_cell;
+
+static inline int
+cell_of (int v)
+{
+    return v >= 0 ? v / CELL : -((CELL - 1 - v) / CELL);
+}
+
+/* Cell coordinates are kept to 16 bits each, which at 64 pixels a cell
+   is far more than any screen. */
+static inline unsigned long
+cell_key (int cx, int cy)
+{
+    return ((unsigned long) (cx & 0xffff) << 16) | (cy & 0xffff);
+}
+
+static grid_cell *
+get_cell (x_grid *g, int cx, int cy, int create)
+{
+    grid_cell *c;
+
+    c = X_PFX (hash_table_lookup) (g->cells, cell_key (cx, cy), NULL);
+    if (c == NULL && create)
+    {
+        c = calloc (1, sizeof (grid_cell));
+        assert (c != NULL);
+        X_PFX (hash_table_insert) (g->cells, cell_key (cx, cy), c, 0);
+    }
+
+    return c;
+}
+
+static void
+maybe_free_cell (x_grid *g, int cx, int cy, grid_cell *c)
+{
+    if (c->coverage == 0 && c->n_items == 0)
+    {
+        X_PFX (hash_table_remove) (g->cells, cell_key (cx, cy));
+        free (c->items);
+        free (c);
+    }
+}
+
+/* Adds (SIGN > 0) or removes the area of R from the cells it covers */
+static void
+cover (x_grid *g, X11Rect r, int sign)
+{
+    int cx, cy, cx0, cy0, cx1, cy1;
+    int x0, y0, x1, y1;
+    int left = r.x, top = r.y;
+    int right = r.x + (int) r.width, bottom = r.y + (int) r.height;
+    unsigned long area;
+    grid_cell *c;
+
+    if (r.width == 0 || r.height == 0)
+        return;
+
+    cx0 = cell_of (left);
+    cy0 = cell_of (top);
+    cx1 = cell_of (right - 1);
+    cy1 = cell_of (bottom - 1);
+
+    for (cy = cy0; cy <= cy1; cy++)
+    {
+        y0 = cy * CELL > top ? cy * CELL : top;
+        y1 = (cy + 1) * CELL < bottom ? (cy + 1) * CELL : bottom;
+
+        for (cx = cx0; cx <= cx1; cx++)
+        {
+            x0 = cx * CELL > left ? cx * CELL : left;
+            x1 = (cx + 1) * CELL < right ? (cx + 1) * CELL : right;
+            area = (unsigned long) (x1 - x0) * (y1 - y0);
+
+            c = get_cell (g, cx, cy, sign > 0);
+            if (sign > 0)
+                c->coverage += area;
+            else if (c != NULL)
+            {
+                assert (c->coverage >= area);
+                c->coverage -= area;
+                maybe_free_cell (g, cx, cy, c);
+            }
+        }
+    }
+}
+
+static void
+add_to_origin_cell (x_grid *g, x_grid_item *item)
+{
+    grid_cell *c;
+
+    c = get_cell (g, cell_of (item->rect.x), cell_of (item->rect.y), 1);
+
+    if (c->n_items == c->size)
+    {
+        c->size = c->size ? c->size * 2 : 4;
+        c->items = realloc (c->items, c->size * sizeof (x_grid_item *));
+        assert (c->items != NULL);
+    }
+
+    c->items[c->n_items++] = item;
+}
+
+static void
+remove_from_origin_cell (x_grid *g, x_grid_item *item)
+{
+    int cx = cell_of (item->rect.x), cy = cell_of (item->rect.y);
+    grid_cell *c;
+    unsigned int i;
+
+    c = get_cell (g, cx, cy, 0);
+    assert (c != NULL);
+
+    for (i = 0; i < c->n_items; i++)
+    {
+        if (c->items[i] == item)
+        {
+            c->items[i] = c->items[--c->n_items];
+            break;
+        }
+    }
+
+    maybe_free_cell (g, cx, cy, c);
+}
+
+void
+X_PFX (grid_init) (x_grid *g)
+{
+    g->cells = X_PFX (hash_table_new) ();
+    g->length = 0;
+}
+
+static void
+free_cell (unsigned long key, void *data, int tag, void *closure)
+{
+    grid_cell *c = data;
+
+    free (c->items);
+    free (c);
+}
+
+void
+X_PFX (grid_free) (x_grid *g)
+{
+    X_PFX (hash_table_foreach) (g->cells, free_cell, NULL);
+    X_PFX (hash_table_free) (g->cells);
+    g->cells = NULL;
+    g->length = 0;
+}
+
+void
+X_PFX (grid_item_init) (x_grid_item *item, void *data)
+{
+    item->data = data;
+    item->rect = X11RectMake (0, 0, 0, 0);
+    item->indexed = 0;
+    item->covering = 1;
+}
+
+void
+X_PFX (grid_insert) (x_grid *g, x_grid_item *item, X11Rect r)
+{
+    assert (!item->indexed);
+
+    item->rect = r;
+    item->indexed = 1;
+
+    add_to_origin_cell (g, item);
+    if (item->covering)
+        cover (g, r, 1);
+    g->length++;
+}
+
+void
+X_PFX (grid_remove) (x_grid *g, x_grid_item *item)
+{
+    if (!item->indexed)
+        return;
+
+    if (item->covering)
+        cover (g, item->rect, -1);
+    remove_from_origin_cell (g, item);
+
+    item->indexed = 0;
+    g->length--;
+}
+
+void
+X_PFX (grid_move) (x_grid *g, x_grid_item *item, X11Rect r)
+{
+    if (!item->indexed || X11RectEqualToRect (item->rect, r))
+        return;
+
+    X_PFX (grid_remove) (g, item);
+    X_PFX (grid_insert) (g, item, r);
+}
+
+void
+X_PFX (grid_set_covering) (x_grid *g, x_grid_item *item, int covering)
+{
+    covering = covering != 0;
+
+    if (item->covering == (unsigned) covering)
+        return;
+
+    item->covering = covering;
+
+    if (item->indexed)
+        cover (g, item->rect, covering ? 1 : -1);
+}
+
+void *
+X_PFX (grid_find_origin) (x_grid *g, X11Point p, int slop)
+{
+    int cx, cy, dx, dy;
+    unsigned int i;
+    grid_cell *c;
+    x_grid_item *item;
+
+    for (cy = cell_of (p.y - slop); cy <= cell_of (p.y + slop); cy++)
+    {
+        for (cx = cell_of (p.x - slop); cx <= cell_of (p.x + slop); cx++)
+        {
+            c = get_cell (g, cx, cy, 0);
+            if (c == NULL)
+                continue;
+
+            for (i = 0; i < c->n_items; i++)
+            {
+                item = c->items[i];
+                dx = p.x - item->rect.x;
+                dy = p.y - item->rect.y;
+
+                if (dx * dx + dy * dy <= slop * slop)
+                    return item->data;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+X11Point
+X_PFX (grid_least_covered) (x_grid *g, X11Rect area, int width, int height,
+                            unsigned long *overlap_ret)
+{
+    int cx0, cy0, ncx, ncy, wc, hc, i, j, stride;
+    int right = area.x + (int) area.width, bottom = area.y + (int) area.height;
+    unsigned long *sums, sum, best_sum = 0;
+    X11Point best;
+    grid_cell *c;
+
+    best = X11RectOrigin (area);
+
+    if (area.width == 0 || area.height == 0)
+    {
+        if (overlap_ret != NULL)
+            *overlap_ret = 0;
+        return best;
+    }
+
+    cx0 = cell_of (area.x);
+    cy0 = cell_of (area.y);
+    ncx = cell_of (right - 1) - cx0 + 1;
+    ncy = cell_of (bottom - 1) - cy0 + 1;
+
+    wc = (width + CELL - 1) / CELL;
+    hc = (height + CELL - 1) / CELL;
+    wc = wc < 1 ? 1 : wc > ncx ? ncx : wc;
+    hc = hc < 1 ? 1 : hc > ncy ? ncy : hc;
+
+    /* Summed coverage of the cells above and to the left of each */
+    stride = ncx + 1;
+    sums = calloc ((size_t) stride * (ncy + 1), sizeof (unsigned long));
+    assert (sums != NULL);
+
+    for (j = 0; j < ncy; j++)
+    {
+        for (i = 0; i < ncx; i++)
+        {
+            c = get_cell (g, cx0 + i, cy0 + j, 0);
+            sums[(j + 1) * stride + i + 1] = ((c != NULL ? c->coverage : 0)
+                                              + sums[j * stride + i + 1]
+                                              + sums[(j + 1) * stride + i]
+                                              - sums[j * stride + i]);
+        }
+    }
+
+    for (j = 0; j + hc <= ncy; j++)
+    {
+        for (i = 0; i + wc <= ncx; i++)
+        {
+            sum = (sums[(j + hc) * stride + i + wc] - sums[j * stride + i + wc]
+                   - sums[(j + hc) * stride + i] + sums[j * stride + i]);
+
+            if ((i == 0 && j == 0) || sum < best_sum)
+            {
+                best_sum = sum;
+                best.x = (cx0 + i) * CELL;
+                best.y = (cy0 + j) * CELL;
+            }
+        }
+    }
+
+    free (sums);
+
+    /* Cell boundaries don't line up with the area, keep inside it */
+    if (best.x + width > right)
+        best.x = right - width;
+    if (best.y + height > bottom)
+        best.y = bottom - height;
+    if (best.x < area.x)
+        best.x = area.x;
+    if (best.y < area.y)
+        best.y = area.y;
+
+    if (overlap_ret != NULL)
+        *overlap_ret = best_sum;
+
+    return best;
+}
@@ -0,0 +1,93 @@
+/* x-grid.h -- spatial index of window frames
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef X_GRID_H
+#define X_GRID_H 1
+
+#include "x11-geometry.h"
+#include "x-hash.h"
+
+/* Window frames bucketed into square cells. Each item is listed in the
+   cell holding its origin, for finding windows near a point, and each
+   cell keeps the total area of the frames covering it, so that how
+   much a rect is overlapped can be estimated from the cells alone.
+   Both stay cheap however many windows there are. Items are embedded
+   in the objects they index. Cells are only allocated where there's
+   something in them. */
+
+#define X_GRID_CELL_SIZE 64
+
+typedef struct x_grid_item_struct x_grid_item;
+
+struct x_grid_item_struct {
+    void *data;
+    X11Rect rect;
+    unsigned indexed :1;
+    unsigned covering :1;		/* counted in the cells' coverage */
+};
+
+typedef struct x_grid_struct x_grid;
+
+struct x_grid_struct {
+    x_hash_table *cells;
+    unsigned int length;
+};
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+X_EXTERN void X_PFX (grid_init) (x_grid *g);
+X_EXTERN void X_PFX (grid_free) (x_grid *g);
+X_EXTERN void X_PFX (grid_item_init) (x_grid_item *item, void *data);
+
+X_EXTERN void X_PFX (grid_insert) (x_grid *g, x_grid_item *item, X11Rect r);
+X_EXTERN void X_PFX (grid_remove) (x_grid *g, x_grid_item *item);
+
+/* Does nothing if ITEM isn't in the grid. */
+X_EXTERN void X_PFX (grid_move) (x_grid *g, x_grid_item *item, X11Rect r);
+
+/* Whether ITEM counts towards the coverage, e.g. not while its window
+   is hidden; it can still be found by its origin. Items start out
+   covering. */
+X_EXTERN void X_PFX (grid_set_covering) (x_grid *g, x_grid_item *item,
+                                         int covering);
+
+/* Returns the data of an item whose origin is within SLOP of P, or
+   NULL if there isn't one. */
+X_EXTERN void *X_PFX (grid_find_origin) (x_grid *g, X11Point p, int slop);
+
+/* Returns where in AREA a WIDTH by HEIGHT rect is least covered by
+   items, trying positions on cell boundaries, topmost then leftmost
+   first. The covered area (as estimated from the cells) is stored in
+   OVERLAP_RET if that is non-null. */
+X_EXTERN X11Point X_PFX (grid_least_covered) (x_grid *g, X11Rect area,
+                                              int width, int height,
+                                              unsigned long *overlap_ret);
+
+#endif /* X_GRID_H */
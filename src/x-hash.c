@@ -0,0 +1,219 @@
+/* x-hash.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-hash.h"
+#include <stdlib.h>
+#include <assert.h>
+
+/* Must be a power of two. */
+#define INITIAL_BUCKETS 32
+
+typedef struct x_hash_entry_struct x_hash_entry;
+
+struct x_hash_entry_struct {
+    unsigned long key;
+    void *data;                 /* NULL means the slot is empty */
+    int tag;
+};
+
+struct x_hash_table_struct {
+    unsigned int n_buckets;
+    unsigned int n_entries;
+    x_hash_entry *buckets;
+};
+
+static inline unsigned int
+hash_index (x_hash_table *h, unsigned long key)
+{
+    /* XIDs from one client differ only in their low bits, so mix them
+       up before masking. */
+
+    key ^= key >> 16;
+    key *= 0x45d9f3bUL;
+    key ^= key >> 16;
+
+    return (unsigned int) key & (h->n_buckets - 1);
+}
+
+static void
+hash_table_resize (x_hash_table *h, unsigned int n_buckets)
+{
+    x_hash_entry *old = h->buckets;
+    unsigned int old_n = h->n_buckets, i, j;
+
+    h->buckets = calloc (n_buckets, sizeof (x_hash_entry));
+    assert (h->buckets != NULL);
+    h->n_buckets = n_buckets;
+
+    for (i = 0; i < old_n; i++)
+    {
+        if (old[i].data == NULL)
+            continue;
+
+        j = hash_index (h, old[i].key);
+        while (h->buckets[j].data != NULL)
+            j = (j + 1) & (n_buckets - 1);
+
+        h->buckets[j] = old[i];
+    }
+
+    free (old);
+}
+
+X_EXTERN x_hash_table *
+X_PFX (hash_table_new) (void)
+{
+    x_hash_table *h;
+
+    h = calloc (1, sizeof (x_hash_table));
+    assert (h != NULL);
+
+    h->n_buckets = INITIAL_BUCKETS;
+    h->buckets = calloc (INITIAL_BUCKETS, sizeof (x_hash_entry));
+    assert (h->buckets != NULL);
+
+    return h;
+}
+
+X_EXTERN void
+X_PFX (hash_table_free) (x_hash_table *h)
+{
+    if (h == NULL)
+        return;
+
+    free (h->buckets);
+    free (h);
+}
+
+X_EXTERN unsigned int
+X_PFX (hash_table_size) (x_hash_table *h)
+{
+    return h->n_entries;
+}
+
+X_EXTERN void
+X_PFX (hash_table_insert) (x_hash_table *h, unsigned long key,
+                           void *data, int tag)
+{
+    unsigned int i;
+
+    assert (data != NULL);
+
+    /* Keep the load factor under one half. */
+    if ((h->n_entries + 1) * 2 > h->n_buckets)
+        hash_table_resize (h, h->n_buckets * 2);
+
+    i = hash_index (h, key);
+    while (h->buckets[i].data != NULL && h->buckets[i].key != key)
+        i = (i + 1) & (h->n_buckets - 1);
+
+    if (h->buckets[i].data == NULL)
+        h->n_entries++;
+
+    h->buckets[i].key = key;
+    h->buckets[i].data = data;
+    h->buckets[i].tag = tag;
+}
+
+X_EXTERN void
+X_PFX (hash_table_remove) (x_hash_table *h, unsigned long key)
+{
+    unsigned int mask = h->n_buckets - 1, i, j, k;
+
+    i = hash_index (h, key);
+    while (h->buckets[i].data != NULL && h->buckets[i].key != key)
+        i = (i + 1) & mask;
+
+    if (h->buckets[i].data == NULL)
+        return;
+
+    /* Shift following entries of the probe sequence back, so that we
+       never need tombstones. */
+
+    for (j = i;;)
+    {
+        h->buckets[i].data = NULL;
+
+        for (;;)
+        {
+            j = (j + 1) & mask;
+            if (h->buckets[j].data == NULL)
+                goto done;
+
+            k = hash_index (h, h->buckets[j].key);
+
+            /* Can the entry at J be moved into the hole at I? Only if
+               its home slot K doesn't lie cyclically in (I, J]. */
+            if (i <= j ? (i >= k || k > j) : (i >= k && k > j))
+                break;
+        }
+
+        h->buckets[i] = h->buckets[j];
+        i = j;
+    }
+
+done:
+    h->n_entries--;
+}
+
+X_EXTERN void *
+X_PFX (hash_table_lookup) (x_hash_table *h, unsigned long key, int *tag_ret)
+{
+    unsigned int i;
+
+    i = hash_index (h, key);
+    while (h->buckets[i].data != NULL)
+    {
+        if (h->buckets[i].key == key)
+        {
+            if (tag_ret != NULL)
+                *tag_ret = h->buckets[i].tag;
+            return h->buckets[i].data;
+        }
+
+        i = (i + 1) & (h->n_buckets - 1);
+    }
+
+    return NULL;
+}
+
+X_EXTERN void
+X_PFX (hash_table_foreach) (x_hash_table *h,
+                            void (*fun) (unsigned long key, void *data,
+                                         int tag, void *user_data),
+                            void *user_data)
+{
+    unsigned int i;
+
+    for (i = 0; i < h->n_buckets; i++)
+    {
+        if (h->buckets[i].data != NULL)
+            (*fun) (h->buckets[i].key, h->buckets[i].data,
+                    h->buckets[i].tag, user_data);
+    }
+}
@@ -0,0 +1,62 @@
+/* x-hash.h -- simple integer-keyed hash table
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef X_HASH_H
+#define X_HASH_H 1
+
+/* Maps unsigned long keys (XIDs, atoms, ...) to non-NULL pointers, with
+   a small integer tag stored alongside each entry. Open addressing, so
+   lookups never allocate. */
+
+typedef struct x_hash_table_struct x_hash_table;
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+X_EXTERN x_hash_table *X_PFX (hash_table_new) (void);
+X_EXTERN void X_PFX (hash_table_free) (x_hash_table *h);
+
+X_EXTERN unsigned int X_PFX (hash_table_size) (x_hash_table *h);
+
+/* Replaces any existing entry for KEY. DATA must not be NULL. */
+X_EXTERN void X_PFX (hash_table_insert) (x_hash_table *h, unsigned long key,
+                                         void *data, int tag);
+X_EXTERN void X_PFX (hash_table_remove) (x_hash_table *h, unsigned long key);
+
+/* Returns NULL if KEY isn't present. TAG_RET may be NULL. */
+X_EXTERN void *X_PFX (hash_table_lookup) (x_hash_table *h, unsigned long key,
+                                          int *tag_ret);
+
+X_EXTERN void X_PFX (hash_table_foreach) (x_hash_table *h,
+                                          void (*fun) (unsigned long key,
+                                                       void *data, int tag,
+                                                       void *user_data),
+                                          void *user_data);
+
+#endif /* X_HASH_H */
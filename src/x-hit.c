@@ -0,0 +1,197 @@
+/* x-hit.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-hit.h"
+
+static void
+edge_spec (int e1, int size1, int e2, short *offset, int *from_far)
+{
+    if (e1 == e2)
+    {
+        *offset = e1;
+        *from_far = 0;
+    }
+    else
+    {
+        *offset = size1 - e1;
+        *from_far = 1;
+    }
+}
+
+X_EXTERN void
+X_PFX (hit_spec_derive) (x_hit_spec *spec, X11Rect r1,
+                         int width_1, int height_1, X11Rect r2)
+{
+    int far;
+
+    edge_spec (r1.x, width_1, r2.x, &spec->left, &far);
+    spec->left_from_right = far;
+    edge_spec (r1.y, height_1, r2.y, &spec->top, &far);
+    spec->top_from_bottom = far;
+    edge_spec (r1.x + r1.width, width_1, r2.x + r2.width,
+               &spec->right, &far);
+    spec->right_from_right = far;
+    edge_spec (r1.y + r1.height, height_1, r2.y + r2.height,
+               &spec->bottom, &far);
+    spec->bottom_from_bottom = far;
+}
+
+X_EXTERN X11Rect
+X_PFX (hit_spec_apply) (const x_hit_spec *spec, X11Rect outer_r)
+{
+    int x0, y0, x1, y1;
+    int width = outer_r.width, height = outer_r.height;
+
+    x0 = spec->left_from_right ? width - spec->left : spec->left;
+    y0 = spec->top_from_bottom ? height - spec->top : spec->top;
+    x1 = spec->right_from_right ? width - spec->right : spec->right;
+    y1 = spec->bottom_from_bottom ? height - spec->bottom : spec->bottom;
+
+    return X11RectMake (outer_r.x + x0, outer_r.y + y0,
+                        x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
+static int
+rect_contains (X11Rect r, int x, int y)
+{
+    return (x >= r.x && x < r.x + (int) r.width
+            && y >= r.y && y < r.y + (int) r.height);
+}
+
+X_EXTERN int
+X_PFX (hit_map_scan) (x_hit_map *map, int width, int height,
+                      x_hit_probe_proc probe, void *data)
+{
+    X11Rect outer_r, inner_r, tr, gr;
+    int x, y, x0, mid_y, n_probes = 0;
+    unsigned int attr, run_attr;
+
+#define PROBE(px, py) \
+    (n_probes++, probe (outer_r, inner_r, X11PointMake ((px), (py)), data))
+
+    outer_r = X11RectMake (0, 0, width, height);
+    inner_r = X11RectMake (0, map->titlebar_height,
+                           width, height - map->titlebar_height);
+
+    tr = X_PFX (hit_spec_apply) (&map->tracking, outer_r);
+    gr = X_PFX (hit_spec_apply) (&map->growbox, outer_r);
+
+    /* Somewhere in the titlebar away from the buttons, and the middle
+       of the frame */
+    map->title_attr = PROBE (tr.x + (int) tr.width
+                             + (width - tr.x - (int) tr.width) / 2,
+                             map->titlebar_height / 2);
+    map->body_attr = PROBE (width / 2, (map->titlebar_height + height) / 2);
+
+    map->growbox_attr = map->body_attr;
+    if (gr.width > 0 && gr.height > 0)
+        map->growbox_attr = PROBE (gr.x + gr.width / 2, gr.y + gr.height / 2);
+
+    /* Find the buttons' horizontal extents along the middle of the
+       tracking rect, then each one's vertical extent through its
+       middle. */
+    map->n_buttons = 0;
+    mid_y = tr.y + tr.height / 2;
+    run_attr = map->title_attr;
+    x0 = 0;
+
+    for (x = tr.x; x <= tr.x + (int) tr.width; x++)
+    {
+        attr = x < tr.x + (int) tr.width ? PROBE (x, mid_y) : map->title_attr;
+
+        if (attr == run_attr)
+            continue;
+
+        if (run_attr != map->title_attr && map->n_buttons < X_HIT_MAX_BUTTONS)
+        {
+            int cx = (x0 + x - 1) / 2, y0 = -1, y1 = -1;
+
+            for (y = 0; y < map->titlebar_height; y++)
+            {
+                if (PROBE (cx, y) == run_attr)
+                {
+                    if (y0 < 0)
+                        y0 = y;
+                    y1 = y;
+                }
+            }
+
+            if (y0 < 0)
+                goto next;
+
+            map->buttons[map->n_buttons].attr = run_attr;
+            map->buttons[map->n_buttons].rect
+                = X11RectMake (x0 - tr.x, y0 - tr.y, x - x0, y1 - y0 + 1);
+            map->n_buttons++;
+        }
+
+    next:
+        run_attr = attr;
+        x0 = x;
+    }
+
+#undef PROBE
+
+    return n_probes;
+}
+
+X_EXTERN unsigned int
+X_PFX (hit_map_test) (const x_hit_map *map, X11Rect outer_r, X11Rect inner_r,
+                      X11Point p)
+{
+    X11Rect tr, gr;
+    int i;
+
+    if (!rect_contains (outer_r, p.x, p.y))
+        return 0;
+
+    if (p.y < inner_r.y)
+    {
+        tr = X_PFX (hit_spec_apply) (&map->tracking, outer_r);
+
+        for (i = 0; i < map->n_buttons; i++)
+        {
+            X11Rect r = map->buttons[i].rect;
+
+            r.x += tr.x;
+            r.y += tr.y;
+
+            if (rect_contains (r, p.x, p.y))
+                return map->buttons[i].attr;
+        }
+
+        return map->title_attr;
+    }
+
+    gr = X_PFX (hit_spec_apply) (&map->growbox, outer_r);
+    if (rect_contains (gr, p.x, p.y))
+        return map->growbox_attr;
+
+    return map->body_attr;
+}
@@ -0,0 +1,101 @@
+/* x-hit.h -- frame hit testing without the server
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef X_HIT_H
+#define X_HIT_H 1
+
+#include "x11-geometry.h"
+
+/* For a given frame class, the parts of a frame are at fixed offsets
+   from one edge or another of the frame's outer rect. An x_hit_spec
+   describes one such rect; an x_hit_map describes all the parts that
+   matter for hit testing, so that once it has been built (at the cost
+   of some server queries) hit tests can be answered locally. */
+
+typedef struct x_hit_spec_struct x_hit_spec;
+
+struct x_hit_spec_struct {
+    short left, top, right, bottom;	/* offset from the edge they follow */
+    unsigned left_from_right :1;
+    unsigned top_from_bottom :1;
+    unsigned right_from_right :1;
+    unsigned bottom_from_bottom :1;
+};
+
+#define X_HIT_MAX_BUTTONS 4
+
+typedef struct x_hit_map_struct x_hit_map;
+
+struct x_hit_map_struct {
+    int titlebar_height;
+    x_hit_spec tracking;		/* where the buttons are */
+    x_hit_spec growbox;
+
+    /* Relative to the origin of the tracking rect */
+    int n_buttons;
+    struct {
+        unsigned int attr;
+        X11Rect rect;
+    } buttons[X_HIT_MAX_BUTTONS];
+
+    /* What the rest of the titlebar, the growbox and the rest of the
+       frame hit */
+    unsigned int title_attr, growbox_attr, body_attr;
+};
+
+/* Answers a hit test at P against a frame with the given outer and
+   inner rects, the way the server would. */
+typedef unsigned int (*x_hit_probe_proc) (X11Rect outer_r, X11Rect inner_r,
+                                          X11Point p, void *data);
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+/* Builds SPEC from the rects R1 and R2 the server gave for the same
+   part of frames WIDTH_1 x HEIGHT_1 and of some other size. */
+X_EXTERN void X_PFX (hit_spec_derive) (x_hit_spec *spec, X11Rect r1,
+                                       int width_1, int height_1, X11Rect r2);
+
+X_EXTERN X11Rect X_PFX (hit_spec_apply) (const x_hit_spec *spec,
+                                         X11Rect outer_r);
+
+/* Fills in the buttons and attrs of MAP, whose titlebar height,
+   tracking and growbox specs must already be set, by probing a
+   WIDTH x HEIGHT frame. Buttons must lie in the titlebar, in a row
+   crossing the middle of the tracking rect. Returns the number of
+   probes made. */
+X_EXTERN int X_PFX (hit_map_scan) (x_hit_map *map, int width, int height,
+                                   x_hit_probe_proc probe, void *data);
+
+X_EXTERN unsigned int X_PFX (hit_map_test) (const x_hit_map *map,
+                                            X11Rect outer_r, X11Rect inner_r,
+                                            X11Point p);
+
+#endif /* X_HIT_H */
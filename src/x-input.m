@@ -31,6 +31,7 @@
 #import "x-window.h"
 #include "frame.h"
 #include "utils.h"
+#include "x-stats.h"
 
 #include <CoreFoundation/CFSocket.h>
 #include <CoreFoundation/CFRunLoop.h>
@@ -39,8 +40,11 @@
 #include <X11/keysym.h>
 #include <X11/extensions/applewm.h>
 #include <X11/extensions/Xrandr.h>
+#include <X11/Xlib-xcb.h>
 
 #include <unistd.h>
+#include <stdlib.h>
+#include <assert.h>
 
 extern BOOL _proxy_pb;
 
@@ -64,9 +68,28 @@
     unsigned resizing :1;
 } pointer_state;
 
+/* Interactive moves and resizes are applied to the frame at most this
+   often. Motion in between only updates the target. */
+#define DRAG_STEP_INTERVAL (1.0 / 60.0)
+
+static struct {
+    X11Point target;			/* latest pointer position */
+    unsigned target_pending :1;		/* target not yet applied */
+    CFRunLoopTimerRef timer;
+    CFAbsoluteTime start_time;
+    CFAbsoluteTime last_step;
+    CFAbsoluteTime max_interval;
+    unsigned int steps;
+} drag_state;
+
 /* Timestamp when the X server last told us it's active */
 static Time last_activation_time;
 
+/* From a press on a frame to the end of the batch it was in, which is
+   when the frame gets redrawn to show what was hit */
+static int press_slot;
+static uint64_t press_start;
+
 static float
 point_distance (X11Point a, X11Point b)
 {
@@ -95,60 +118,199 @@
     return count_bits (state & BUTTON_MASK);
 }
 
-static void *
-list_next (x_list *lst, void *item)
+/* With PointerMotionHintMask the server only sends more motion after a
+   QueryPointer. Ask for one without waiting for the reply. */
+static void
+request_motion_hint (Window xwindow_id)
+{
+    xcb_connection_t *c = XGetXCBConnection (x_dpy);
+
+    xcb_discard_reply (c, xcb_query_pointer (c, xwindow_id).sequence);
+}
+
+static void
+drag_apply (x_window *w)
+{
+    X11Point p = drag_state.target;
+    CFAbsoluteTime now;
+    X11Rect r;
+
+    drag_state.target_pending = NO;
+
+    if (pointer_state.dragging)
+    {
+        r = X11RectMake(p.x + pointer_state.offset.x, p.y + pointer_state.offset.y,
+                        w->_current_frame.width, w->_current_frame.height);
+        r = [w->_screen validate_window_position:r titlebar_height:w->_frame_title_height];
+        [w resize_frame:r];
+    }
+    else if (pointer_state.resizing)
+    {
+        r = X11RectMake(w->_current_frame.x, w->_current_frame.y,
+                        pointer_state.offset.x + (p.x - pointer_state.down_location.x),
+                        pointer_state.offset.y + (p.y - pointer_state.down_location.y));
+        if (r.width > 0 && r.height > 0)
+        {
+            r = [w validate_frame_rect:r from_user:YES];
+            [w resize_frame:r];
+            [w set_resizing_title:r];
+        }
+    }
+    else
+        return;
+
+    now = CFAbsoluteTimeGetCurrent ();
+    if (drag_state.steps > 0 && now - drag_state.last_step > drag_state.max_interval)
+        drag_state.max_interval = now - drag_state.last_step;
+    drag_state.last_step = now;
+    drag_state.steps++;
+}
+
+static void
+drag_timer_callback (CFRunLoopTimerRef timer __attribute__((unused)),
+                     void *info __attribute__((unused)))
+{
+    x_window *w;
+
+    if (!drag_state.target_pending)
+        return;
+
+    w = x_get_window (pointer_state.down_id);
+    if (w == nil)
+        return;
+
+    drag_apply (w);
+    XFlush (x_dpy);
+}
+
+static void
+drag_begin (x_window *w)
+{
+    [w begin_interactive];
+
+    /* The dock may have changed size since it was last asked, without
+       telling anyone; the motion that follows doesn't ask again. */
+    [w->_screen update_dock];
+
+#if MAC_OS_X_VERSION_MIN_REQUIRED >= 1050
+    if (pointer_state.dragging)
+        qwm_dock_drag_begin([w get_osx_id]);
+#endif
+
+    drag_state.target_pending = NO;
+    drag_state.start_time = CFAbsoluteTimeGetCurrent ();
+    drag_state.last_step = 0;
+    drag_state.max_interval = 0;
+    drag_state.steps = 0;
+}
+
+/* Pace frame changes to DRAG_STEP_INTERVAL. If we're early, remember the
+   position and let the timer apply whatever the latest one is. */
+static void
+drag_motion (x_window *w, X11Point p)
+{
+    CFAbsoluteTime now, next;
+
+    drag_state.target = p;
+    drag_state.target_pending = YES;
+
+    now = CFAbsoluteTimeGetCurrent ();
+    next = drag_state.last_step + DRAG_STEP_INTERVAL;
+
+    if (now >= next)
+    {
+        drag_apply (w);
+        return;
+    }
+
+    if (drag_state.timer == NULL)
+    {
+        /* Effectively one-shot; we set the fire date ourselves. */
+        drag_state.timer = CFRunLoopTimerCreate (kCFAllocatorDefault, next, 1.0e9,
+                                                 0, 0, drag_timer_callback, NULL);
+        CFRunLoopAddTimer (CFRunLoopGetCurrent (), drag_state.timer,
+                           kCFRunLoopCommonModes);
+    }
+    else
+    {
+        CFRunLoopTimerSetNextFireDate (drag_state.timer, next);
+    }
+}
+
+static void
+drag_end (x_window *w)
 {
-    x_list *node;
+    CFAbsoluteTime elapsed;
 
-    node = x_list_find (lst, item);
+    if (drag_state.target_pending)
+        drag_apply (w);
+
+    if (pointer_state.dragging)
+    {
+#if MAC_OS_X_VERSION_MIN_REQUIRED >= 1050
+        qwm_dock_drag_end([w get_osx_id]);
+#endif
+        pointer_state.dragging = NO;
+    }
 
-    if (node != NULL)
+    if (pointer_state.resizing)
     {
-        node = node->next;
-        if (node == NULL)
-            node = lst;
+        pointer_state.resizing = NO;
+        [w remove_resizing_title];
     }
 
-    if (node != NULL && node->data != item)
+    [w end_interactive];
+
+    elapsed = CFAbsoluteTimeGetCurrent () - drag_state.start_time;
+    DB("%u steps in %.1fms, mean %.1fms, max %.1fms between steps",
+       drag_state.steps, elapsed * 1000.0,
+       drag_state.steps > 0 ? elapsed * 1000.0 / drag_state.steps : 0.0,
+       drag_state.max_interval * 1000.0);
+}
+
+/* The window after W in its screen's window list, wrapping around */
+static x_window *
+window_next (x_window *w, Bool reversed)
+{
+    x_chain_node *node;
+
+    node = x_chain_cycle (&w->_screen->_window_list, &w->_window_node,
+                          reversed);
+
+    if (node != NULL && node->data != w)
         return node->data;
 
-    return NULL;
+    return nil;
 }
 
 static void
 next_window (Time timestamp, Bool reversed)
 {
     x_window *w, *x;
-    x_list *lst;
 
     w = x_get_active_window ();
     if (w != nil)
     {
-        lst = x_list_copy (w->_screen->_window_list);
-        if (reversed)
-            lst = x_list_reverse (lst);
-
-        x = list_next (lst, w);
+        x = window_next (w, reversed);
 
         /* Skip minimized windows. */
         while (x != nil && x != w && x->_minimized)
-            x = list_next (lst, x);
+            x = window_next (x, reversed);
 
         [x activate:timestamp];
-
-        x_list_free (lst);
     }
 }
 
 static void
 x_event_button (XButtonEvent *e)
 {
-    x_window *w = x_get_window (e->window);
+    x_window_role role;
+    x_window *w = x_get_window_with_role (e->window, &role);
 
     if (w == nil)
         return;
 
-    if (e->window == w->_id)
+    if (role == X_WINDOW_ROLE_CLIENT)
     {
         /* Swallow the first activating click. Since the X server activates
          us we need to look at timestamps to handle the case where the
@@ -176,12 +338,12 @@
         }
     }
     else if (e->button <= 3
-             && (e->window == w->_frame_id || e->window == w->_growbox_id))
+             && (role == X_WINDOW_ROLE_FRAME || role == X_WINDOW_ROLE_GROWBOX))
     {
         unsigned int old_attrs = w->_frame_attr;
         X11Point p = X11PointMake (e->x, e->y);
 
-        if (e->window == w->_growbox_id)
+        if (role == X_WINDOW_ROLE_GROWBOX)
         {
             p.x += w->_growbox_rect.x;
             p.y += w->_growbox_rect.y;
@@ -193,6 +355,8 @@
             {
                 /* First button press */
 
+                press_start = x_stats_now ();
+
                 /* FIXME: wrap around? */
                 if (e->time - pointer_state.down_time < DOUBLE_CLICK_TIME)
                     pointer_state.click_count++;
@@ -205,6 +369,17 @@
                 pointer_state.down_time = e->time;
                 pointer_state.down_attrs = [w hit_test_frame:p];
 
+                /* We want every motion event while the button is held,
+                   rather than having to query the pointer after each
+                   hint. */
+                XChangeActivePointerGrab (x_dpy, ((role == X_WINDOW_ROLE_GROWBOX
+                                                   ? X_GROWBOX_WINDOW_EVENTS
+                                                   : X_FRAME_WINDOW_EVENTS)
+                                                  & (ButtonPressMask | ButtonReleaseMask
+                                                     | ButtonMotionMask | EnterWindowMask
+                                                     | LeaveWindowMask)),
+                                          None, e->time);
+
                 if ((pointer_state.down_attrs
                      & (w->_frame_attr & XP_FRAME_ATTRS_ANY_BUTTON)) != 0)
                 {
@@ -225,17 +400,9 @@
             {
                 /* Releasing last button */
 
-                if (pointer_state.dragging)
-                {
-#if MAC_OS_X_VERSION_MIN_REQUIRED >= 1050
-                    qwm_dock_drag_end([w get_osx_id]);
-#endif
-                    pointer_state.dragging = NO;
-                }
-                else if (pointer_state.resizing)
+                if (pointer_state.dragging || pointer_state.resizing)
                 {
-                    pointer_state.resizing = NO;
-                    [w remove_resizing_title];
+                    drag_end (w);
                 }
                 else if (pointer_state.clicking)
                 {
@@ -287,7 +454,8 @@
 static void
 x_event_motion_notify (XMotionEvent *e)
 {
-    x_window *w = x_get_window (e->window);
+    x_window_role role;
+    x_window *w = x_get_window_with_role (e->window, &role);
 
     if (w == nil)
         return;
@@ -303,57 +471,26 @@
         if (e->window == pointer_state.down_id)
         {
             X11Point p, wp;
-            X11Rect r;
             unsigned int old_attrs = w->_frame_attr, attrs;
 
-            Window tem_w;
-            unsigned int tem_i;
-            int x, y, wx, wy;
-
-            XQueryPointer (x_dpy, e->window, &tem_w, &tem_w,
-                           &x, &y, &wx, &wy, &tem_i);
+            /* The event's own coordinates are where the pointer was when
+               it was generated; that's all we need. */
+            p = X11PointMake(e->x_root, e->y_root);
+            wp = X11PointMake(e->x, e->y);
 
-            p = X11PointMake(x, y);
-            wp = X11PointMake(wx, wy);
+            if (e->is_hint)
+                request_motion_hint (e->window);
 
             if (buttons_pressed (e->state) == 0)
             {
                 /* We must have missed the button-release */
-                if(pointer_state.dragging) {
-#if MAC_OS_X_VERSION_MIN_REQUIRED >= 1050
-                    qwm_dock_drag_end([w get_osx_id]);
-#endif
-                    pointer_state.dragging = NO;
-                }
-                if (pointer_state.resizing) {
-                    pointer_state.resizing = NO;
-                    [w remove_resizing_title];
-                }
+                if (pointer_state.dragging || pointer_state.resizing)
+                    drag_end (w);
             }
 
-            if (pointer_state.dragging)
-            {
-            do_drag:
-                r = X11RectMake(p.x + pointer_state.offset.x, p.y + pointer_state.offset.y,
-                                w->_current_frame.width, w->_current_frame.height);
-                r = [w->_screen validate_window_position:r titlebar_height:w->_frame_title_height];
-#if MAC_OS_X_VERSION_MIN_REQUIRED >= 1050
-                qwm_dock_drag_begin([w get_osx_id]);
-#endif
-                [w resize_frame:r];
-            }
-            else if (pointer_state.resizing)
+            if (pointer_state.dragging || pointer_state.resizing)
             {
-            do_resize:
-                r = X11RectMake(w->_current_frame.x, w->_current_frame.y,
-                                pointer_state.offset.x + (p.x - pointer_state.down_location.x),
-                                pointer_state.offset.y + (p.y - pointer_state.down_location.y));
-                if (r.width > 0 && r.height > 0)
-                {
-                    r = [w validate_frame_rect:r from_user:YES];
-                    [w resize_frame:r];
-                    [w set_resizing_title:r];
-                }
+                drag_motion (w, p);
             }
             else if (pointer_state.clicking)
             {
@@ -380,20 +517,22 @@
                 if ((e->state & BUTTON_MASK) != 0
                     && point_distance (pointer_state.down_location, p) >= DRAG_THRESHOLD)
                 {
-                    if (e->window == w->_growbox_id)
+                    if (role == X_WINDOW_ROLE_GROWBOX)
                     {
                         pointer_state.offset.x = w->_current_frame.width;
                         pointer_state.offset.y = w->_current_frame.height;
                         pointer_state.resizing = YES;
-                        goto do_resize;
+                        drag_begin (w);
+                        drag_motion (w, p);
                     }
-                    else if (e->window == w->_frame_id
+                    else if (role == X_WINDOW_ROLE_FRAME
                              && w->_movable && e->subwindow == None)
                     {
                         pointer_state.offset.x = w->_current_frame.x - pointer_state.down_location.x;
                         pointer_state.offset.y = w->_current_frame.y - pointer_state.down_location.y;
                         pointer_state.dragging = YES;
-                        goto do_drag;
+                        drag_begin (w);
+                        drag_motion (w, p);
                     }
                 }
             }
@@ -431,11 +570,24 @@
 static void
 x_event_property_notify (XPropertyEvent *e)
 {
-    x_window *w = x_get_window (e->window);
+    x_window_role role;
+    x_window *w = x_get_window_with_role (e->window, &role);
+
+    if (w == nil)
+        return;
+
+    /* The server puts the native window id on the frame once it has
+       one; that's what keeps the osx_id index current. */
+    if (role == X_WINDOW_ROLE_FRAME && e->atom == atoms.native_window_id)
+    {
+        [w property_changed:e->atom];
+        return;
+    }
 
-    if (w == nil || e->window != w->_id)
+    if (role != X_WINDOW_ROLE_CLIENT)
         return;
 
+    x_property_cache_invalidate (e->window, e->atom);
     [w property_changed:e->atom];
 }
 
@@ -460,12 +612,25 @@ static void x_event_client_message (XClientMessageEvent *e) {
     }
 }
 
+static void
+x_event_sync_alarm_notify (XSyncAlarmNotifyEvent *e)
+{
+    x_window_role role;
+    x_window *w = x_get_window_with_role (e->alarm, &role);
+
+    if (w == nil || role != X_WINDOW_ROLE_SYNC_ALARM)
+        return;
+
+    [w sync_alarm_notify:e];
+}
+
 static void
 x_event_destroy_notify (XDestroyWindowEvent *e)
 {
-    x_window *w = x_get_window (e->window);
+    x_window_role role;
+    x_window *w = x_get_window_with_role (e->window, &role);
 
-    if (w == nil || e->window != w->_id)
+    if (w == nil || role != X_WINDOW_ROLE_CLIENT)
         return;
 
     [w->_screen remove_window:w];
@@ -478,11 +643,9 @@ static void x_event_client_message (XClientMessageEvent *e) {
 
     if (w == nil)
     {
-        XWindowAttributes attr;
         x_screen *s;
 
-        XGetWindowAttributes (x_dpy, e->window, &attr);
-        s = x_get_screen (attr.screen);
+        s = x_get_screen_with_root (e->parent);
         if (s == nil)
             return;
 
@@ -522,6 +685,7 @@ static void x_event_client_message (XClientMessageEvent *e) {
     }
 
     w->_unmapped = YES;
+    w->_client_unmapped = YES;		/* it's done already */
     [w->_screen remove_window:w];
 
     XDeleteProperty (x_dpy, e->window, atoms.wm_state);
@@ -551,12 +715,13 @@ static void x_event_client_message (XClientMessageEvent *e) {
 static void
 x_event_crossing (XCrossingEvent *e)
 {
-    x_window *w = x_get_window (e->window);
+    x_window_role role;
+    x_window *w = x_get_window_with_role (e->window, &role);
 
     if (w == nil)
         return;
 
-    if (e->window == w->_tracking_id)
+    if (role == X_WINDOW_ROLE_TRACKING)
     {
         if (pointer_state.clicking)
             return;
@@ -568,7 +733,7 @@ static void x_event_client_message (XClientMessageEvent *e) {
 
         [w decorate];
     }
-    else if (e->window == w->_frame_id && focus_follows_mouse)
+    else if (role == X_WINDOW_ROLE_FRAME && focus_follows_mouse)
     {
         if (e->type == EnterNotify)
             [w focus:e->time raise:NO];
@@ -579,18 +744,19 @@ static void x_event_client_message (XClientMessageEvent *e) {
 x_event_configure_notify (XConfigureEvent *e)
 {
     x_window *w;
+    x_window_role role;
     x_screen *s;
 
     if (e->send_event)
         return;
 
-    w = x_get_window (e->window);
+    w = x_get_window_with_role (e->window, &role);
 
     if (w != nil)
     {
         X11Rect r = X11RectMake (e->x, e->y, e->width, e->height);
 
-        if (e->window == w->_frame_id)
+        if (role == X_WINDOW_ROLE_FRAME)
         {
             [w report_frame_size:r];
         }
@@ -605,19 +771,38 @@ static void x_event_client_message (XClientMessageEvent *e) {
                 asl_log(aslc, NULL, ASL_LEVEL_WARNING, "XRRUpdateConfiguration failed.");
             }
 
-            [s update_geometry];
-            [s foreach_window:@selector (validate_position)];
+            [s screen_changed];
         }
     }
 }
 
+/* RRScreenChangeNotify or RRNotify; heads come from the RandR monitors,
+   which these report changes to. */
+static void
+x_event_randr_notify (XEvent *e)
+{
+    x_screen *s = x_get_screen_with_root (e->xany.window);
+
+    if (s == nil)
+        return;
+
+    if (e->type == x_randr_event_base + RRScreenChangeNotify
+        && !XRRUpdateConfiguration (e))
+    {
+        asl_log(aslc, NULL, ASL_LEVEL_WARNING, "XRRUpdateConfiguration failed.");
+    }
+
+    [s screen_changed];
+}
+
 static void x_event_configure_request(XConfigureRequestEvent *e) {
-    x_window *w = x_get_window (e->window);
+    x_window_role role;
+    x_window *w = x_get_window_with_role (e->window, &role);
 
     XWindowChanges client_changes, real_frame_changes, *frame_changes;
     unsigned long client_mask, real_frame_mask, *frame_mask;
 
-    if(w != nil && e->window != w->_id)
+    if(w != nil && role != X_WINDOW_ROLE_CLIENT)
         w = nil;
 
     if(w == nil) {
@@ -645,13 +830,24 @@ static void x_event_configure_request(XConfigureRequestEvent *e) {
     frame_changes = w->_reparented ? &real_frame_changes : &client_changes;
     frame_mask = w->_reparented ? &real_frame_mask : &client_mask;
 
+    /* Plain raises and lowers go through the screen's stack, so it
+       stays in step with the server. Anything else is passed on, and
+       the stack has to be resent on the next raise. */
     if (e->value_mask & CWStackMode) {
-        frame_changes->stack_mode = e->detail;
-        *frame_mask |= CWStackMode;
+        if(!(e->value_mask & CWSibling) && e->detail == Above) {
+            [w raise];
+        } else if(!(e->value_mask & CWSibling) && e->detail == Below) {
+            [w->_screen lower_window:w];
+        } else {
+            frame_changes->stack_mode = e->detail;
+            *frame_mask |= CWStackMode;
+
+            if(e->value_mask & CWSibling) {
+                frame_changes->sibling = e->above;
+                *frame_mask |= CWSibling;
+            }
 
-        if(e->value_mask & CWSibling) {
-            frame_changes->sibling = e->above;
-            *frame_mask |= CWSibling;
+            [w->_screen invalidate_stack];
         }
     }
 
@@ -690,8 +886,9 @@ static void x_event_configure_request(XConfigureRequestEvent *e) {
 
     w->_shaped = e->shaped ? YES : NO;
     w->_shaped_empty = (e->shaped && (e->width <= 0 || e->height <= 0));
+    w->_shape_changed = YES;
 
-    [w update_shape];
+    [w reshape];
 }
 
 static void
@@ -880,106 +1077,461 @@ static void x_event_configure_request(XConfigureRequestEvent *e) {
                 return "ShapeNotify";
             else if (type == x_apple_wm_event_base + AppleWMControllerNotify)
                 return "AppleWMControllerNotify";
+            else if (x_have_randr_monitors
+                     && type == x_randr_event_base + RRScreenChangeNotify)
+                return "RRScreenChangeNotify";
+            else if (x_have_randr_monitors
+                     && type == x_randr_event_base + RRNotify)
+                return "RRNotify";
             sprintf (buf, "Unknown:%d", type);
             return buf;
     }
 }
 
+/* Statistics are kept per event type, named after the handler each
+   one goes to. */
+
+static const struct {
+    int type;
+    const char *name, *handler;
+} event_handlers[] = {
+    { KeyPress, "KeyPress", "x_event_key" },
+    { KeyRelease, "KeyRelease", "x_event_key" },
+    { ButtonPress, "ButtonPress", "x_event_button" },
+    { ButtonRelease, "ButtonRelease", "x_event_button" },
+    { MotionNotify, "MotionNotify", "x_event_motion_notify" },
+    { FocusIn, "FocusIn", "x_event_focus" },
+    { FocusOut, "FocusOut", "x_event_focus" },
+    { EnterNotify, "EnterNotify", "x_event_crossing" },
+    { LeaveNotify, "LeaveNotify", "x_event_crossing" },
+    { DestroyNotify, "DestroyNotify", "x_event_destroy_notify" },
+    { UnmapNotify, "UnmapNotify", "x_event_unmap_notify" },
+    { MapRequest, "MapRequest", "x_event_map_request" },
+    { ReparentNotify, "ReparentNotify", "x_event_reparent_notify" },
+    { ConfigureRequest, "ConfigureRequest", "x_event_configure_request" },
+    { ConfigureNotify, "ConfigureNotify", "x_event_configure_notify" },
+    { PropertyNotify, "PropertyNotify", "x_event_property_notify" },
+    { ClientMessage, "ClientMessage", "x_event_client_message" },
+    { Expose, "Expose", "x_event_expose" },
+    { ColormapNotify, "ColormapNotify", "x_event_colormap_notify" },
+    { MappingNotify, "MappingNotify", "x_event_mapping_notify" },
+};
+
+static int event_slots[LASTEvent];
+static int shape_notify_slot, sync_alarm_notify_slot, apple_wm_notify_slot;
+static int randr_notify_slot;
+static int other_event_slot;
+
+static void
+register_event_slots (void)
+{
+    unsigned int i;
+
+    other_event_slot = x_stats_register ("(other events)", NULL);
+
+    for (i = 0; i < LASTEvent; i++)
+        event_slots[i] = other_event_slot;
+
+    for (i = 0; i < sizeof (event_handlers) / sizeof (event_handlers[0]); i++)
+    {
+        event_slots[event_handlers[i].type]
+            = x_stats_register (event_handlers[i].name,
+                                event_handlers[i].handler);
+    }
+
+    shape_notify_slot = x_stats_register ("ShapeNotify",
+                                          "x_event_shape_notify");
+    sync_alarm_notify_slot = x_stats_register ("XSyncAlarmNotify",
+                                               "x_event_sync_alarm_notify");
+    apple_wm_notify_slot = x_stats_register ("AppleWMNotify",
+                                             "x_event_apple_wm_notify");
+    randr_notify_slot = x_stats_register ("RRNotify",
+                                          "x_event_randr_notify");
+    press_slot = x_stats_register ("(frame press to redraw)", NULL);
+}
+
+static int
+event_slot (XEvent *e)
+{
+    if (e->type >= 0 && e->type < LASTEvent)
+        return event_slots[e->type];
+    else if (e->type == x_shape_event_base + ShapeNotify)
+        return shape_notify_slot;
+    else if (x_have_sync && e->type == x_sync_event_base + XSyncAlarmNotify)
+        return sync_alarm_notify_slot;
+    else if (x_have_randr_monitors
+             && (e->type == x_randr_event_base + RRScreenChangeNotify
+                 || e->type == x_randr_event_base + RRNotify))
+        return randr_notify_slot;
+    else if (e->type - x_apple_wm_event_base >= 0
+             && e->type - x_apple_wm_event_base < AppleWMNumberEvents)
+        return apple_wm_notify_slot;
+    else
+        return other_event_slot;
+}
+
+static void
+x_input_dispatch (XEvent *e)
+{
+    DB("<%s window:%lx>", event_name (e->type), e->xany.window);
+
+    switch (e->type)
+    {
+        case KeyPress:
+        case KeyRelease:
+            x_event_key (&e->xkey);
+            break;
+
+        case ButtonPress:
+        case ButtonRelease:
+            x_event_button (&e->xbutton);
+            break;
+
+        case MotionNotify:
+            x_event_motion_notify (&e->xmotion);
+            break;
+
+        case FocusIn:
+        case FocusOut:
+            x_event_focus (&e->xfocus);
+            break;
+
+        case EnterNotify:
+        case LeaveNotify:
+            x_event_crossing (&e->xcrossing);
+            break;
+
+        case DestroyNotify:
+            x_event_destroy_notify (&e->xdestroywindow);
+            break;
+
+        case UnmapNotify:
+            x_event_unmap_notify (&e->xunmap);
+            break;
+
+        case MapRequest:
+            x_event_map_request (&e->xmaprequest);
+            break;
+
+        case ReparentNotify:
+            x_event_reparent_notify (&e->xreparent);
+            break;
+
+        case ConfigureRequest:
+            x_event_configure_request (&e->xconfigurerequest);
+            break;
+
+        case ConfigureNotify:
+            x_event_configure_notify (&e->xconfigure);
+            break;
+
+        case PropertyNotify:
+            x_event_property_notify (&e->xproperty);
+            break;
+
+        case ClientMessage:
+            x_event_client_message (&e->xclient);
+            break;
+
+        case Expose:
+            x_event_expose (&e->xexpose);
+            break;
+
+        case ColormapNotify:
+            x_event_colormap_notify (&e->xcolormap);
+            break;
+
+        case MappingNotify:
+            x_event_mapping_notify (&e->xmapping);
+            break;
+
+        default:
+            if (e->type == x_shape_event_base + ShapeNotify)
+                x_event_shape_notify ((XShapeEvent *) e);
+            else if (x_have_sync
+                     && e->type == x_sync_event_base + XSyncAlarmNotify)
+            {
+                x_event_sync_alarm_notify ((XSyncAlarmNotifyEvent *) e);
+            }
+            else if (x_have_randr_monitors
+                     && (e->type == x_randr_event_base + RRScreenChangeNotify
+                         || e->type == x_randr_event_base + RRNotify))
+            {
+                x_event_randr_notify (e);
+            }
+            else if (e->type - x_apple_wm_event_base >= 0
+                     && e->type - x_apple_wm_event_base < AppleWMNumberEvents)
+            {
+                x_event_apple_wm_notify ((XAppleWMNotifyEvent *) e);
+            }
+            break;
+    }
+}
+
+/* Events whose handlers only care about the latest one for a given
+   window (and atom/kind). Returns false for everything else, which must
+   be dispatched in order. */
+
+static BOOL
+supersedable_event (XEvent *e, Window *window_ret, unsigned long *detail_ret)
+{
+    switch (e->type)
+    {
+        case MotionNotify:
+            *window_ret = e->xmotion.window;
+            *detail_ret = e->xmotion.state;
+            return TRUE;
+
+        case ConfigureNotify:
+            *window_ret = e->xconfigure.window;
+            *detail_ret = e->xconfigure.send_event;
+            return TRUE;
+
+        case PropertyNotify:
+            *window_ret = e->xproperty.window;
+            *detail_ret = e->xproperty.atom;
+            return TRUE;
+
+        case Expose:
+            *window_ret = e->xexpose.window;
+            *detail_ret = 0;
+            return TRUE;
+
+        default:
+            if (e->type == x_shape_event_base + ShapeNotify)
+            {
+                *window_ret = ((XShapeEvent *) e)->window;
+                *detail_ret = ((XShapeEvent *) e)->kind;
+                return TRUE;
+            }
+            return FALSE;
+    }
+}
+
+unsigned long x_input_events_dispatched, x_input_events_coalesced;
+
+static XEvent *batch;
+static int batch_size;
+
+/* Slots holding the latest event for each key seen since the last
+   order-sensitive event. */
+
+typedef struct {
+    int type;
+    Window window;
+    unsigned long detail;
+    int index;
+} batch_slot;
+
+static batch_slot *batch_slots;
+
+/* Notify events caused by our own requests on client windows. Each
+   entry swallows one event of the given type for the window, provided
+   its serial lies within the range of requests we issued. Entries that
+   matched nothing are dropped once the server is known to have
+   processed later requests and all their events have been read. */
+
+typedef struct {
+    Window window;
+    int type;
+    unsigned long first, last;
+} expected_event;
+
+static expected_event *expected;
+static int n_expected, expected_size;
+
+/* Requests before this serial have had all their events read */
+static unsigned long batch_serial;
+
+unsigned long x_input_events_suppressed;
+
+/* Call after issuing the request(s) that will generate an event of TYPE
+   on window ID, passing the value of NextRequest() from before them. */
+
 void
-x_input_run (void)
+x_input_expect_event (Window id, unsigned long serial, int type)
 {
-    while (XPending (x_dpy) != 0)
+    if (n_expected == expected_size)
     {
-        XEvent e;
+        expected_size = expected_size > 0 ? expected_size * 2 : 16;
+        expected = realloc (expected, expected_size * sizeof (expected_event));
+        assert (expected != NULL);
+    }
 
-        XNextEvent (x_dpy, &e);
+    expected[n_expected].window = id;
+    expected[n_expected].type = type;
+    expected[n_expected].first = serial;
+    expected[n_expected].last = NextRequest (x_dpy) - 1;
+    n_expected++;
+}
 
-        DB("<%s window:%lx>", event_name (e.type), e.xany.window);
+static Window
+expected_event_window (XEvent *e)
+{
+    switch (e->type)
+    {
+        case UnmapNotify:
+            return e->xunmap.window;
+        case MapNotify:
+            return e->xmap.window;
+        case ReparentNotify:
+            return e->xreparent.window;
+        case ConfigureNotify:
+            return e->xconfigure.window;
+        default:
+            return None;
+    }
+}
 
-        switch (e.type)
-        {
-            case KeyPress:
-            case KeyRelease:
-                x_event_key (&e.xkey);
-                break;
+static BOOL
+x_input_suppress_event (XEvent *e)
+{
+    Window id;
+    int i;
 
-            case ButtonPress:
-            case ButtonRelease:
-                x_event_button (&e.xbutton);
-                break;
+    if (n_expected == 0 || e->xany.send_event)
+        return FALSE;
 
-            case MotionNotify:
-                x_event_motion_notify (&e.xmotion);
-                break;
+    id = expected_event_window (e);
+    if (id == None)
+        return FALSE;
 
-            case FocusIn:
-            case FocusOut:
-                x_event_focus (&e.xfocus);
-                break;
+    for (i = 0; i < n_expected; i++)
+    {
+        if (expected[i].window == id && expected[i].type == e->type
+            && e->xany.serial >= expected[i].first
+            && e->xany.serial <= expected[i].last)
+        {
+            expected[i] = expected[--n_expected];
+            x_input_events_suppressed++;
+            return TRUE;
+        }
+    }
 
-            case EnterNotify:
-            case LeaveNotify:
-                x_event_crossing (&e.xcrossing);
-                break;
+    return FALSE;
+}
 
-            case DestroyNotify:
-                x_event_destroy_notify (&e.xdestroywindow);
-                break;
+static void
+x_input_expire_expected (void)
+{
+    int i;
 
-            case UnmapNotify:
-                x_event_unmap_notify (&e.xunmap);
-                break;
+    for (i = 0; i < n_expected;)
+    {
+        if (expected[i].last < batch_serial)
+            expected[i] = expected[--n_expected];
+        else
+            i++;
+    }
+}
 
-            case MapRequest:
-                x_event_map_request (&e.xmaprequest);
-                break;
+/* Read everything that is already queued, dropping events that are
+   superseded by a later one of the same kind for the same window. An
+   event is never moved past an order-sensitive event (map, unmap,
+   destroy, reparent, focus, button, ...), since those flush the set of
+   candidates. Superseded events get type 0. Returns the batch length. */
 
-            case ReparentNotify:
-                x_event_reparent_notify (&e.xreparent);
-                break;
+static int
+x_input_read_batch (void)
+{
+    int n, i, j, n_slots = 0, coalesced = 0;
 
-            case ConfigureRequest:
-                x_event_configure_request (&e.xconfigurerequest);
-                break;
+    n = XEventsQueued (x_dpy, QueuedAfterFlush);
+    if (n <= 0)
+        return 0;
 
-            case ConfigureNotify:
-                x_event_configure_notify (&e.xconfigure);
-                break;
+    /* Everything generated before the last request the server replied
+       to or sent an event for is now in the queue, hence in this batch. */
+    batch_serial = LastKnownRequestProcessed (x_dpy);
 
-            case PropertyNotify:
-                x_event_property_notify (&e.xproperty);
-                break;
+    if (n > batch_size)
+    {
+        batch_size = n * 2;
+        batch = realloc (batch, batch_size * sizeof (XEvent));
+        batch_slots = realloc (batch_slots, batch_size * sizeof (batch_slot));
+        assert (batch != NULL && batch_slots != NULL);
+    }
 
-            case ClientMessage:
-                x_event_client_message (&e.xclient);
-                break;
+    for (i = 0; i < n; i++)
+    {
+        Window window;
+        unsigned long detail;
 
-            case Expose:
-                x_event_expose (&e.xexpose);
-                break;
+        XNextEvent (x_dpy, &batch[i]);
 
-            case ColormapNotify:
-                x_event_colormap_notify (&e.xcolormap);
-                break;
+        if (!supersedable_event (&batch[i], &window, &detail))
+        {
+            n_slots = 0;
+            continue;
+        }
 
-            case MappingNotify:
-                x_event_mapping_notify (&e.xmapping);
+        for (j = 0; j < n_slots; j++)
+        {
+            if (batch_slots[j].type == batch[i].type
+                && batch_slots[j].window == window
+                && batch_slots[j].detail == detail)
+            {
                 break;
+            }
+        }
 
-            default:
-                if (e.type == x_shape_event_base + ShapeNotify)
-                    x_event_shape_notify ((XShapeEvent *) &e);
-                else if (e.type - x_apple_wm_event_base >= 0
-                         && e.type - x_apple_wm_event_base < AppleWMNumberEvents)
-                {
-                    x_event_apple_wm_notify ((XAppleWMNotifyEvent *) &e);
-                }
-                break;
+        if (j < n_slots)
+        {
+            batch[batch_slots[j].index].type = 0;
+            coalesced++;
         }
+        else
+        {
+            batch_slots[j].type = batch[i].type;
+            batch_slots[j].window = window;
+            batch_slots[j].detail = detail;
+            n_slots++;
+        }
+
+        batch_slots[j].index = i;
+    }
+
+    if (coalesced > 0)
+    {
+        DB("coalesced %d of %d events", coalesced, n);
+        x_input_events_coalesced += coalesced;
+    }
+
+    return n;
+}
+
+void
+x_input_run (void)
+{
+    int n, i;
+
+    while ((n = x_input_read_batch ()) > 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            if (batch[i].type == 0 || x_input_suppress_event (&batch[i]))
+                continue;
+
+            x_stats_begin (event_slot (&batch[i]));
+            x_input_dispatch (&batch[i]);
+            x_stats_end ();
+            x_input_events_dispatched++;
 
 #ifdef CHECK_WINDOWS
-        x_check_windows ();
+            x_check_windows ();
 #endif
+        }
+
+        x_input_expire_expected ();
+
+        /* Flushed when we look for the next batch */
+        x_flush_deferred ();
+
+        if (press_start != 0)
+        {
+            x_stats_record (press_slot, x_stats_now () - press_start);
+            press_start = 0;
+        }
     }
 }
 
@@ -1020,6 +1572,8 @@ static void x_event_configure_request(XConfigureRequestEvent *e) {
 void
 x_input_register (void)
 {
+    register_event_slots ();
+
     if (!add_input_socket (ConnectionNumber (x_dpy), kCFSocketReadCallBack,
                            x_input_callback, NULL, &x_dpy_source))
     {
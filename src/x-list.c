@@ -44,11 +44,15 @@ static x_list *freelist;
 
 static pthread_mutex_t freelist_lock = PTHREAD_MUTEX_INITIALIZER;
 
+unsigned long X_PFX (list_blocks_allocated);
+unsigned long X_PFX (list_nodes_allocated), X_PFX (list_nodes_freed);
+
 static inline void
 list_free_1 (x_list *node)
 {
     node->next = freelist;
     freelist = node;
+    X_PFX (list_nodes_freed)++;
 }
 
 X_EXTERN void
@@ -92,6 +96,7 @@ X_PFX (list_prepend) (x_list *lst, void *data)
         int i;
 
         b = malloc (sizeof (x_list_block));
+        X_PFX (list_blocks_allocated)++;
 
         for (i = 0; i < NODES_PER_BLOCK - 1; i++)
             b->l[i].next = &(b->l[i+1]);
@@ -102,6 +107,7 @@ X_PFX (list_prepend) (x_list *lst, void *data)
 
     node = freelist;
     freelist = node->next;
+    X_PFX (list_nodes_allocated)++;
 
     pthread_mutex_unlock (&freelist_lock);
 
@@ -122,9 +128,9 @@ X_PFX (list_append) (x_list *lst, void *data)
     while (lst->next != NULL)
         lst = lst->next;
 
-        lst->next = X_PFX (list_prepend) (NULL, data);
+    lst->next = X_PFX (list_prepend) (NULL, data);
 
-        return head;
+    return head;
 }
 
 X_EXTERN x_list *
@@ -161,7 +167,7 @@ X_PFX (list_nth) (x_list *lst, int n)
     while (n-- > 0 && lst != NULL)
         lst = lst->next;
 
-        return lst;
+    return lst;
 }
 
 X_EXTERN x_list *
@@ -180,7 +186,7 @@ X_PFX (list_pop) (x_list *lst, void **data_ret)
     if (data_ret != NULL)
         *data_ret = data;
 
-        return lst;
+    return lst;
 }
 
 X_EXTERN x_list *
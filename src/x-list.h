@@ -42,6 +42,11 @@
 # define X_EXTERN __private_extern__
 #endif
 
+/* Nodes come from a pool shared by all lists; these count the blocks
+   taken from malloc for it, and the nodes handed out and returned. */
+extern unsigned long X_PFX (list_blocks_allocated);
+extern unsigned long X_PFX (list_nodes_allocated), X_PFX (list_nodes_freed);
+
 X_EXTERN void X_PFX (list_free_1) (x_list *node);
 X_EXTERN x_list *X_PFX (list_prepend) (x_list *lst, void *data);
 
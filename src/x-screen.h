@@ -32,11 +32,24 @@
 #undef Cursor
 
 #include "x-list.h"
+#include "x-chain.h"
+#include "x-hash.h"
+#include "x-stack.h"
+#include "x-grid.h"
+#include "x-usable.h"
 #include "x11-geometry.h"
 #include "dock-support.h"
 
 @class x_window;
 
+/* A root window list property, as we last wrote it */
+typedef struct {
+    long *ids;
+    int n_ids, size;
+    unsigned published :1;
+    unsigned dirty :1;
+} x_root_list;
+
 @interface x_screen : NSObject
 {
 @public
@@ -57,21 +70,64 @@ @interface x_screen : NSObject
 
     X11Region * _screen_region;
 
-    x_list *_window_list;
-    x_list *_stacking_list;
+    /* _screen_region and _heads less the dock, see update_dock */
+    x_usable_area _usable;
+
+    /* Where the geometry changed since windows were last revalidated,
+       or everywhere, see update_geometry */
+    X11Region _geometry_changed;
+    unsigned _geometry_changed_all :1;
+
+    /* Screen changes come in bursts; they're acted on once it's over */
+    NSTimer *_geometry_timer;
+    CFAbsoluteTime _geometry_first_change;
+
+    x_chain _window_list;		/* oldest first, nodes are x_window->_window_node */
+    x_stack _stack;			/* nodes are x_window->_stack_node */
+    unsigned _stack_diverged :1;	/* see invalidate_stack */
+    x_grid _grid;			/* items are x_window->_grid_item */
+
+    /* XID -> x_window, for the client and all the windows we create
+       for it. Lets us find the target of an event in constant time. */
+    x_hash_table *_window_index;
+
+    /* xp_native_window_id -> x_window, for resolving dock events */
+    x_hash_table *_osx_index;
+
+    /* Window group leader -> x_list of the members */
+    x_hash_table *_group_index;
 
     Window _net_wm_window;
 
+    /* _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING, written out by
+       flush_deferred */
+    x_root_list _client_list;
+    x_root_list _client_list_stacking;
+
+    /* Windows to decorate, and to reshape, in flush_deferred */
+    x_list *_decorate_queue;
+    x_list *_reshape_queue;
+
     unsigned _updates_disabled :1;
 }
 
-- (void) set_root_property:(const char *)name type:(const char *)type
+- (void) set_root_property:(Atom)name type:(Atom)type
                     length:(int)length data:(const long *)data;
 - init_with_screen_id:(int)id;
 - (void) update_geometry;
+- (void) screen_changed;
+- (void) revalidate_windows;
 - (void) focus_topmost:(Time)timestamp;
 - (x_list *) stacking_order:(x_list *)group;
 - (void) raise_windows:(id *)array count:(size_t)n;
+- (void) restack_window:(x_window *)w;
+- (void) lower_window:(x_window *)w;
+- (void) invalidate_stack;
+- (void) update_net_client_list;
+- (void) update_net_client_list_stacking;
+- (void) queue_decorate:(x_window *)w;
+- (void) queue_reshape:(x_window *)w;
+- (BOOL) flush_deferred;
 - (void) adopt_window:(Window)xwindow_id initializing:(BOOL)flag;
 - (void) remove_window:(x_window *)w safe:(BOOL)safe;
 - (void) remove_window:(x_window *)w;
@@ -80,9 +136,18 @@ - (void) window_hidden:(x_window *)w;
 - (void) adopt_windows;
 - (void) unadopt_windows;
 - (void) error_shutdown;
+- (void) index_window:(x_window *)w id:(Window)xwindow_id role:(x_window_role)role;
+- (void) unindex_window:(Window)xwindow_id;
 - get_window:(Window)xwindow_id;
+- get_window:(Window)xwindow_id role:(x_window_role *)role_ret;
+- (void) index_window:(x_window *)w osx_id:(xp_native_window_id)wid;
+- (void) unindex_osx_id:(xp_native_window_id)wid;
 - get_window_by_osx_id:(xp_native_window_id)id;
+- (void) group_window:(x_window *)w;
+- (void) ungroup_window:(x_window *)w;
+- (x_list *) group_members:(Window)group_id;
 - (X11Rect) validate_window_position:(X11Rect)r titlebar_height:(size_t)titlebar_height;
+- (BOOL) update_dock;
 - (X11Rect) zoomed_rect:(X11Point)p;
 - (X11Rect) zoomed_rect;
 - (X11Point) center_on_head:(X11Point)p;
@@ -93,6 +158,7 @@ - (void) hide_all;
 - (void) show_all:(BOOL)flag;
 - (void) foreach_window:(SEL)selector;
 - find_window_at:(X11Point)p slop:(int)epsilon;
+- (X11Rect) least_overlapped_rect:(X11Rect)r;
 
 /* Convert geometry on this screen */
 - (X11Point) CGToX11Point:(CGPoint)p;
@@ -28,17 +28,26 @@
 
 #include "quartz-wm.h"
 #include "utils.h"
+#include "x-stats.h"
 #import "x-screen.h"
 #import "x-window.h"
 
 #include <AppKit/AppKit.h>
 
+#include <assert.h>
+#include <string.h>
+
 #include <X11/cursorfont.h>
+#include <X11/Xatom.h>
 #include <X11/extensions/applewm.h>
 #include <X11/extensions/Xinerama.h>
+#include <X11/extensions/Xrandr.h>
 
 @interface x_screen (local)
+- (void) query_heads;
+- (void) screen_changed_timer:(NSTimer *)timer;
 - (void) net_wm_init;
+- (void) stack_window:(x_window *)w;
 @end
 
 @implementation x_screen
@@ -47,63 +56,146 @@ @implementation x_screen
 
 // To rebuild this list:
 //
-// $ grep _NET_ *.m | sed -e 's/.*\("_NET_[A-Z_]*"\).*/    \1,/' | sort | uniq
-
-static const char *net_wm_supported[] = {
-    "_NET_ACTIVE_WINDOW",
-    "_NET_CLIENT_LIST",
-    "_NET_CLIENT_LIST_STACKING",
-    "_NET_CLOSE_WINDOW",
-    "_NET_SUPPORTED",
-    "_NET_SUPPORTING_WM_CHECK",
-    "_NET_WM_ACTION_CLOSE",
-    "_NET_WM_ACTION_FULLSCREEN",
-    "_NET_WM_ACTION_MAXIMIZE_HORZ",
-    "_NET_WM_ACTION_MAXIMIZE_VERT",
-    "_NET_WM_ACTION_MINIMIZE",
-    "_NET_WM_ACTION_MOVE",
-    "_NET_WM_ACTION_RESIZE",
-    "_NET_WM_ACTION_SHADE",
-    "_NET_WM_ALLOWED_ACTIONS",
-    "_NET_WM_NAME",
-    "_NET_WM_STATE",
-    "_NET_WM_STATE_FULLSCREEN",
-    "_NET_WM_STATE_HIDDEN",
-    "_NET_WM_STATE_MAXIMIZED_HORZ",
-    "_NET_WM_STATE_MAXIMIZED_VERT",
-    "_NET_WM_STATE_MODAL",
-    "_NET_WM_STATE_SHADED",
-    "_NET_WM_STATE_SKIP_PAGER",
-    "_NET_WM_STATE_SKIP_TASKBAR",
-    "_NET_WM_STATE_STICKY",
-    "_NET_WM_WINDOW_TYPE",
-    "_NET_WM_WINDOW_TYPE_COMBO",
-    "_NET_WM_WINDOW_TYPE_DESKTOP",
-    "_NET_WM_WINDOW_TYPE_DIALOG",
-    "_NET_WM_WINDOW_TYPE_DND",
-    "_NET_WM_WINDOW_TYPE_DOCK",
-    "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU",
-    "_NET_WM_WINDOW_TYPE_MENU",
-    "_NET_WM_WINDOW_TYPE_NORMAL",
-    "_NET_WM_WINDOW_TYPE_NOTIFICATION",
-    "_NET_WM_WINDOW_TYPE_POPUP_MENU",
-    "_NET_WM_WINDOW_TYPE_SPLASH",
-    "_NET_WM_WINDOW_TYPE_TOOLBAR",
-    "_NET_WM_WINDOW_TYPE_TOOLTIP",
-    "_NET_WM_WINDOW_TYPE_UTILITY",
+// $ grep _NET_ atoms.h | sed -e 's/.*ATOM (\([a-z_]*\),.*/    \&atoms.\1,/'
+
+static const Atom *net_wm_supported[] = {
+    &atoms.net_active_window,
+    &atoms.net_client_list,
+    &atoms.net_client_list_stacking,
+    &atoms.net_close_window,
+    &atoms.net_supported,
+    &atoms.net_supporting_wm_check,
+    &atoms.net_wm_action_close,
+    &atoms.net_wm_action_fullscreen,
+    &atoms.net_wm_action_maximize_horz,
+    &atoms.net_wm_action_maximize_vert,
+    &atoms.net_wm_action_minimize,
+    &atoms.net_wm_action_move,
+    &atoms.net_wm_action_resize,
+    &atoms.net_wm_action_shade,
+    &atoms.net_wm_allowed_actions,
+    &atoms.net_wm_name,
+    &atoms.net_wm_state,
+    &atoms.net_wm_state_fullscreen,
+    &atoms.net_wm_state_hidden,
+    &atoms.net_wm_state_maximized_horz,
+    &atoms.net_wm_state_maximized_vert,
+    &atoms.net_wm_state_modal,
+    &atoms.net_wm_state_shaded,
+    &atoms.net_wm_state_skip_pager,
+    &atoms.net_wm_state_skip_taskbar,
+    &atoms.net_wm_state_sticky,
+    &atoms.net_wm_sync_request,
+    &atoms.net_wm_sync_request_counter,
+    &atoms.net_wm_window_type,
+    &atoms.net_wm_window_type_combo,
+    &atoms.net_wm_window_type_desktop,
+    &atoms.net_wm_window_type_dialog,
+    &atoms.net_wm_window_type_dnd,
+    &atoms.net_wm_window_type_dock,
+    &atoms.net_wm_window_type_dropdown_menu,
+    &atoms.net_wm_window_type_menu,
+    &atoms.net_wm_window_type_normal,
+    &atoms.net_wm_window_type_notification,
+    &atoms.net_wm_window_type_popup_menu,
+    &atoms.net_wm_window_type_splash,
+    &atoms.net_wm_window_type_toolbar,
+    &atoms.net_wm_window_type_tooltip,
+    &atoms.net_wm_window_type_utility,
 };
 
 #ifdef CHECK_WINDOWS
-static void *check_window (void *w, void *data)
+static void check_index_entry (unsigned long xwindow_id, void *data,
+                               int role, void *user_data)
 {
-    assert ([((x_window *) w) isKindOfClass:[x_window class]]);
-    return w;
+    x_window *w = data;
+
+    assert ([w isKindOfClass:[x_window class]]);
+    assert (!w->_deleted);
+
+    switch (role)
+    {
+    case X_WINDOW_ROLE_CLIENT:
+        assert (w->_id == xwindow_id);
+        break;
+    case X_WINDOW_ROLE_FRAME:
+        assert (w->_frame_id == xwindow_id);
+        break;
+    case X_WINDOW_ROLE_TRACKING:
+        assert (w->_tracking_id == xwindow_id);
+        break;
+    case X_WINDOW_ROLE_GROWBOX:
+        assert (w->_growbox_id == xwindow_id);
+        break;
+    case X_WINDOW_ROLE_SYNC_ALARM:
+        assert (w->_sync_alarm == xwindow_id);
+        break;
+    default:
+        assert (0);
+    }
 }
 
+/* Every window we know about must be in the index under each of its
+   XIDs, and the index must hold nothing else. */
 - (void) check_window_lists
 {
-    x_list_map (_window_list, check_window, NULL);
-    x_list_map (_stacking_list, check_window, NULL);
+    x_chain_node *node;
+    x_stack_node *snode;
+    unsigned int n = 0;
+
+    for (node = _window_list.head; node != NULL; node = node->next)
+    {
+        x_window *w = node->data;
+        x_window_role role;
+
+        assert (node == &w->_window_node);
+        assert ([w isKindOfClass:[x_window class]]);
+
+        assert ([self get_window:w->_id role:&role] == w);
+        assert (role == X_WINDOW_ROLE_CLIENT);
+        n++;
+
+        if (w->_frame_id != 0)
+        {
+            assert ([self get_window:w->_frame_id role:&role] == w);
+            assert (role == X_WINDOW_ROLE_FRAME);
+            n++;
+        }
+
+        if (w->_tracking_id != 0)
+        {
+            assert ([self get_window:w->_tracking_id role:&role] == w);
+            assert (role == X_WINDOW_ROLE_TRACKING);
+            n++;
+        }
+
+        if (w->_growbox_id != 0)
+        {
+            assert ([self get_window:w->_growbox_id role:&role] == w);
+            assert (role == X_WINDOW_ROLE_GROWBOX);
+            n++;
+        }
+
+        if (w->_sync_alarm != None)
+        {
+            assert ([self get_window:w->_sync_alarm role:&role] == w);
+            assert (role == X_WINDOW_ROLE_SYNC_ALARM);
+            n++;
+        }
+    }
+
+    assert (n == x_hash_table_size (_window_index));
+    assert (_window_list.tail == NULL || _window_list.tail->next == NULL);
+    x_hash_table_foreach (_window_index, check_index_entry, NULL);
+
+    n = 0;
+    for (snode = _stack.top; snode != NULL; snode = snode->below)
+    {
+        assert (((x_window *) snode->data)->_window_node.linked);
+        assert (snode->below == NULL || snode->below->level <= snode->level);
+        n++;
+    }
+    assert (n == _stack.length);
 }
 #endif
 
@@ -112,130 +204,186 @@ - (void) check_window_lists
 {
     XWindowAttributes attr;
 
-    XGetWindowAttributes (x_dpy, xwindow_id, &attr);
+    if (!x_get_window_attributes (xwindow_id, &attr))
+        return NO;
 
     return attr.map_state != IsUnmapped && attr.override_redirect != True;
 }
 
-- (void) set_property:(Window)xwindow_id name:(const char *)name
-type:(const char *)type length:(int)length data:(const long *)data
+/* Fetch everything -[x_window init_with_id:] reads from the client, for
+   all of IDS at once. */
+static void
+prefetch_for_adoption (const Window *ids, unsigned int n)
 {
-    Atom name_atom, type_atom;
-
-    name_atom = XInternAtom (x_dpy, name, False);
-    type_atom = XInternAtom (x_dpy, type, False);
+    Atom props[11];
+    unsigned int n_props = 0;
+
+    props[n_props++] = atoms.net_wm_name;
+    props[n_props++] = atoms.wm_name;
+    props[n_props++] = atoms.wm_transient_for;
+    props[n_props++] = atoms.wm_hints;
+    props[n_props++] = atoms.wm_colormap_windows;
+    props[n_props++] = atoms.wm_protocols;
+    props[n_props++] = atoms.wm_normal_hints;
+    props[n_props++] = atoms.motif_wm_hints;
+    props[n_props++] = atoms.net_wm_window_type;
+    props[n_props++] = atoms.net_wm_state;
+    props[n_props++] = atoms.net_wm_sync_request_counter;
+
+    x_prefetch_windows (ids, n, True, props, n_props);
+}
 
-    XChangeProperty (x_dpy, xwindow_id, name_atom, type_atom, 32,
+- (void) set_property:(Window)xwindow_id name:(Atom)name
+type:(Atom)type length:(int)length data:(const long *)data
+{
+    XChangeProperty (x_dpy, xwindow_id, name, type, 32,
                      PropModeReplace, (const unsigned char *) data, length);
 }
 
-- (void) set_root_property:(const char *)name type:(const char *)type
+- (void) set_root_property:(Atom)name type:(Atom)type
                     length:(int)length data:(const long *)data
 {
     [self set_property:_root name:name type:type length:length data:data];
 }
 
-- (void) update_geometry
+/* Replaces _heads with what the server says the heads are now: its
+   RandR 1.5 monitors if it has them, else the Xinerama screens. Leaves
+   _head_count zero if there's only the screen itself. */
+- (void) query_heads
 {
-    long data[2];
-    int i;
-    X11Region region_temp;
+    int i, n = 0;
 
-    TRACE ();
+    _heads = NULL;
+    _head_count = 0;
 
-    if (x_get_property (_root, atoms.native_screen_origin, data, 2, 2))
+#if RANDR_MAJOR > 1 || (RANDR_MAJOR == 1 && RANDR_MINOR >= 5)
+    if (x_have_randr_monitors)
     {
-        _x = data[0];
-        _y = data[1];
-    }
+        XRRMonitorInfo *monitors;
 
-    _width = WidthOfScreen (_screen);
-    _height = HeightOfScreen (_screen);
+        monitors = XRRGetMonitors (x_dpy, _root, True, &n);
+        x_stats_round_trip ();
 
-    DB("Screen: %dx%d", _width, _height);
+        if (monitors != NULL && n >= 1)
+        {
+            _heads = malloc (sizeof (_heads[0]) * n);
+            if (_heads == NULL)
+            {
+                asl_log(aslc, NULL, ASL_LEVEL_ERR, "Memory allocation error.");
+                abort();
+            }
 
-    /* Release the region we had before */
-    if(_screen_region != NULL) {
-        pixman_region32_fini(_screen_region);
-        free(_screen_region);
-        _screen_region = NULL;
+            for (i = 0; i < n; i++)
+            {
+                DB("monitor %d: %d,%d %dx%d%s", i, monitors[i].x, monitors[i].y,
+                   monitors[i].width, monitors[i].height,
+                   monitors[i].primary ? " (primary)" : "");
+
+                _heads[i] = X11RectMake (monitors[i].x, monitors[i].y,
+                                         monitors[i].width, monitors[i].height);
+            }
+            _head_count = n;
+        }
+
+        if (monitors != NULL)
+            XRRFreeMonitors (monitors);
+
+        return;
     }
+#endif
 
     if (XineramaIsActive (x_dpy))
     {
         XineramaScreenInfo *info;
 
-        info = XineramaQueryScreens (x_dpy, &_head_count);
+        info = XineramaQueryScreens (x_dpy, &n);
+        x_stats_round_trip ();
 
-        if (info != NULL && _head_count >= 1)
+        if (info != NULL && n >= 1)
         {
-            _heads = realloc (_heads, sizeof (_heads[0]) * _head_count);
-
-            if (_heads != NULL)
+            _heads = malloc (sizeof (_heads[0]) * n);
+            if (_heads == NULL)
             {
-                for (i = 0; i < _head_count; i++)
-                {
-                    DB("head %d: %d,%d %dx%d", i,
-                       info[i].x_org, info[i].y_org,
-                       info[i].width, info[i].height);
-
-                    _heads[i] = X11RectMake(info[i].x_org, info[i].y_org,
-                                            info[i].width, info[i].height);
-
-                    if (_screen_region == NULL) {
-                        _screen_region = (X11Region *)malloc(sizeof(X11Region));
-                        if(!_screen_region) {
-                            asl_log(aslc, NULL, ASL_LEVEL_ERR, "Memory allocation error.");
-                            abort();
-                        }
-
-                        pixman_region32_init_rect(_screen_region,
-                                                  info[i].x_org, info[i].y_org,
-                                                  info[i].width, info[i].height);
-                    } else {
-                        pixman_region32_init(&region_temp);
-                        pixman_region32_union_rect(&region_temp, _screen_region,
-                                                   info[i].x_org, info[i].y_org,
-                                                   info[i].width, info[i].height);
-                        pixman_region32_fini(_screen_region);
-                        *_screen_region = region_temp;
-                    }
-                }
+                asl_log(aslc, NULL, ASL_LEVEL_ERR, "Memory allocation error.");
+                abort();
             }
-            else
-                _head_count = 0;
-        }
-        else
-        {
-            if (_heads != NULL)
+
+            for (i = 0; i < n; i++)
             {
-                free (_heads);
-                _heads = NULL;
+                DB("head %d: %d,%d %dx%d", i,
+                   info[i].x_org, info[i].y_org,
+                   info[i].width, info[i].height);
+
+                _heads[i] = X11RectMake(info[i].x_org, info[i].y_org,
+                                        info[i].width, info[i].height);
             }
-            _head_count = 0;
+            _head_count = n;
         }
 
         if (info != NULL)
             XFree (info);
     }
+}
 
-    if (_head_count == 0) {
-        _main_head = X11RectMake(_x, _y, _width, _height);
+/* Rereads the screen's geometry and heads, noting in _geometry_changed
+   which heads were added, removed or resized so that only the windows
+   on them need revalidating. A move of the screen, the main head or
+   the dock sets _geometry_changed_all instead. */
+- (void) update_geometry
+{
+    long data[2];
+    int i, old_x = _x, old_y = _y, old_head_count = _head_count;
+    X11Rect *old_heads = _heads, old_main_head = _main_head;
+    X11Rect old_dock = _usable.dock;
+    x_usable_dock_orientation old_dock_orientation = _usable.dock_orientation;
+    pixman_box32_t *boxes;
+
+    TRACE ();
+
+    x_geometry_updates++;
+
+    if (x_get_property (_root, atoms.native_screen_origin, data, 2, 2))
+    {
+        _x = data[0];
+        _y = data[1];
+    }
+
+    _width = WidthOfScreen (_screen);
+    _height = HeightOfScreen (_screen);
+
+    DB("Screen: %dx%d", _width, _height);
+
+    [self query_heads];
+
+    /* The union of the heads, made in one go */
+    if (_screen_region == NULL) {
         _screen_region = (X11Region *)malloc(sizeof(X11Region));
         if(!_screen_region) {
             asl_log(aslc, NULL, ASL_LEVEL_ERR, "Memory allocation error.");
             abort();
         }
+    } else
+        pixman_region32_fini(_screen_region);
+
+    if (_head_count == 0) {
+        _main_head = X11RectMake(_x, _y, _width, _height);
         pixman_region32_init_rect(_screen_region, _x, _y, _width, _height);
     } else {
         /* find head nearest to native 0,0 */
 
         int nearest_i = -1, nearest_d = INT_MAX;
 
+        boxes = alloca (sizeof (*boxes) * _head_count);
+
         for (i = 0; i < _head_count; i++)
         {
             int dx, dy, d;
 
+            boxes[i].x1 = _heads[i].x;
+            boxes[i].y1 = _heads[i].y;
+            boxes[i].x2 = _heads[i].x + _heads[i].width;
+            boxes[i].y2 = _heads[i].y + _heads[i].height;
+
             dx = _heads[i].x + _x;
             dy = _heads[i].y + _y;
             d = dx * dx + dy * dy;
@@ -247,124 +395,459 @@ - (void) update_geometry
             }
         }
 
+        pixman_region32_init_rects(_screen_region, boxes, _head_count);
+
         assert (nearest_i >= 0);
         _main_head = _heads[nearest_i];
 
         DB("main head has index %d", nearest_i);
     }
+
+    x_usable_area_set_heads (&_usable, _screen_region, _heads, _head_count,
+                             _main_head);
+    [self update_dock];
+
+    if (_x != old_x || _y != old_y
+        || !X11RectEqualToRect (_main_head, old_main_head)
+        || !X11RectEqualToRect (_usable.dock, old_dock)
+        || _usable.dock_orientation != old_dock_orientation)
+    {
+        _geometry_changed_all = YES;
+    }
+    else
+    {
+        x_usable_heads_diff (old_heads, old_head_count, _heads, _head_count,
+                             &_geometry_changed);
+    }
+
+    free (old_heads);
 }
 
-- (void) update_client_list:(x_list *)lst prop:(const char *)name
+#define SCREEN_CHANGE_DELAY 0.1
+#define SCREEN_CHANGE_MAX_DELAY 0.5
+
+/* The root window was resized, or the heads changed. Waits until
+   things have been quiet for SCREEN_CHANGE_DELAY (or the first change
+   is SCREEN_CHANGE_MAX_DELAY old) before doing anything about it. */
+- (void) screen_changed
 {
-    long *ids = NULL;
-    int n_ids, i;
-    x_list *node;
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent ();
+    NSTimeInterval delay = SCREEN_CHANGE_DELAY;
+
+    if (_geometry_timer != nil)
+    {
+        [_geometry_timer invalidate];
+        x_screen_changes_debounced++;
+
+        delay = MIN (delay, _geometry_first_change
+                            + SCREEN_CHANGE_MAX_DELAY - now);
+        if (delay < 0)
+            delay = 0;
+    }
+    else
+        _geometry_first_change = now;
+
+    _geometry_timer = [NSTimer scheduledTimerWithTimeInterval:delay
+                                                       target:self
+                                                     selector:@selector(screen_changed_timer:)
+                                                     userInfo:nil repeats:NO];
+}
+
+- (void) screen_changed_timer:(NSTimer *)timer
+{
+    _geometry_timer = nil;
+
+    [self update_geometry];
+    [self revalidate_windows];
+
+    XFlush (x_dpy);
+}
+
+/* Puts back on the screen the windows that the geometry changes since
+   last time could have left off it. */
+- (void) revalidate_windows
+{
+    x_chain_node *node;
     x_window *w;
+    pixman_box32_t box;
 
-    n_ids = x_list_length (lst);
+    /* Not every dock change is announced, e.g. it grows as apps are
+       launched; whatever was behind it needs checking too. */
+    if ([self update_dock])
+        _geometry_changed_all = YES;
 
-    if (n_ids > 0)
+    for (node = _window_list.head; node != NULL; node = node->next)
     {
-        ids = alloca (sizeof (*ids) * n_ids);
+        w = node->data;
+
+        box.x1 = w->_current_frame.x;
+        box.y1 = w->_current_frame.y;
+        box.x2 = box.x1 + (int) w->_current_frame.width;
+        box.y2 = box.y1 + (int) w->_current_frame.height;
 
-        for (i = 0, node = lst; node != NULL; node = node->next, i++)
+        if (!_geometry_changed_all
+            && pixman_region32_contains_rectangle (&_geometry_changed, &box)
+               == PIXMAN_REGION_OUT)
         {
-            w = node->data;
-            ids[i] = w->_id;
+            x_windows_revalidation_skipped++;
+            continue;
         }
+
+        [w validate_position];
+        x_windows_revalidated++;
+    }
+
+    DB("%s, %lu windows revalidated in all, %lu skipped",
+       _geometry_changed_all ? "everything changed" : "some heads changed",
+       x_windows_revalidated, x_windows_revalidation_skipped);
+
+    _geometry_changed_all = NO;
+    pixman_region32_fini (&_geometry_changed);
+    pixman_region32_init (&_geometry_changed);
+}
+
+unsigned long x_root_list_writes, x_root_list_appends, x_root_list_writes_avoided;
+unsigned long x_decorations_coalesced, x_reshapes_coalesced;
+unsigned long x_geometry_updates, x_screen_changes_debounced;
+unsigned long x_windows_revalidated, x_windows_revalidation_skipped;
+
+static void
+mark_root_list (x_root_list *lst)
+{
+    if (lst->dirty)
+        x_root_list_writes_avoided++;
+
+    lst->dirty = YES;
+}
+
+/* Write IDS to PROP on ROOT, unless that's what it already holds. When
+   IDS only adds to the end of what we wrote last, just append those. */
+static BOOL
+publish_root_list (Window root, Atom prop, x_root_list *lst,
+                   const long *ids, int n_ids)
+{
+    lst->dirty = NO;
+
+    if (lst->published && n_ids == lst->n_ids
+        && memcmp (ids, lst->ids, n_ids * sizeof (long)) == 0)
+    {
+        x_root_list_writes_avoided++;
+        return NO;
+    }
+
+    if (lst->published && n_ids > lst->n_ids
+        && memcmp (ids, lst->ids, lst->n_ids * sizeof (long)) == 0)
+    {
+        XChangeProperty (x_dpy, root, prop, XA_WINDOW, 32, PropModeAppend,
+                         (const unsigned char *) (ids + lst->n_ids),
+                         n_ids - lst->n_ids);
+        x_root_list_appends++;
+    }
+    else
+    {
+        XChangeProperty (x_dpy, root, prop, XA_WINDOW, 32, PropModeReplace,
+                         (const unsigned char *) ids, n_ids);
+        x_root_list_writes++;
+    }
+
+    if (n_ids > lst->size)
+    {
+        lst->size = n_ids * 2;
+        lst->ids = realloc (lst->ids, lst->size * sizeof (long));
+        assert (lst->ids != NULL);
     }
 
-    [self set_root_property:name type:"WINDOW" length:n_ids data:ids];
+    if (n_ids > 0)
+        memcpy (lst->ids, ids, n_ids * sizeof (long));
+    lst->n_ids = n_ids;
+    lst->published = YES;
+
+    return YES;
 }
 
 - (void) update_net_client_list
 {
-    [self update_client_list:_window_list prop:"_NET_CLIENT_LIST"];
+    mark_root_list (&_client_list);
 }
 
 - (void) update_net_client_list_stacking
 {
-    [self update_client_list:_stacking_list prop:"_NET_CLIENT_LIST_STACKING"];
+    mark_root_list (&_client_list_stacking);
 }
 
-static int
-stacking_order_pred (void *item, void *data)
+/* Has W decorated by the next flush_deferred */
+- (void) queue_decorate:(x_window *)w
 {
-    return x_list_find (data, item) != NULL;
+    if (w->_decorate_queued)
+    {
+        x_decorations_coalesced++;
+        return;
+    }
+
+    _decorate_queue = x_list_prepend (_decorate_queue, [w retain]);
+    w->_decorate_queued = YES;
+}
+
+/* Has W's frame reshaped by the next flush_deferred */
+- (void) queue_reshape:(x_window *)w
+{
+    if (w->_reshape_queued)
+    {
+        x_reshapes_coalesced++;
+        return;
+    }
+
+    _reshape_queue = x_list_prepend (_reshape_queue, [w retain]);
+    w->_reshape_queued = YES;
+}
+
+/* Called once per batch of events, and before the run loop sleeps,
+   to write out state changed while handling them. Returns YES if it
+   made any requests. */
+- (BOOL) flush_deferred
+{
+    long *ids;
+    int n_ids, i;
+    x_list *node, *queue;
+    x_chain_node *wnode;
+    x_stack_node *snode;
+    x_window *w;
+    BOOL ret = NO;
+
+    /* Before decorating, which doesn't touch the shape */
+    queue = _reshape_queue;
+    _reshape_queue = NULL;
+
+    for (node = queue; node != NULL; node = node->next)
+    {
+        w = node->data;
+        w->_reshape_queued = NO;
+
+        if (!w->_removed)
+        {
+            [w reshape_now];
+            ret = YES;
+        }
+
+        [w release];
+    }
+
+    x_list_free (queue);
+
+    /* Decorating may queue more, e.g. for transients */
+    while (_decorate_queue != NULL)
+    {
+        queue = _decorate_queue;
+        _decorate_queue = NULL;
+
+        for (node = queue; node != NULL; node = node->next)
+        {
+            w = node->data;
+            w->_decorate_queued = NO;
+
+            if (!w->_removed)
+            {
+                [w decorate_now];
+                ret = YES;
+            }
+
+            [w release];
+        }
+
+        x_list_free (queue);
+    }
+
+    if (_client_list.dirty)
+    {
+        n_ids = _window_list.length;
+        ids = alloca (sizeof (*ids) * (n_ids + 1));
+
+        for (i = 0, wnode = _window_list.head; wnode != NULL; wnode = wnode->next, i++)
+        {
+            w = wnode->data;
+            ids[i] = w->_id;
+        }
+
+        ret |= publish_root_list (_root, atoms.net_client_list,
+                                  &_client_list, ids, n_ids);
+    }
+
+    if (_client_list_stacking.dirty)
+    {
+        n_ids = _stack.length;
+        ids = alloca (sizeof (*ids) * (n_ids + 1));
+
+        /* EWMH wants this bottom to top */
+        for (i = 0, snode = _stack.bottom; snode != NULL; snode = snode->above, i++)
+        {
+            w = snode->data;
+            ids[i] = w->_id;
+        }
+
+        ret |= publish_root_list (_root, atoms.net_client_list_stacking,
+                                  &_client_list_stacking, ids, n_ids);
+    }
+
+    return ret;
 }
 
 - (x_list *) stacking_order:(x_list *)group
 {
-    return x_list_filter (_stacking_list, stacking_order_pred, group);
+    x_list *lst = NULL, *node;
+    x_stack_node *snode;
+    unsigned int stamp;
+    x_window *w;
+
+    stamp = [x_window new_visit_stamp];
+
+    for (node = group; node != NULL; node = node->next)
+    {
+        w = node->data;
+        w->_visit_stamp = stamp;
+    }
+
+    for (snode = _stack.bottom; snode != NULL; snode = snode->above)
+    {
+        w = snode->data;
+        if (w->_visit_stamp == stamp)
+            lst = x_list_prepend (lst, w);
+    }
+
+    return lst;
 }
 
-static int
-window_level_less (const void *a, const void *b)
+static inline int
+window_stack_level (x_window *w)
 {
     static const int phys[AppleWMNumWindowLevels] = {0, 1, 2, -1, -2};
-    const x_window *x = a, *y = b;
 
-    return phys[x->_level] > phys[y->_level];
+    return phys[w->_level];
 }
 
-- (void) raise_windows:(id *)array count:(size_t)n
+static void
+restack_window (x_stack_node *node, x_stack_node *above, void *closure)
 {
-    size_t i, j, seen;
+    x_window *w = node->data;
+    XWindowChanges wc;
+
+    if (above == NULL)
+    {
+        XRaiseWindow (x_dpy, [w toplevel_id]);
+    }
+    else
+    {
+        wc.sibling = [(x_window *) above->data toplevel_id];
+        wc.stack_mode = Below;
+        XConfigureWindow (x_dpy, [w toplevel_id], CWSibling | CWStackMode, &wc);
+    }
+}
+
+/* Sends the whole of _stack to the server, top first */
+static void
+restack_all (x_stack *s)
+{
+    x_stack_node *snode;
     Window *ids;
-    x_list *node;
+    int i;
 
-#ifdef CHECK_WINDOWS
-    [self check_window_lists];
-#endif
+    if (s->top == NULL)
+        return;
 
-    if (n == 0)
+    ids = alloca (sizeof (Window) * s->length);
+
+    for (i = 0, snode = s->top; snode != NULL; snode = snode->below, i++)
+        ids[i] = [(x_window *) snode->data toplevel_id];
+
+    XRaiseWindow (x_dpy, ids[0]);
+    if (i > 1)
+        XRestackWindows (x_dpy, ids, i);
+}
+
+/* Adds W at the top of its level, and moves it there on the server */
+- (void) stack_window:(x_window *)w
+{
+    x_stack_insert (&_stack, &w->_stack_node, window_stack_level (w), YES);
+    restack_window (&w->_stack_node, w->_stack_node.above, NULL);
+}
+
+/* Moves W to the top of its level, which may have changed, on the
+   server too. For after its frame was recreated, since the new frame
+   starts out on top of everything. */
+- (void) restack_window:(x_window *)w
+{
+    if (!w->_stack_node.stacked)
         return;
 
-    /* 1. Move all windows being raised to the head of the stacking list. */
+    x_stack_remove (&_stack, &w->_stack_node);
+    [self stack_window:w];
 
-    for (i = n - 1; ; i--)
-    {
-        _stacking_list = x_list_remove (_stacking_list, array[i]);
-        _stacking_list = x_list_prepend (_stacking_list, array[i]);
+    [self update_net_client_list_stacking];
+}
 
-        if(i == 0)
-            break;
-    }
+/* Moves W to the bottom of its level, on the server too */
+- (void) lower_window:(x_window *)w
+{
+    x_stack_node *node = &w->_stack_node;
 
-    /* 2. Sort the new stacking list by window level. */
+    if (!node->stacked)
+        return;
 
-    _stacking_list = x_list_sort (_stacking_list, window_level_less);
+    x_stack_remove (&_stack, node);
+    x_stack_insert (&_stack, node, window_stack_level (w), NO);
+    restack_window (node, node->above, NULL);
 
-    /* 3. Scan the resulting list for each of the raised windows (ugh),
-     raising each below their predecessor. Luckily we'll only ever
-     have a small N here. However, we also have to raise all the
-     other windows down to the bottommost changed window, to be sure
-     that X actually moves the ones we moved to where we want.. */
+    [self update_net_client_list_stacking];
+}
 
-    ids = alloca (sizeof (Window) * x_list_length (_stacking_list));
-    seen = 0;
+/* Something restacked windows without going through _stack, so the
+   server's order can't be relied on to match it any more. The next
+   raise sends the whole order. */
+- (void) invalidate_stack
+{
+    _stack_diverged = YES;
+}
 
-    for (i = 0, node = _stacking_list;
-         seen < n && node != NULL; i++, node = node->next)
+- (void) raise_windows:(id *)array count:(size_t)n
+{
+    x_stack_node **nodes;
+    int *levels;
+    size_t i;
+
+#ifdef CHECK_WINDOWS
+    [self check_window_lists];
+#endif
+
+    if (n == 0)
+        return;
+
+    nodes = alloca (sizeof (*nodes) * n);
+    levels = alloca (sizeof (*levels) * n);
+
+    for (i = 0; i < n; i++)
     {
-        x_window *w = node->data;
+        x_window *w = array[i];
 
-        ids[i] = [w toplevel_id];
+        if (!w->_stack_node.stacked)
+            [self stack_window:w];
 
-        for (j = 0; j < n; j++)
-        {
-            if (node->data == array[j])
-            {
-                seen++;
-                break;
-            }
-        }
+        nodes[i] = &w->_stack_node;
+        levels[i] = window_stack_level (w);
     }
 
-    if(_stacking_list != NULL)
-        XRaiseWindow (x_dpy, ids[0]);
-	if (i > 1)
-	    XRestackWindows (x_dpy, ids, i);
+    /* Only the windows whose neighbours changed get restacked, each
+       directly below the window now above it. That relies on the
+       server's order matching ours; when it may not, send it all. */
+
+    if (!_stack_diverged)
+    {
+        x_stack_raise (&_stack, nodes, levels, n, restack_window, NULL);
+    }
+    else
+    {
+        x_stack_raise (&_stack, nodes, levels, n, NULL, NULL);
+        restack_all (&_stack);
+        _stack_diverged = NO;
+    }
 
     [self update_net_client_list_stacking];
 }
@@ -383,13 +866,30 @@ - (void) raise_windows:(id *)array count:(size_t)n
     _colormap = DefaultColormapOfScreen (_screen);
     _black_pixel = BlackPixelOfScreen (_screen);
 
+    _window_index = x_hash_table_new ();
+    _osx_index = x_hash_table_new ();
+    _group_index = x_hash_table_new ();
+    x_chain_init (&_window_list);
+    x_stack_init (&_stack);
+    x_grid_init (&_grid);
+    x_usable_area_init (&_usable);
+    pixman_region32_init (&_geometry_changed);
+
     [self update_geometry];
+    [self revalidate_windows];
 
     DB("%d, %dx%dx%d, root:%lx, %d heads",
        xscreen_id, _width, _height, _depth, _root, _head_count);
 
     XSelectInput (x_dpy, _root, X_ROOT_WINDOW_EVENTS);
 
+    /* The monitors can change without the root window being resized */
+    if (x_have_randr_monitors)
+    {
+        XRRSelectInput (x_dpy, _root, RRScreenChangeNotifyMask
+                        | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+    }
+
     [self net_wm_init];
 
     return self;
@@ -397,14 +897,34 @@ - (void) raise_windows:(id *)array count:(size_t)n
 
 - (void) dealloc
 {
-    if (_head_count > 0)
-        free (_heads);
+    x_list *node;
+
+    free (_heads);
 
     if(_screen_region != NULL) {
         pixman_region32_fini(_screen_region);
         free(_screen_region);
     }
 
+    x_hash_table_free (_window_index);
+    x_hash_table_free (_osx_index);
+    x_hash_table_free (_group_index);
+    x_grid_free (&_grid);
+    x_usable_area_fini (&_usable);
+    pixman_region32_fini (&_geometry_changed);
+    [_geometry_timer invalidate];
+
+    free (_client_list.ids);
+    free (_client_list_stacking.ids);
+
+    for (node = _decorate_queue; node != NULL; node = node->next)
+        [(x_window *) node->data release];
+    x_list_free (_decorate_queue);
+
+    for (node = _reshape_queue; node != NULL; node = node->next)
+        [(x_window *) node->data release];
+    x_list_free (_reshape_queue);
+
     [super dealloc];
 }
 
@@ -423,31 +943,31 @@ - (void) net_wm_init
 
         data = _net_wm_window;
 
-        [self set_property:_net_wm_window name:"_NET_SUPPORTING_WM_CHECK"
-                      type:"WINDOW" length:1 data:&data];
-        [self set_root_property:"_NET_SUPPORTING_WM_CHECK"
-                           type:"WINDOW" length:1 data:&data];
+        [self set_property:_net_wm_window name:atoms.net_supporting_wm_check
+                      type:XA_WINDOW length:1 data:&data];
+        [self set_root_property:atoms.net_supporting_wm_check
+                           type:XA_WINDOW length:1 data:&data];
 
         n = sizeof (net_wm_supported) / sizeof (net_wm_supported[0]);
         supported_atoms = alloca (n * sizeof (long));
 
         for (i = 0; i < n; i++)
-            supported_atoms[i] = XInternAtom (x_dpy, net_wm_supported[i], False);
+            supported_atoms[i] = *net_wm_supported[i];
 
-        [self set_root_property:"_NET_SUPPORTED"
-                           type:"ATOM" length:n data:supported_atoms];
+        [self set_root_property:atoms.net_supported
+                           type:XA_ATOM length:n data:supported_atoms];
     }
 }
 
 - (void) focus_topmost:(Time)timestamp
 {
     x_window *w;
-    x_list *sl;
+    x_stack_node *sn;
     CGError err;
     xp_bool isVisible;
 
-    for(sl = _stacking_list; sl; sl = sl->next) {
-        w = sl->data;
+    for(sn = _stack.top; sn; sn = sn->below) {
+        w = sn->data;
         err = qwm_dock_is_window_visible([w get_osx_id], &isVisible);
         if(!err && isVisible) {
             [w focus:timestamp];
@@ -462,11 +982,22 @@ - (void) adopt_window:(Window)xwindow_id initializing:(BOOL)flag
 
     DB("id: %lx initializing: %s", xwindow_id, flag ? "YES" : "NO");
 
+    if (!flag)
+    {
+        /* Select for changes before reading anything, so nothing can slip
+           in between the prefetch and the window being set up. */
+        XSelectInput (x_dpy, xwindow_id, X_CLIENT_WINDOW_EVENTS);
+        prefetch_for_adoption (&xwindow_id, 1);
+    }
+
     w = [[x_window alloc] init_with_id:xwindow_id screen:self initializing:flag];
 
     /* Need to preserve oldest-first order. */
-    _window_list = x_list_append (_window_list, w);
-    _stacking_list = x_list_append (_stacking_list, w);
+    x_chain_append (&_window_list, &w->_window_node);
+    if (!w->_stack_node.stacked)
+        [self stack_window:w];
+    x_grid_insert (&_grid, &w->_grid_item, w->_current_frame);
+    [self index_window:w id:w->_id role:X_WINDOW_ROLE_CLIENT];
 
     if (!flag)
         [self update_net_client_list];
@@ -498,7 +1029,8 @@ - (void) remove_window:(x_window *)w safe:(BOOL)safe
     }
     else if (!w->_deleted)
     {
-        _stacking_list = x_list_remove (_stacking_list, w);
+        x_stack_remove (&_stack, &w->_stack_node);
+        x_grid_remove (&_grid, &w->_grid_item);
 
         w->_removed = YES;
         [w reparent_out];
@@ -513,7 +1045,15 @@ - (void) remove_window:(x_window *)w safe:(BOOL)safe
          removing it, we want to have it in the list when exiting, so
          that its dock icon can be removed it necessary. */
 
-        _window_list = x_list_remove (_window_list, w);
+        x_chain_remove (&_window_list, &w->_window_node);
+        [self unindex_window:w->_id];
+        [self ungroup_window:w];
+        x_window_cache_forget (w->_id);
+        if (w->_osx_id != XP_NULL_NATIVE_WINDOW_ID
+            && x_hash_table_lookup (_osx_index, w->_osx_id, NULL) == w)
+        {
+            [self unindex_osx_id:w->_osx_id];
+        }
         w->_deleted = YES;
         [w release];
 
@@ -543,8 +1083,9 @@ - (void) window_hidden:(x_window *)w
 {
     if (!w->_removed)
     {
-        _stacking_list = x_list_remove (_stacking_list, w);
-        _stacking_list = x_list_append (_stacking_list, w);
+        /* Move it to the bottom of its level, on the server too, so the
+           two orders stay the same for raise_windows:count:. */
+        [self lower_window:w];
 
         if (w->_focused)
             [self focus_topmost:CurrentTime];
@@ -554,26 +1095,45 @@ - (void) window_hidden:(x_window *)w
 - (void) adopt_windows
 {
     Window root, parent, *children;
-    unsigned n_children, i;
+    unsigned n_children, n_adoptable, i;
+    CFAbsoluteTime start;
+
+    start = CFAbsoluteTimeGetCurrent ();
 
     x_grab_server (True);
 
     n_children = 0;
+    x_stats_round_trip ();
     XQueryTree (x_dpy, _root, &root, &parent, &children, &n_children);
 
+    /* Three round trips whatever the number of windows: the tree, the
+       attributes deciding what to adopt, then everything adopting needs. */
+
+    x_prefetch_windows (children, n_children, True, NULL, 0);
+
+    n_adoptable = 0;
     for (i = 0; i < n_children; i++)
     {
         if (adoptable (children[i]))
-        {
-            [self adopt_window:children[i] initializing:YES];
-        }
+            children[n_adoptable++] = children[i];
+        else
+            x_window_cache_forget (children[i]);
     }
 
+    prefetch_for_adoption (children, n_adoptable);
+
+    for (i = 0; i < n_adoptable; i++)
+        [self adopt_window:children[i] initializing:YES];
+
     if (n_children > 0)
         XFree (children);
 
     x_ungrab_server ();
 
+    asl_log (aslc, NULL, ASL_LEVEL_INFO, "screen %d: adopted %u of %u windows in %.1fms",
+             _id, n_adoptable, n_children,
+             (CFAbsoluteTimeGetCurrent () - start) * 1000.0);
+
     [self update_net_client_list];
 
     if (default_cursor == 0)
@@ -584,25 +1144,23 @@ - (void) adopt_windows
 
 - (void) unadopt_windows
 {
-    x_list *copy, *node;
-
-    copy = x_list_copy (_window_list);
+    x_chain_node *node, *next;
 
-    for (node = copy; node != NULL; node = node->next)
+    /* Removing a window only unlinks its own node */
+    for (node = _window_list.head; node != NULL; node = next)
     {
         x_window *w = node->data;
 
+        next = node->next;
         [self remove_window:w];
     }
-
-    x_list_free (copy);
 }
 
 - (void) error_shutdown
 {
-    x_list *node;
+    x_chain_node *node;
 
-    for (node = _window_list; node != NULL; node = node->next)
+    for (node = _window_list.head; node != NULL; node = node->next)
     {
         x_window *w = node->data;
 
@@ -610,195 +1168,144 @@ - (void) error_shutdown
     }
 }
 
-- get_window:(Window)xwindow_id
+- (void) index_window:(x_window *)w id:(Window)xwindow_id role:(x_window_role)role
 {
-    x_list *node;
+    x_hash_table_insert (_window_index, xwindow_id, w, role);
+}
 
-    for (node = _window_list; node != NULL; node = node->next)
-    {
-        x_window *w = node->data;
+- (void) unindex_window:(Window)xwindow_id
+{
+    x_hash_table_remove (_window_index, xwindow_id);
+}
 
-        if (w->_id == xwindow_id)
-            return w;
+- get_window:(Window)xwindow_id role:(x_window_role *)role_ret
+{
+    x_window *w;
+    int role;
 
-        if (!w->_deleted && (w->_frame_id == xwindow_id
-                             || w->_tracking_id == xwindow_id
-                             || w->_growbox_id == xwindow_id))
-        {
-            return w;
-        }
-    }
+    w = x_hash_table_lookup (_window_index, xwindow_id, &role);
+
+    if (w != nil && role_ret != NULL)
+        *role_ret = role;
 
-    return nil;
+    return w;
 }
 
+- get_window:(Window)xwindow_id
+{
+    return [self get_window:xwindow_id role:NULL];
+}
+
+- (void) index_window:(x_window *)w osx_id:(xp_native_window_id)wid
+{
+    x_hash_table_insert (_osx_index, wid, w, 0);
+}
+
+- (void) unindex_osx_id:(xp_native_window_id)wid
+{
+    x_hash_table_remove (_osx_index, wid);
+}
+
+/* Frames report their native id by PropertyNotify, so the index is
+   all there is to look at */
 - get_window_by_osx_id:(xp_native_window_id)osxwindow_id
 {
-    x_list *node;
+    return x_hash_table_lookup (_osx_index, osxwindow_id, NULL);
+}
 
-    for (node = _window_list; node != NULL; node = node->next)
-    {
-        x_window *w = node->data;
-        xp_native_window_id wid;
+- (void) group_window:(x_window *)w
+{
+    x_list *members;
 
-        if (w->_deleted)
-            continue;
+    if (w->_grouped)
+        return;
 
-        wid = [w get_osx_id];
-        if (osxwindow_id == wid)
-            return w;
-    }
+    members = x_hash_table_lookup (_group_index, w->_group_id, NULL);
+    members = x_list_prepend (members, w);
+    x_hash_table_insert (_group_index, w->_group_id, members, 0);
 
-    return nil;
+    w->_grouped = YES;
 }
 
-- (X11Rect) validate_window_position:(X11Rect)win_rect titlebar_height:(size_t)titlebar_height {
-    X11Region tem;
-    X11Region win_int, title_int;
-    X11Region win_region, title_region, dock_region;
-    X11Region screen_region_no_dock;
-    X11Rect title_rect, title_int_rect;
-    X11Rect ret, dock_rect;
-    pixman_box32_t *e;
-    xp_box dock_box;
+- (void) ungroup_window:(x_window *)w
+{
+    x_list *members;
 
-    TRACE();
+    if (!w->_grouped)
+        return;
 
-    // Figure out where the dock is to handle
-    // <rdar://problem/7595340> X11 window can get lost under the dock
-    // http://xquartz.macosforge.org/trac/ticket/329
-    dock_box = qwm_dock_get_rect();
-    dock_rect = [self CGToX11Rect:CGRectMake(dock_box.x1, dock_box.y1,
-                                             dock_box.x2 - dock_box.x1,
-                                             dock_box.y2 - dock_box.y1)];
+    members = x_hash_table_lookup (_group_index, w->_group_id, NULL);
+    members = x_list_remove (members, w);
 
-    ret = title_rect = win_rect;
-    title_rect.height = titlebar_height;
-
-    // make a region of just the dock, window, and titlebar
-    pixman_region32_init_rect(&dock_region, dock_rect.x, dock_rect.y,
-                              dock_rect.width, dock_rect.height);
-    pixman_region32_init_rect(&win_region, win_rect.x, win_rect.y,
-                              win_rect.width, win_rect.height);
-    pixman_region32_init_rect(&title_region, title_rect.x, title_rect.y,
-                              title_rect.width, title_rect.height);
-
-    // Make a region of our screen without the dock
-    pixman_region32_init(&screen_region_no_dock);
-    pixman_region32_init(&tem);
-    // This should always be dock_region, but we're being careful
-    pixman_region32_intersect(&tem, _screen_region, &dock_region);
-    pixman_region32_subtract(&screen_region_no_dock, _screen_region, &tem);
-    pixman_region32_fini(&tem);
-
-    // Make win_int the region of our window that is on our display and not
-    // in the dock
-    pixman_region32_init(&win_int);
-    pixman_region32_intersect(&win_int, &screen_region_no_dock, &win_region);
-
-    // Make title_int the region of our titlebar that is on our display and not
-    // in the dock
-    pixman_region32_init(&title_int);
-    pixman_region32_intersect(&title_int, &screen_region_no_dock, &title_region);
-
-    // Get a rect of the bounding box for the internal titlebar.
-    e = pixman_region32_extents(&title_int);
-    title_int_rect = X11RectMake(e->x1, e->y1, e->x2 - e->x1, e->y2 - e->y1);
-    pixman_region32_fini(&title_int);
-
-    DB("        win_rect: %d,%d %dx%d", win_rect.x, win_rect.y, win_rect.width, win_rect.height);
-    DB("        dock_rect: %d,%d %dx%d", dock_rect.x, dock_rect.y, dock_rect.width, dock_rect.height);
-    e = pixman_region32_extents(_screen_region);
-    DB("        screen_rect: %d,%d %dx%d", e->x1, e->y1, e->x2 - e->x1, e->y2 - e->y1);
-    e = pixman_region32_extents(&screen_region_no_dock);
-    DB("        screen_no_dock: %d,%d %dx%d", e->x1, e->y1, e->x2 - e->x1, e->y2 - e->y1);
-    DB("        title_rect: %d,%d %dx%d", title_rect.x, title_rect.y, title_rect.width, title_rect.height);
-    DB("        title_int_rect: %d,%d %dx%d", title_int_rect.x, title_int_rect.y, title_int_rect.width, title_int_rect.height);
-    e = pixman_region32_extents(&win_int);
-    DB("        win_int_rect: %d,%d %dx%d", e->x1, e->y1, e->x2 - e->x1, e->y2 - e->y1);
-
-    // Done with our screen_region_no_dock
-    pixman_region32_fini(&screen_region_no_dock);
-
-    if (!pixman_region32_not_empty(&win_int)) {
-        X11Region win_dock_int;
-
-        /* Check if we're behind the dock or offscreen */
-        pixman_region32_init(&win_dock_int);
-        pixman_region32_intersect(&win_dock_int, _screen_region, &win_region);
-
-        if(!pixman_region32_not_empty(&win_dock_int) || titlebar_height == 0) {
-            /* Window wouldn't be on any display, so put it at top-left of
-             * the main head.
-             */
-            ret.y = _main_head.y;
-        } else {
-            /* Window is partially behind our dock. */
-            switch(qwm_dock_get_orientation()) {
-                case XP_DOCK_ORIENTATION_BOTTOM:
-                    ret.y = dock_rect.y - titlebar_height;
-                    break;
-                case XP_DOCK_ORIENTATION_LEFT:
-                    ret.x = dock_rect.x + dock_rect.width - ret.width + 40;
-                    break;
-                case XP_DOCK_ORIENTATION_RIGHT:
-                    ret.x = dock_rect.x - 40;
-                    break;
-                default:
-                    asl_log(aslc, NULL, ASL_LEVEL_WARNING, "Invalid response from qwm_dock_get_orientation()");
-                    break;
-            }
-        }
-        pixman_region32_fini(&win_dock_int);
+    if (members != NULL)
+        x_hash_table_insert (_group_index, w->_group_id, members, 0);
+    else
+        x_hash_table_remove (_group_index, w->_group_id);
 
-        /* Try to preserve X position */
-        pixman_region32_init(&tem);
-        pixman_region32_intersect(&tem, _screen_region, &title_region);
+    w->_grouped = NO;
+}
 
-        if (!pixman_region32_not_empty(&tem)) {
-            ret.x = _main_head.x;
-            ret.y = _main_head.y;
-        }
+/* The returned list belongs to the screen */
+- (x_list *) group_members:(Window)group_id
+{
+    return x_hash_table_lookup (_group_index, group_id, NULL);
+}
 
-        pixman_region32_fini(&tem);
-    } else if(title_int_rect.height < titlebar_height) {
-        // The titlebar needs to have its full height on-screen
-        int i;
+- (X11Rect) validate_window_position:(X11Rect)win_rect titlebar_height:(size_t)titlebar_height {
+    X11Rect ret;
 
-        for (i = 0; i < _head_count; i++) {
-            X11Rect dpy_rect, intersection;
-            int dock_bottom_height = 0;
+    ret = x_usable_area_validate (&_usable, win_rect, (int) titlebar_height);
 
-            dpy_rect = _heads[i];
+    if (!X11RectEqualToRect (ret, win_rect))
+    {
+        DB("win_rect: %d,%d %dx%d -> %d,%d", win_rect.x, win_rect.y,
+           win_rect.width, win_rect.height, ret.x, ret.y);
+    }
 
-            if(qwm_dock_get_orientation() == XP_DOCK_ORIENTATION_BOTTOM &&
-               X11RectContainsPoint(dpy_rect, X11PointMake(dock_rect.x, dock_rect.y)))
-                dock_bottom_height = dock_rect.height;
+    return ret;
+}
 
-            /* Does it touch this display? */
-            intersection = X11RectIntersection(win_rect, dpy_rect);
-            if(X11RectIsEmpty(intersection))
-                continue;
+/* Called when the dock may have moved. Asks it where it is, which is
+ * cheap, and works the usable area out again if it moved, returning
+ * YES if it did. Handles
+ * <rdar://problem/7595340> X11 window can get lost under the dock
+ * http://xquartz.macosforge.org/trac/ticket/329
+ */
+- (BOOL) update_dock
+{
+    xp_box dock_box;
+    X11Rect dock_rect;
+    x_usable_dock_orientation orientation;
 
-            if (ret.y < dpy_rect.y) {
-                ret.y = dpy_rect.y;
-                break;
-            }
+    dock_box = qwm_dock_get_rect();
+    dock_rect = [self CGToX11Rect:CGRectMake(dock_box.x1, dock_box.y1,
+                                             dock_box.x2 - dock_box.x1,
+                                             dock_box.y2 - dock_box.y1)];
 
-            if (ret.y + title_rect.height > dpy_rect.y + dpy_rect.height - dock_bottom_height) {
-                ret.y = (dpy_rect.y + dpy_rect.height - title_rect.height - dock_bottom_height);
-                break;
-            }
-        }
+    switch(qwm_dock_get_orientation()) {
+        case XP_DOCK_ORIENTATION_BOTTOM:
+            orientation = X_USABLE_DOCK_BOTTOM;
+            break;
+        case XP_DOCK_ORIENTATION_LEFT:
+            orientation = X_USABLE_DOCK_LEFT;
+            break;
+        case XP_DOCK_ORIENTATION_RIGHT:
+            orientation = X_USABLE_DOCK_RIGHT;
+            break;
+        default:
+            DB("Invalid response from qwm_dock_get_orientation()");
+            orientation = X_USABLE_DOCK_NONE;
+            break;
     }
 
-    pixman_region32_fini(&win_int);
-    pixman_region32_fini(&win_region);
-    pixman_region32_fini(&title_region);
-    pixman_region32_fini(&dock_region);
+    if (X11RectEqualToRect (dock_rect, _usable.dock)
+        && orientation == _usable.dock_orientation)
+        return NO;
 
-    DB("        ret: %d,%d %dx%d", ret.x, ret.y, ret.width, ret.height);
-    return ret;
+    DB("dock_rect: %d,%d %dx%d", dock_rect.x, dock_rect.y, dock_rect.width, dock_rect.height);
+
+    x_usable_area_set_dock (&_usable, dock_rect, orientation);
+    return YES;
 }
 
 - (X11Rect) head_containing_point:(X11Point)p
@@ -920,26 +1427,37 @@ - (void) reenable_update
 
 - (void) raise_all
 {
-    x_list *node;
-    Window *ids;
+    x_chain_node *node;
+    x_stack_node **nodes;
+    int *levels;
     int id_count, i;
 
-    id_count = x_list_length (_window_list);
-    ids = alloca (id_count * sizeof (Window));
+    id_count = _window_list.length;
+    nodes = alloca (id_count * sizeof (*nodes));
+    levels = alloca (id_count * sizeof (*levels));
 
-    for (i = 0, node = _window_list; node != NULL; node = node->next)
+    for (i = 0, node = _window_list.head; node != NULL; node = node->next)
     {
         x_window *w = node->data;
 
-        if (!w->_deleted && i < id_count)
-            ids[i++] = [w toplevel_id];
+        if (!w->_deleted && w->_stack_node.stacked && i < id_count)
+        {
+            nodes[i] = &w->_stack_node;
+            levels[i] = window_stack_level (w);
+            i++;
+        }
     }
 
+    /* Rebuild _stack in list order, within each level, and send all
+       of it, so it matches the server again. */
+
     if (i > 0)
     {
-        XRaiseWindow (x_dpy, ids[0]);
-        if (i > 1)
-            XRestackWindows (x_dpy, ids, i);
+        x_stack_raise (&_stack, nodes, levels, i, NULL, NULL);
+        restack_all (&_stack);
+        _stack_diverged = NO;
+
+        [self update_net_client_list_stacking];
     }
 }
 
@@ -958,10 +1476,10 @@ - (void) show_all:(BOOL)flag
 
 - (void) foreach_window:(SEL)selector
 {
-    x_list *node;
+    x_chain_node *node;
     x_window *w;
 
-    for (node = _window_list; node != NULL; node = node->next)
+    for (node = _window_list.head; node != NULL; node = node->next)
     {
         w = node->data;
         [w performSelector:selector];
@@ -970,23 +1488,51 @@ - (void) foreach_window:(SEL)selector
 
 - (id) find_window_at:(X11Point)p slop:(int)epsilon
 {
-    int epsilon_squared = epsilon * epsilon;
-    x_list *node;
-    x_window *w;
-    int dx, dy;
+    return x_grid_find_origin (&_grid, p, epsilon);
+}
+
+/* Finds where on the screen r would be least covered by other windows,
+   trying the work area of the main head first. Returns r moved there,
+   and shrunk if it doesn't fit. */
+- (X11Rect) least_overlapped_rect:(X11Rect)r
+{
+    X11Rect area, best_area;
+    X11Point p, best;
+    unsigned long overlap, best_overlap;
+    int i;
+
+    best_area = [self zoomed_rect];
+    best = x_grid_least_covered (&_grid, best_area, r.width, r.height,
+                                 &best_overlap);
 
-    for (node = _window_list; node != NULL; node = node->next)
+    for (i = 0; i < _head_count && best_overlap > 0; i++)
     {
-        w = node->data;
+        if (X11RectEqualToRect (_heads[i], _main_head))
+            continue;
 
-        dx = p.x - w->_current_frame.x;
-        dy = p.y - w->_current_frame.y;
+        area = [self zoomed_rect:X11RectOrigin (_heads[i])];
+        p = x_grid_least_covered (&_grid, area, r.width, r.height, &overlap);
 
-        if (dx * dx + dy * dy <= epsilon_squared)
-            return w;
+        if (overlap < best_overlap)
+        {
+            best = p;
+            best_area = area;
+            best_overlap = overlap;
+        }
     }
 
-    return nil;
+    DB("r:(%d,%d %dx%d) -> (%d,%d) overlap: %lu",
+       r.x, r.y, r.width, r.height, best.x, best.y, best_overlap);
+
+    r.x = best.x;
+    r.y = best.y;
+
+    if (r.width > best_area.width)
+        r.width = best_area.width;
+    if (r.height > best_area.height)
+        r.height = best_area.height;
+
+    return r;
 }
 
 /* OK, This is straight up hell for incompatible coordinate systems.
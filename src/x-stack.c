@@ -0,0 +1,239 @@
+/* x-stack.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-stack.h"
+#include <stddef.h>
+#include <assert.h>
+
+#define BAND(l) ((l) - X_STACK_MIN_LEVEL)
+
+X_EXTERN void
+X_PFX (stack_init) (x_stack *s)
+{
+    int i;
+
+    s->top = s->bottom = NULL;
+    for (i = 0; i < X_STACK_LEVELS; i++)
+        s->level_top[i] = s->level_bottom[i] = NULL;
+    s->length = 0;
+}
+
+X_EXTERN void
+X_PFX (stack_node_init) (x_stack_node *node, void *data)
+{
+    node->above = node->below = NULL;
+    node->data = data;
+    node->level = 0;
+    node->stacked = 0;
+    node->raising = 0;
+    node->restacked = 0;
+    node->old_above = NULL;
+}
+
+/* The lowest node of any band above LEVEL, or NULL if they're all
+   empty. A node at the top of LEVEL's band goes directly below it. */
+static x_stack_node *
+node_above_band (x_stack *s, int level)
+{
+    int l;
+
+    for (l = level + 1; l <= X_STACK_MAX_LEVEL; l++)
+    {
+        if (s->level_bottom[BAND (l)] != NULL)
+            return s->level_bottom[BAND (l)];
+    }
+
+    return NULL;
+}
+
+static void
+link_below (x_stack *s, x_stack_node *node, x_stack_node *above)
+{
+    x_stack_node *below = above != NULL ? above->below : s->top;
+
+    node->above = above;
+    node->below = below;
+
+    if (above != NULL)
+        above->below = node;
+    else
+        s->top = node;
+
+    if (below != NULL)
+        below->above = node;
+    else
+        s->bottom = node;
+}
+
+static void
+unlink_node (x_stack *s, x_stack_node *node)
+{
+    int b = BAND (node->level);
+
+    if (s->level_top[b] == node)
+    {
+        s->level_top[b] = (node->below != NULL
+                           && node->below->level == node->level)
+                          ? node->below : NULL;
+    }
+    if (s->level_bottom[b] == node)
+    {
+        s->level_bottom[b] = (node->above != NULL
+                              && node->above->level == node->level)
+                             ? node->above : NULL;
+    }
+
+    if (node->above != NULL)
+        node->above->below = node->below;
+    else
+        s->top = node->below;
+
+    if (node->below != NULL)
+        node->below->above = node->above;
+    else
+        s->bottom = node->above;
+
+    node->above = node->below = NULL;
+}
+
+static void
+link_at_top (x_stack *s, x_stack_node *node, int level)
+{
+    int b = BAND (level);
+
+    node->level = level;
+    link_below (s, node, node_above_band (s, level));
+
+    s->level_top[b] = node;
+    if (s->level_bottom[b] == NULL)
+        s->level_bottom[b] = node;
+}
+
+static void
+link_at_bottom (x_stack *s, x_stack_node *node, int level)
+{
+    int b = BAND (level);
+
+    node->level = level;
+    link_below (s, node, (s->level_bottom[b] != NULL
+                          ? s->level_bottom[b]
+                          : node_above_band (s, level)));
+
+    s->level_bottom[b] = node;
+    if (s->level_top[b] == NULL)
+        s->level_top[b] = node;
+}
+
+X_EXTERN void
+X_PFX (stack_insert) (x_stack *s, x_stack_node *node, int level, int at_top)
+{
+    assert (!node->stacked);
+    assert (level >= X_STACK_MIN_LEVEL && level <= X_STACK_MAX_LEVEL);
+
+    if (at_top)
+        link_at_top (s, node, level);
+    else
+        link_at_bottom (s, node, level);
+
+    node->stacked = 1;
+    s->length++;
+}
+
+X_EXTERN void
+X_PFX (stack_remove) (x_stack *s, x_stack_node *node)
+{
+    if (!node->stacked)
+        return;
+
+    unlink_node (s, node);
+
+    node->stacked = 0;
+    s->length--;
+}
+
+X_EXTERN unsigned int
+X_PFX (stack_raise) (x_stack *s, x_stack_node **nodes, const int *levels,
+                     unsigned int n, x_stack_restack_fun *fun, void *closure)
+{
+    x_stack_node *node;
+    unsigned int i, n_ops = 0;
+    int l;
+
+    if (n == 0)
+        return 0;
+
+    for (i = 0; i < n; i++)
+    {
+        assert (nodes[i]->stacked);
+        nodes[i]->old_above = nodes[i]->above;
+    }
+
+    for (i = n; i > 0; i--)
+    {
+        node = nodes[i - 1];
+        assert (levels[i - 1] >= X_STACK_MIN_LEVEL
+                && levels[i - 1] <= X_STACK_MAX_LEVEL);
+
+        unlink_node (s, node);
+        link_at_top (s, node, levels[i - 1]);
+        node->raising = 1;
+    }
+
+    /* The raised nodes now sit at the top of their bands. Assuming the
+       server's order matched ours before, the nodes we didn't move are
+       still in the right order relative to each other, so working from
+       the top down, each raised node only needs moving if the node now
+       above it isn't the one that was above it before, or that one had
+       to move itself. */
+
+    for (l = X_STACK_MAX_LEVEL; l >= X_STACK_MIN_LEVEL; l--)
+    {
+        for (node = s->level_top[BAND (l)];
+             node != NULL && node->level == l && node->raising;
+             node = node->below)
+        {
+            if (node->above != node->old_above
+                || (node->above != NULL && node->above->restacked))
+            {
+                node->restacked = 1;
+                if (fun != NULL)
+                    fun (node, node->above, closure);
+                n_ops++;
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        nodes[i]->raising = 0;
+        nodes[i]->restacked = 0;
+        nodes[i]->old_above = NULL;
+    }
+
+    return n_ops;
+}
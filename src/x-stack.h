@@ -0,0 +1,90 @@
+/* x-stack.h -- window stacking order, banded by level
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef X_STACK_H
+#define X_STACK_H 1
+
+/* A stack of nodes, topmost first, kept sorted into bands by level
+   (higher levels nearer the top). Nodes are embedded in the objects
+   they stack, so moving one is O(1) and never allocates. */
+
+#define X_STACK_MIN_LEVEL (-2)
+#define X_STACK_MAX_LEVEL 2
+#define X_STACK_LEVELS (X_STACK_MAX_LEVEL - X_STACK_MIN_LEVEL + 1)
+
+typedef struct x_stack_node_struct x_stack_node;
+
+struct x_stack_node_struct {
+    x_stack_node *above, *below;
+    void *data;
+    int level;
+    unsigned stacked :1;
+
+    /* Used while raising */
+    unsigned raising :1;
+    unsigned restacked :1;
+    x_stack_node *old_above;
+};
+
+typedef struct x_stack_struct x_stack;
+
+struct x_stack_struct {
+    x_stack_node *top, *bottom;
+    x_stack_node *level_top[X_STACK_LEVELS];
+    x_stack_node *level_bottom[X_STACK_LEVELS];
+    unsigned int length;
+};
+
+/* Called for each node that has to be moved on the server, in top to
+   bottom order, to put it directly below ABOVE (or at the very top if
+   ABOVE is NULL). */
+typedef void (x_stack_restack_fun) (x_stack_node *node, x_stack_node *above,
+                                    void *closure);
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+X_EXTERN void X_PFX (stack_init) (x_stack *s);
+X_EXTERN void X_PFX (stack_node_init) (x_stack_node *node, void *data);
+
+/* Adds NODE at the top or bottom of the band for LEVEL. */
+X_EXTERN void X_PFX (stack_insert) (x_stack *s, x_stack_node *node,
+                                    int level, int at_top);
+X_EXTERN void X_PFX (stack_remove) (x_stack *s, x_stack_node *node);
+
+/* Moves each NODES[i] to the top of the band for LEVELS[i], NODES[0]
+   ending up highest, then calls FUN for the nodes whose position
+   relative to the rest of the stack actually changed. Returns the
+   number of calls made. */
+X_EXTERN unsigned int X_PFX (stack_raise) (x_stack *s, x_stack_node **nodes,
+                                           const int *levels, unsigned int n,
+                                           x_stack_restack_fun *fun,
+                                           void *closure);
+
+#endif /* X_STACK_H */
@@ -0,0 +1,218 @@
+/* x-stats.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#define MAX_DEPTH 8
+
+static x_stats_slot slots[X_STATS_MAX_SLOTS] = {
+    { .name = "other" },
+};
+static int n_slots = 1;
+
+/* What's being timed, innermost last */
+static struct {
+    int slot;
+    uint64_t start;
+} stack[MAX_DEPTH];
+static int depth;
+
+X_EXTERN int
+X_PFX (stats_register) (const char *name, const char *handler)
+{
+    if (n_slots == X_STATS_MAX_SLOTS)
+        return -1;
+
+    slots[n_slots].name = name;
+    slots[n_slots].handler = handler;
+
+    return n_slots++;
+}
+
+X_EXTERN uint64_t
+X_PFX (stats_now) (void)
+{
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+
+    if (timebase.denom == 0)
+        mach_timebase_info (&timebase);
+
+    return mach_absolute_time () * timebase.numer / timebase.denom;
+#else
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+X_EXTERN void
+X_PFX (stats_record) (int slot, uint64_t ns)
+{
+    x_stats_slot *s;
+    uint64_t us;
+    int bucket;
+
+    if (slot < 0 || slot >= n_slots)
+        return;
+
+    s = &slots[slot];
+    s->count++;
+    s->total_ns += ns;
+    if (ns > s->max_ns)
+        s->max_ns = ns;
+
+    us = ns / 1000;
+    for (bucket = 0; bucket < X_STATS_BUCKETS - 1 && us >= 1; bucket++)
+        us >>= 1;
+
+    s->buckets[bucket]++;
+}
+
+X_EXTERN void
+X_PFX (stats_begin) (int slot)
+{
+    if (depth < MAX_DEPTH)
+    {
+        stack[depth].slot = slot;
+        stack[depth].start = X_PFX (stats_now) ();
+    }
+
+    depth++;
+}
+
+X_EXTERN void
+X_PFX (stats_end) (void)
+{
+    if (depth == 0)
+        return;
+
+    if (--depth < MAX_DEPTH)
+    {
+        X_PFX (stats_record) (stack[depth].slot,
+                              X_PFX (stats_now) () - stack[depth].start);
+    }
+}
+
+X_EXTERN void
+X_PFX (stats_round_trip) (void)
+{
+    int slot = 0;
+
+    if (depth > 0)
+        slot = stack[(depth < MAX_DEPTH ? depth : MAX_DEPTH) - 1].slot;
+
+    if (slot >= 0 && slot < n_slots)
+        slots[slot].round_trips++;
+}
+
+X_EXTERN int
+X_PFX (stats_length) (void)
+{
+    return n_slots;
+}
+
+X_EXTERN const x_stats_slot *
+X_PFX (stats_get) (int slot)
+{
+    if (slot < 0 || slot >= n_slots)
+        return NULL;
+
+    return &slots[slot];
+}
+
+X_EXTERN void
+X_PFX (stats_reset) (void)
+{
+    int i;
+
+    for (i = 0; i < n_slots; i++)
+    {
+        slots[i].count = 0;
+        slots[i].round_trips = 0;
+        slots[i].total_ns = 0;
+        slots[i].max_ns = 0;
+        memset (slots[i].buckets, 0, sizeof (slots[i].buckets));
+    }
+}
+
+X_EXTERN int
+X_PFX (stats_format) (const x_stats_slot *s, char *buf, size_t size)
+{
+    size_t len;
+    int i, n;
+
+    n = snprintf (buf, size, "%s%s%s: %lu in %.3fms (mean %.1fus, max %.1fus), "
+                  "%lu round trips;", s->name,
+                  s->handler != NULL ? " " : "",
+                  s->handler != NULL ? s->handler : "",
+                  s->count, s->total_ns / 1e6,
+                  s->count > 0 ? s->total_ns / 1e3 / s->count : 0.0,
+                  s->max_ns / 1e3, s->round_trips);
+    if (n < 0)
+        return n;
+
+    len = n;
+
+    for (i = 0; i < X_STATS_BUCKETS; i++)
+    {
+        if (s->buckets[i] == 0)
+            continue;
+
+        if (i < X_STATS_BUCKETS - 1)
+        {
+            n = snprintf (len < size ? buf + len : NULL,
+                          len < size ? size - len : 0,
+                          " <%luus:%lu", 1UL << i, s->buckets[i]);
+        }
+        else
+        {
+            n = snprintf (len < size ? buf + len : NULL,
+                          len < size ? size - len : 0,
+                          " >=%luus:%lu", 1UL << (i - 1), s->buckets[i]);
+        }
+        if (n < 0)
+            return n;
+
+        len += n;
+    }
+
+    return len;
+}
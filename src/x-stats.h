@@ -0,0 +1,92 @@
+/* x-stats.h -- where the window manager spends its time
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef X_STATS_H
+#define X_STATS_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Counts and latency histograms for the work we do in response to
+   things happening: one slot per kind of X event, plus a few for work
+   done outside event dispatch. Each slot also counts the synchronous
+   round trips made while it was running. Keeping them costs a clock
+   read at either end of each handler, nothing more; they're only
+   formatted when someone asks (see SIGUSR1 in main.m). */
+
+/* Bucket N counts latencies under 2^N microseconds, the last one
+   everything longer. */
+#define X_STATS_BUCKETS 20
+
+#define X_STATS_MAX_SLOTS 64
+
+typedef struct x_stats_slot_struct x_stats_slot;
+
+struct x_stats_slot_struct {
+    const char *name;
+    const char *handler;		/* NULL if the same as name */
+    unsigned long count;
+    unsigned long round_trips;
+    uint64_t total_ns, max_ns;
+    unsigned long buckets[X_STATS_BUCKETS];
+};
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+/* Slot 0 is "other", collecting round trips made outside any slot.
+   Returns -1 if there's no room left. */
+X_EXTERN int X_PFX (stats_register) (const char *name, const char *handler);
+
+/* A monotonic clock in nanoseconds */
+X_EXTERN uint64_t X_PFX (stats_now) (void);
+
+/* Time what happens until the matching stats_end() against SLOT.
+   These nest, the time of an inner slot counting towards the outer
+   one as well. */
+X_EXTERN void X_PFX (stats_begin) (int slot);
+X_EXTERN void X_PFX (stats_end) (void);
+
+/* Add one sample measured elsewhere */
+X_EXTERN void X_PFX (stats_record) (int slot, uint64_t ns);
+
+/* Call when about to wait for a reply from the server */
+X_EXTERN void X_PFX (stats_round_trip) (void);
+
+X_EXTERN int X_PFX (stats_length) (void);
+X_EXTERN const x_stats_slot *X_PFX (stats_get) (int slot);
+X_EXTERN void X_PFX (stats_reset) (void);
+
+/* One line describing SLOT: count, round trips, mean, max and the
+   non-empty buckets. Returns the length written, as snprintf(). */
+X_EXTERN int X_PFX (stats_format) (const x_stats_slot *slot,
+                                   char *buf, size_t size);
+
+#endif /* X_STATS_H */
@@ -0,0 +1,555 @@
+/* x-trace.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-trace.h"
+#include "x-stats.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define MASK (X_TRACE_RECORDS - 1)
+
+/* Strings are stored as offset << 16 | length */
+#define STRING_WORD(offset, length) (((uint64_t) (offset) << 16) | (length))
+#define STRING_OFFSET(word) ((unsigned int) ((word) >> 16))
+#define STRING_LENGTH(word) ((unsigned int) ((word) & 0xffff))
+
+typedef struct {
+    /* Index + 1 once the record is complete, 0 while being written */
+    unsigned long seq;
+    uint64_t time;
+    const char *fmt, *file, *function;
+    int line;
+    unsigned short n_words;
+    unsigned short n_bytes;
+    uint64_t words[X_TRACE_MAX_WORDS];
+    char strings[X_TRACE_STRING_BYTES];
+} trace_record;
+
+/* Pieces of a single conversion specification */
+typedef struct {
+    const char *start;
+    const char *flags, *width, *precision;
+    int n_flags, n_width, n_precision;
+    int star_width, star_precision;
+    int length;				/* 'l' for any integer length, 'L' */
+    char conversion;
+    const char *end;
+} conversion_spec;
+
+int X_PFX (trace_enabled);
+
+static trace_record ring[X_TRACE_RECORDS];
+static unsigned long head;		/* next index to write */
+static unsigned long tail;		/* next index to read */
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+X_EXTERN void
+X_PFX (trace_set_enabled) (int state)
+{
+    X_PFX (trace_enabled) = state;
+}
+
+/* Parses the conversion starting after the '%' at P. Returns false at
+   the end of the string, or for anything we can't copy. */
+static int
+parse_conversion (const char *p, conversion_spec *spec)
+{
+    spec->start = p;
+    spec->star_width = spec->star_precision = 0;
+    spec->precision = NULL;
+    spec->n_precision = 0;
+    spec->length = 0;
+
+    spec->flags = p;
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0'
+           || *p == '\'')
+    {
+        p++;
+    }
+    spec->n_flags = p - spec->flags;
+
+    spec->width = p;
+    if (*p == '*')
+    {
+        spec->star_width = 1;
+        p++;
+    }
+    else
+    {
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    spec->n_width = p - spec->width;
+
+    if (*p == '.')
+    {
+        p++;
+        spec->precision = p;
+        if (*p == '*')
+        {
+            spec->star_precision = 1;
+            p++;
+        }
+        else
+        {
+            while (*p >= '0' && *p <= '9')
+                p++;
+        }
+        spec->n_precision = p - spec->precision;
+    }
+
+    switch (*p)
+    {
+        case 'h':
+            p++;
+            if (*p == 'h')
+                p++;
+            spec->length = 'h';
+            break;
+        case 'l':
+            p++;
+            if (*p == 'l')
+            {
+                p++;
+                spec->length = 'q';
+            }
+            else
+                spec->length = 'l';
+            break;
+        case 'q': case 'j': case 'z': case 't': case 'L':
+            spec->length = *p++;
+            break;
+    }
+
+    spec->conversion = *p;
+    switch (*p)
+    {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        case 'c': case 'p': case 's':
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+        case 'a': case 'A':
+            break;
+        default:
+            return 0;
+    }
+
+    spec->end = p + 1;
+    return 1;
+}
+
+/* The precision of a string conversion, -1 if none */
+static int
+string_precision (const conversion_spec *spec, int star_value)
+{
+    if (spec->star_precision)
+        return star_value;
+    else if (spec->precision != NULL)
+        return spec->n_precision > 0 ? atoi (spec->precision) : 0;
+    else
+        return -1;
+}
+
+X_EXTERN void
+X_PFX (trace) (const char *file, const char *function, int line,
+               const char *fmt, ...)
+{
+    unsigned long idx;
+    trace_record *r;
+    conversion_spec spec;
+    const char *p;
+    va_list args;
+    int precision;
+
+    idx = __atomic_fetch_add (&head, 1, __ATOMIC_RELAXED);
+    r = &ring[idx & MASK];
+
+    __atomic_store_n (&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    r->time = X_PFX (stats_now) ();
+    r->fmt = fmt;
+    r->file = file;
+    r->function = function;
+    r->line = line;
+    r->n_words = 0;
+    r->n_bytes = 0;
+
+    va_start (args, fmt);
+
+    for (p = fmt; *p != 0; p++)
+    {
+        if (*p != '%')
+            continue;
+        if (*++p == '%')
+            continue;
+
+        /* The decoder stops at the same place */
+        if (!parse_conversion (p, &spec)
+            || r->n_words + spec.star_width + spec.star_precision + 1
+               > X_TRACE_MAX_WORDS)
+        {
+            break;
+        }
+
+        if (spec.star_width)
+            r->words[r->n_words++] = va_arg (args, int);
+
+        precision = -1;
+        if (spec.star_precision)
+        {
+            precision = va_arg (args, int);
+            r->words[r->n_words++] = precision;
+        }
+
+        switch (spec.conversion)
+        {
+            case 'd': case 'i': case 'c':
+                if (spec.length == 'l')
+                    r->words[r->n_words++] = va_arg (args, long);
+                else if (spec.length == 'q')
+                    r->words[r->n_words++] = va_arg (args, long long);
+                else if (spec.length == 'j')
+                    r->words[r->n_words++] = va_arg (args, intmax_t);
+                else if (spec.length == 'z' || spec.length == 't')
+                    r->words[r->n_words++] = va_arg (args, ptrdiff_t);
+                else
+                    r->words[r->n_words++] = va_arg (args, int);
+                break;
+
+            case 'o': case 'u': case 'x': case 'X':
+                if (spec.length == 'l')
+                    r->words[r->n_words++] = va_arg (args, unsigned long);
+                else if (spec.length == 'q')
+                    r->words[r->n_words++] = va_arg (args, unsigned long long);
+                else if (spec.length == 'j')
+                    r->words[r->n_words++] = va_arg (args, uintmax_t);
+                else if (spec.length == 'z' || spec.length == 't')
+                    r->words[r->n_words++] = va_arg (args, size_t);
+                else
+                    r->words[r->n_words++] = va_arg (args, unsigned int);
+                break;
+
+            case 'p':
+                r->words[r->n_words++] = (uintptr_t) va_arg (args, void *);
+                break;
+
+            case 's': {
+                const char *s = va_arg (args, const char *);
+                size_t len, room;
+
+                if (s == NULL)
+                    s = "(null)";
+
+                precision = string_precision (&spec, precision);
+                room = X_TRACE_STRING_BYTES - r->n_bytes;
+                if (precision >= 0 && (size_t) precision < room)
+                    room = precision;
+
+                len = strnlen (s, room);
+                memcpy (r->strings + r->n_bytes, s, len);
+                r->words[r->n_words++] = STRING_WORD (r->n_bytes, len);
+                r->n_bytes += len;
+                break;
+            }
+
+            default: {
+                double d;
+
+                if (spec.length == 'L')
+                    d = va_arg (args, long double);
+                else
+                    d = va_arg (args, double);
+
+                memcpy (&r->words[r->n_words++], &d, sizeof (d));
+                break;
+            }
+        }
+
+        p = spec.end - 1;
+    }
+
+    va_end (args);
+
+    __atomic_store_n (&r->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+/* Appends the part of SPEC that isn't width, precision or length to
+   BUF, substituting the given width and precision. */
+static char *
+build_spec (char *buf, const conversion_spec *spec, const uint64_t *width,
+            const uint64_t *precision, const char *length)
+{
+    char *b = buf;
+
+    *b++ = '%';
+    memcpy (b, spec->flags, spec->n_flags);
+    b += spec->n_flags;
+
+    if (width != NULL)
+        b += sprintf (b, "%d", (int) *width);
+    else
+    {
+        memcpy (b, spec->width, spec->n_width);
+        b += spec->n_width;
+    }
+
+    if (precision != NULL)
+        b += sprintf (b, ".%d", (int) *precision);
+    else if (spec->precision != NULL)
+    {
+        *b++ = '.';
+        memcpy (b, spec->precision, spec->n_precision);
+        b += spec->n_precision;
+    }
+
+    strcpy (b, length);
+    b += strlen (length);
+    *b++ = spec->conversion;
+    *b = 0;
+
+    return buf;
+}
+
+#define APPEND(...)							\
+do {									\
+    int n_ = snprintf (out + len, len < size ? size - len : 0,		\
+                       __VA_ARGS__);					\
+    if (n_ > 0)								\
+        len += n_;							\
+} while (0)
+
+/* Formats R into OUT the way printf would have. */
+static void
+decode_record (const trace_record *r, char *out, size_t size)
+{
+    conversion_spec spec;
+    const char *p, *literal;
+    char fmt[64];
+    unsigned int w = 0;
+    size_t len = 0;
+
+    out[0] = 0;
+    literal = r->fmt;
+
+    for (p = r->fmt; *p != 0; p++)
+    {
+        const uint64_t *width = NULL, *precision = NULL;
+
+        if (*p != '%')
+            continue;
+
+        if (p[1] == '%')
+        {
+            APPEND ("%.*s%%", (int) (p - literal), literal);
+            literal = p + 2;
+            p++;
+            continue;
+        }
+
+        if (!parse_conversion (p + 1, &spec)
+            || w + spec.star_width + spec.star_precision + 1 > r->n_words)
+        {
+            break;
+        }
+
+        APPEND ("%.*s", (int) (p - literal), literal);
+
+        if (spec.star_width)
+            width = &r->words[w++];
+        if (spec.star_precision)
+            precision = &r->words[w++];
+
+        switch (spec.conversion)
+        {
+            case 'c':
+                APPEND (build_spec (fmt, &spec, width, precision, ""),
+                        (int) r->words[w]);
+                break;
+
+            case 'd': case 'i':
+                APPEND (build_spec (fmt, &spec, width, precision, "ll"),
+                        (long long) r->words[w]);
+                break;
+
+            case 'o': case 'u': case 'x': case 'X':
+                if (spec.length == 'l' || spec.length == 'q'
+                    || spec.length == 'j' || spec.length == 'z'
+                    || spec.length == 't')
+                {
+                    APPEND (build_spec (fmt, &spec, width, precision, "ll"),
+                            (unsigned long long) r->words[w]);
+                }
+                else
+                {
+                    APPEND (build_spec (fmt, &spec, width, precision, ""),
+                            (unsigned int) r->words[w]);
+                }
+                break;
+
+            case 'p':
+                APPEND (build_spec (fmt, &spec, width, precision, ""),
+                        (void *) (uintptr_t) r->words[w]);
+                break;
+
+            case 's': {
+                uint64_t length = STRING_LENGTH (r->words[w]);
+
+                APPEND (build_spec (fmt, &spec, width, &length, ""),
+                        r->strings + STRING_OFFSET (r->words[w]));
+                break;
+            }
+
+            default: {
+                double d;
+
+                memcpy (&d, &r->words[w], sizeof (d));
+                APPEND (build_spec (fmt, &spec, width, precision, ""), d);
+                break;
+            }
+        }
+
+        w++;
+        literal = spec.end;
+        p = spec.end - 1;
+    }
+
+    APPEND ("%s", literal);
+}
+
+#undef APPEND
+
+X_EXTERN unsigned long
+X_PFX (trace_drain) (x_trace_emit_proc emit, void *data)
+{
+    trace_record copy;
+    unsigned long h, seq, lost = 0, emitted = 0;
+    char text[512];
+
+    pthread_mutex_lock (&drain_lock);
+
+    h = __atomic_load_n (&head, __ATOMIC_ACQUIRE);
+
+    if (h - tail > X_TRACE_RECORDS)
+    {
+        lost += h - tail - X_TRACE_RECORDS;
+        tail = h - X_TRACE_RECORDS;
+    }
+
+    for (; tail != h; tail++)
+    {
+        trace_record *r = &ring[tail & MASK];
+
+        seq = __atomic_load_n (&r->seq, __ATOMIC_ACQUIRE);
+
+        /* 0 while being written; an older index if the writer has
+           claimed the slot but not got as far as clearing it */
+        if (seq < tail + 1)
+            break;
+
+        if (seq > tail + 1)
+        {
+            lost++;			/* overwritten since */
+            continue;
+        }
+
+        memcpy (&copy, r, sizeof (copy));
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n (&r->seq, __ATOMIC_RELAXED) != seq)
+        {
+            lost++;
+            continue;
+        }
+
+        if (lost > 0)
+        {
+            snprintf (text, sizeof (text), "lost %lu trace records", lost);
+            emit (NULL, NULL, 0, copy.time, text, data);
+            lost = 0;
+        }
+
+        decode_record (&copy, text, sizeof (text));
+        emit (copy.file, copy.function, copy.line, copy.time, text, data);
+        emitted++;
+    }
+
+    if (lost > 0)
+    {
+        snprintf (text, sizeof (text), "lost %lu trace records", lost);
+        emit (NULL, NULL, 0, X_PFX (stats_now) (), text, data);
+    }
+
+    pthread_mutex_unlock (&drain_lock);
+
+    return emitted;
+}
+
+typedef struct {
+    x_trace_emit_proc emit;
+    void *data;
+    unsigned int interval_ms;
+} drain_thread_args;
+
+static void *
+drain_thread (void *arg)
+{
+    drain_thread_args *a = arg;
+
+    while (1)
+    {
+        usleep (a->interval_ms * 1000);
+        X_PFX (trace_drain) (a->emit, a->data);
+    }
+
+    return NULL;
+}
+
+X_EXTERN int
+X_PFX (trace_start_thread) (x_trace_emit_proc emit, void *data,
+                            unsigned int interval_ms)
+{
+    static drain_thread_args args;
+    pthread_t thread;
+
+    args.emit = emit;
+    args.data = data;
+    args.interval_ms = interval_ms;
+
+    if (pthread_create (&thread, NULL, drain_thread, &args) != 0)
+        return 0;
+
+    pthread_detach (thread);
+    return 1;
+}
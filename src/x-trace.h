@@ -0,0 +1,86 @@
+/* x-trace.h -- cheap debug logging
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#ifndef X_TRACE_H
+#define X_TRACE_H 1
+
+#include <stdint.h>
+
+/* Debug logging that costs a branch when off, and little more when on.
+   Call sites test x_trace_enabled before evaluating anything (see DB()
+   in quartz-wm.h). Enabled calls copy their arguments, undigested, into
+   a fixed ring of records; formatting and writing them out happens
+   later, from x_trace_drain(), usually on a thread of its own. If the
+   ring fills up before it's drained, the oldest records are lost and
+   their number reported.
+
+   Formats take the usual printf conversions except %n. Arguments are
+   copied according to the format, so they must match it. Strings are
+   copied too, up to a limit per record. */
+
+#define X_TRACE_RECORDS 1024		/* must be a power of two */
+#define X_TRACE_MAX_WORDS 16
+#define X_TRACE_STRING_BYTES 160
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+#if defined (__GNUC__)
+# define X_TRACE_PRINTF(f, a) __attribute__ ((format (printf, f, a)))
+#else
+# define X_TRACE_PRINTF(f, a)
+#endif
+
+extern int X_PFX (trace_enabled);
+
+X_EXTERN void X_PFX (trace_set_enabled) (int state);
+
+X_EXTERN void X_PFX (trace) (const char *file, const char *function,
+                             int line, const char *fmt, ...)
+    X_TRACE_PRINTF (4, 5);
+
+/* Called by x_trace_drain() for each record, oldest first. FILE is
+   NULL for the line reporting lost records. TIME is from
+   x_stats_now(). */
+typedef void (*x_trace_emit_proc) (const char *file, const char *function,
+                                   int line, uint64_t time,
+                                   const char *text, void *data);
+
+/* Decodes and emits everything recorded so far. Safe to call from any
+   thread. Returns the number of records emitted. */
+X_EXTERN unsigned long X_PFX (trace_drain) (x_trace_emit_proc emit,
+                                            void *data);
+
+/* Starts a thread calling x_trace_drain() every INTERVAL_MS
+   milliseconds. Returns zero on failure. */
+X_EXTERN int X_PFX (trace_start_thread) (x_trace_emit_proc emit, void *data,
+                                         unsigned int interval_ms);
+
+#endif /* X_TRACE_H */
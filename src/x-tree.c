@@ -0,0 +1,67 @@
+/* x-tree.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-tree.h"
+#include <stddef.h>
+
+X_EXTERN x_list *
+X_PFX (tree_collect) (void *data, const x_tree_ops *ops,
+                      unsigned int up_stamp, unsigned int down_stamp)
+{
+    x_list *group = NULL, *todo;
+    x_chain_node *node;
+    void *root, *parent, *obj;
+
+    for (root = data; (parent = ops->parent (root)) != NULL
+         && *ops->visit_stamp (parent) != up_stamp; root = parent)
+    {
+        *ops->visit_stamp (root) = up_stamp;
+    }
+
+    *ops->visit_stamp (root) = down_stamp;
+    todo = X_PFX (list_prepend) (NULL, root);
+
+    while (todo != NULL)
+    {
+        todo = X_PFX (list_pop) (todo, &obj);
+        group = X_PFX (list_prepend) (group, obj);
+
+        for (node = ops->children (obj)->head; node != NULL; node = node->next)
+        {
+            unsigned int *stamp = ops->visit_stamp (node->data);
+
+            if (*stamp != down_stamp)
+            {
+                *stamp = down_stamp;
+                todo = X_PFX (list_prepend) (todo, node->data);
+            }
+        }
+    }
+
+    return group;
+}
@@ -0,0 +1,59 @@
+/* x-tree.h -- walking trees of objects linked through x_chains
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef X_TREE_H
+#define X_TREE_H 1
+
+#include "x-list.h"
+#include "x-chain.h"
+
+/* Trees whose objects each embed the chain of their children, a node
+   on their parent's chain and a visit stamp, like the windows joined
+   by WM_TRANSIENT_FOR. The walk finds them through these. */
+
+typedef struct x_tree_ops_struct x_tree_ops;
+
+struct x_tree_ops_struct {
+    void *(*parent) (void *data);
+    x_chain *(*children) (void *data);
+    unsigned int *(*visit_stamp) (void *data);
+};
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+/* Every object in the tree containing DATA: walks up to its root,
+   stopping at an object seen before since parent links can form
+   cycles, and back down. UP_STAMP and DOWN_STAMP are stamped on the
+   objects visited each way, so must differ and be in use by none. */
+X_EXTERN x_list *X_PFX (tree_collect) (void *data, const x_tree_ops *ops,
+                                       unsigned int up_stamp,
+                                       unsigned int down_stamp);
+
+#endif /* X_TREE_H */
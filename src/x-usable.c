@@ -0,0 +1,300 @@
+/* x-usable.c
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x-usable.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+void
+X_PFX (usable_area_init) (x_usable_area *u)
+{
+    pixman_region32_init (&u->screen);
+    pixman_region32_init (&u->usable);
+    u->main_head = X11EmptyRect;
+    u->heads = NULL;
+    u->dock_bottom = NULL;
+    u->n_heads = 0;
+    u->dock = X11EmptyRect;
+    u->dock_orientation = X_USABLE_DOCK_NONE;
+}
+
+void
+X_PFX (usable_area_fini) (x_usable_area *u)
+{
+    pixman_region32_fini (&u->screen);
+    pixman_region32_fini (&u->usable);
+    free (u->heads);
+    free (u->dock_bottom);
+    u->heads = NULL;
+    u->dock_bottom = NULL;
+    u->n_heads = 0;
+}
+
+static void
+update_usable (x_usable_area *u)
+{
+    X11Region dock_region, tem;
+    int i;
+
+    pixman_region32_init_rect (&dock_region, u->dock.x, u->dock.y,
+                               u->dock.width, u->dock.height);
+
+    /* This should always be dock_region, but we're being careful */
+    pixman_region32_init (&tem);
+    pixman_region32_intersect (&tem, &u->screen, &dock_region);
+    pixman_region32_subtract (&u->usable, &u->screen, &tem);
+    pixman_region32_fini (&tem);
+    pixman_region32_fini (&dock_region);
+
+    for (i = 0; i < u->n_heads; i++)
+    {
+        if (u->dock_orientation == X_USABLE_DOCK_BOTTOM
+            && X11RectContainsPoint (u->heads[i],
+                                     X11PointMake (u->dock.x, u->dock.y)))
+            u->dock_bottom[i] = u->dock.height;
+        else
+            u->dock_bottom[i] = 0;
+    }
+}
+
+void
+X_PFX (usable_area_set_heads) (x_usable_area *u, X11Region *screen,
+                               const X11Rect *heads, int n_heads,
+                               X11Rect main_head)
+{
+    int i;
+
+    pixman_region32_copy (&u->screen, screen);
+    u->main_head = main_head;
+
+    u->heads = realloc (u->heads, sizeof (X11Rect) * (n_heads + 1));
+    u->dock_bottom = realloc (u->dock_bottom, sizeof (int) * (n_heads + 1));
+    assert (u->heads != NULL && u->dock_bottom != NULL);
+
+    for (i = 0; i < n_heads; i++)
+        u->heads[i] = heads[i];
+    u->n_heads = n_heads;
+
+    update_usable (u);
+}
+
+void
+X_PFX (usable_area_set_dock) (x_usable_area *u, X11Rect dock,
+                              x_usable_dock_orientation orientation)
+{
+    u->dock = dock;
+    u->dock_orientation = orientation;
+
+    update_usable (u);
+}
+
+static inline int
+rect_contains_rect (X11Rect outer, X11Rect inner)
+{
+    return (inner.x >= outer.x && inner.y >= outer.y
+            && inner.x + (int) inner.width <= outer.x + (int) outer.width
+            && inner.y + (int) inner.height <= outer.y + (int) outer.height);
+}
+
+static inline int
+rects_intersect (X11Rect a, X11Rect b)
+{
+    return (a.x < b.x + (int) b.width && b.x < a.x + (int) a.width
+            && a.y < b.y + (int) b.height && b.y < a.y + (int) a.height);
+}
+
+X11Rect
+X_PFX (usable_area_validate) (x_usable_area *u, X11Rect win_rect,
+                              int titlebar_height)
+{
+    X11Region win_region, title_region, win_int, title_int, tem;
+    X11Rect title_rect, title_int_rect, ret;
+    pixman_box32_t *e;
+    int i;
+
+    ret = title_rect = win_rect;
+    title_rect.height = titlebar_height;
+
+    /* The usual case: the whole titlebar is on one head and clear of
+       the dock, so there's nothing to do. */
+    if (titlebar_height > 0 && title_rect.width > 0 && win_rect.height > 0
+        && !rects_intersect (title_rect, u->dock))
+    {
+        if (u->n_heads == 0 && rect_contains_rect (u->main_head, title_rect))
+            return ret;
+
+        for (i = 0; i < u->n_heads; i++)
+        {
+            if (rect_contains_rect (u->heads[i], title_rect))
+                return ret;
+        }
+    }
+
+    pixman_region32_init_rect (&win_region, win_rect.x, win_rect.y,
+                               win_rect.width, win_rect.height);
+    pixman_region32_init_rect (&title_region, title_rect.x, title_rect.y,
+                               title_rect.width, title_rect.height);
+
+    /* The parts of the window and its titlebar that are on a display
+       and not under the dock */
+    pixman_region32_init (&win_int);
+    pixman_region32_intersect (&win_int, &u->usable, &win_region);
+
+    pixman_region32_init (&title_int);
+    pixman_region32_intersect (&title_int, &u->usable, &title_region);
+    e = pixman_region32_extents (&title_int);
+    title_int_rect = X11RectMake (e->x1, e->y1, e->x2 - e->x1, e->y2 - e->y1);
+    pixman_region32_fini (&title_int);
+
+    if (!pixman_region32_not_empty (&win_int))
+    {
+        X11Region win_dock_int;
+
+        /* Check if we're behind the dock or offscreen */
+        pixman_region32_init (&win_dock_int);
+        pixman_region32_intersect (&win_dock_int, &u->screen, &win_region);
+
+        if (!pixman_region32_not_empty (&win_dock_int) || titlebar_height == 0)
+        {
+            /* Window wouldn't be on any display, so put it at top-left of
+               the main head. */
+            ret.y = u->main_head.y;
+        }
+        else
+        {
+            /* Window is partially behind our dock. */
+            switch (u->dock_orientation)
+            {
+                case X_USABLE_DOCK_BOTTOM:
+                    ret.y = u->dock.y - titlebar_height;
+                    break;
+                case X_USABLE_DOCK_LEFT:
+                    ret.x = u->dock.x + u->dock.width - ret.width + 40;
+                    break;
+                case X_USABLE_DOCK_RIGHT:
+                    ret.x = u->dock.x - 40;
+                    break;
+                default:
+                    break;
+            }
+        }
+        pixman_region32_fini (&win_dock_int);
+
+        /* Try to preserve X position */
+        pixman_region32_init (&tem);
+        pixman_region32_intersect (&tem, &u->screen, &title_region);
+
+        if (!pixman_region32_not_empty (&tem))
+        {
+            ret.x = u->main_head.x;
+            ret.y = u->main_head.y;
+        }
+
+        pixman_region32_fini (&tem);
+    }
+    else if (title_int_rect.height < (unsigned int) titlebar_height)
+    {
+        /* The titlebar needs to have its full height on-screen */
+
+        for (i = 0; i < u->n_heads; i++)
+        {
+            X11Rect dpy_rect = u->heads[i];
+
+            /* Does it touch this display? */
+            if (X11RectIsEmpty (X11RectIntersection (win_rect, dpy_rect)))
+                continue;
+
+            if (ret.y < dpy_rect.y)
+            {
+                ret.y = dpy_rect.y;
+                break;
+            }
+
+            if (ret.y + title_rect.height > dpy_rect.y + dpy_rect.height - u->dock_bottom[i])
+            {
+                ret.y = (dpy_rect.y + dpy_rect.height - title_rect.height - u->dock_bottom[i]);
+                break;
+            }
+        }
+    }
+
+    pixman_region32_fini (&win_int);
+    pixman_region32_fini (&win_region);
+    pixman_region32_fini (&title_region);
+
+    return ret;
+}
+
+static int
+find_head (const X11Rect *heads, int n_heads, X11Rect r)
+{
+    int i;
+
+    for (i = 0; i < n_heads; i++)
+    {
+        if (X11RectEqualToRect (heads[i], r))
+            return i;
+    }
+
+    return -1;
+}
+
+int
+X_PFX (usable_heads_diff) (const X11Rect *old_heads, int n_old,
+                           const X11Rect *new_heads, int n_new,
+                           X11Region *changed)
+{
+    int i, n_changed = 0;
+
+    for (i = 0; i < n_old; i++)
+    {
+        if (find_head (new_heads, n_new, old_heads[i]) < 0)
+        {
+            pixman_region32_union_rect (changed, changed,
+                                        old_heads[i].x, old_heads[i].y,
+                                        old_heads[i].width,
+                                        old_heads[i].height);
+            n_changed++;
+        }
+    }
+
+    for (i = 0; i < n_new; i++)
+    {
+        if (find_head (old_heads, n_old, new_heads[i]) < 0)
+        {
+            pixman_region32_union_rect (changed, changed,
+                                        new_heads[i].x, new_heads[i].y,
+                                        new_heads[i].width,
+                                        new_heads[i].height);
+            n_changed++;
+        }
+    }
+
+    return n_changed;
+}
@@ -0,0 +1,91 @@
+/* x-usable.h -- where on the screen windows can usefully go
+ *
+ * Copyright (c) 2002-2011 Apple Inc. All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef X_USABLE_H
+#define X_USABLE_H 1
+
+#include "x11-geometry.h"
+
+/* The heads of a screen and the part of them not covered by the dock,
+   worked out when either changes so that keeping windows reachable is
+   cheap enough to do on every step of a drag. */
+
+typedef enum {
+    X_USABLE_DOCK_NONE,
+    X_USABLE_DOCK_BOTTOM,
+    X_USABLE_DOCK_LEFT,
+    X_USABLE_DOCK_RIGHT,
+} x_usable_dock_orientation;
+
+typedef struct x_usable_area_struct x_usable_area;
+
+struct x_usable_area_struct {
+    X11Region screen;			/* union of the heads */
+    X11Region usable;			/* screen less the dock */
+    X11Rect main_head;
+
+    X11Rect *heads;
+    int *dock_bottom;			/* dock height if it's at the bottom
+					   of this head, else 0 */
+    int n_heads;
+
+    X11Rect dock;
+    x_usable_dock_orientation dock_orientation;
+};
+
+#ifndef X_PFX
+# define X_PFX(x) x_ ## x
+#endif
+
+#ifndef X_EXTERN
+# define X_EXTERN __private_extern__
+#endif
+
+X_EXTERN void X_PFX (usable_area_init) (x_usable_area *u);
+X_EXTERN void X_PFX (usable_area_fini) (x_usable_area *u);
+
+/* SCREEN is copied. N_HEADS may be zero, in which case there's only
+   MAIN_HEAD. */
+X_EXTERN void X_PFX (usable_area_set_heads) (x_usable_area *u,
+                                             X11Region *screen,
+                                             const X11Rect *heads, int n_heads,
+                                             X11Rect main_head);
+X_EXTERN void X_PFX (usable_area_set_dock) (x_usable_area *u, X11Rect dock,
+                                            x_usable_dock_orientation orientation);
+
+/* Moves WIN_RECT so that its titlebar can be reached: not off the
+   screen and not behind the dock. */
+X_EXTERN X11Rect X_PFX (usable_area_validate) (x_usable_area *u,
+                                               X11Rect win_rect,
+                                               int titlebar_height);
+
+/* Adds to CHANGED each head that is in only one of OLD_HEADS and
+   NEW_HEADS: those that were added, removed, moved or resized. Only
+   windows touching CHANGED can validate differently afterwards, if
+   the main head and the dock stayed put. Returns how many there were. */
+X_EXTERN int X_PFX (usable_heads_diff) (const X11Rect *old_heads, int n_old,
+                                        const X11Rect *new_heads, int n_new,
+                                        X11Region *changed);
+
+#endif /* X_USABLE_H */
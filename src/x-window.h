@@ -27,9 +27,13 @@
 
 #import "x-screen.h"
 #include "x-list.h"
+#include "x-chain.h"
+#include "x-stack.h"
+#include "x-grid.h"
 #include "frame.h"
 
 #include <X11/Xutil.h>
+#include <X11/extensions/sync.h>
 
 @interface x_window : NSObject
 {
@@ -46,6 +50,9 @@ @interface x_window : NSObject
     Window _growbox_id;
     X11Rect _growbox_rect;
 
+    /* Fires when the client's _NET_WM_SYNC_REQUEST_COUNTER catches up */
+    XSyncAlarm _sync_alarm;
+
     x_screen *_screen;
 
     /*_xattr is for the Window _id, NOT _frame_id.  Note that this is also
@@ -60,6 +67,13 @@ @interface x_window : NSObject
     int _frame_title_height;
 
     int _level;
+    x_chain_node _window_node;
+    x_stack_node _stack_node;
+    x_grid_item _grid_item;
+
+    /* Marks windows already seen while walking the transient forest
+       or a group, see +new_visit_stamp */
+    unsigned int _visit_stamp;
 
     unsigned _reparented :1;
     unsigned _shaped :1;
@@ -72,12 +86,15 @@ @interface x_window : NSObject
     unsigned _always_click_through :1;
     unsigned _movable :1;
     unsigned _shadable :1;
+    unsigned _grouped :1;		/* in _screen's index for _group_id */
 
     NSString *_title;
     int _shortcut_index;		/* 0 for unset */
+    int _window_menu_index;		/* -1 if not in the window menu */
 
 @private
     unsigned _set_shape :1;
+    unsigned _shape_changed :1;		/* client reshaped since update_shape: */
     unsigned _decorated :1;
     unsigned _fullscreen :1;
     unsigned _resizable :1;
@@ -87,15 +104,22 @@ @interface x_window : NSObject
     unsigned _client_unmapped :1;
     unsigned _does_wm_take_focus :1;
     unsigned _does_wm_delete_window :1;
+    unsigned _does_net_wm_sync_request :1;
+    unsigned _sync_waiting :1;		/* client hasn't drawn the last resize */
+    unsigned _sync_unresponsive :1;	/* timed out, don't wait for it */
     unsigned _pending_frame_change :1;
     unsigned _queued_frame_change :1;
     unsigned _has_unzoomed_frame :1;
     unsigned _pending_decorate :1;
+    unsigned _decorate_queued :1;	/* in the screen's decorate queue */
+    unsigned _reshape_queued :1;	/* in the screen's reshape queue */
     unsigned _resizing_title :1;
     unsigned _needs_configure_notify :1;
     unsigned _modal :1;
     unsigned _in_window_menu :1;
     unsigned _pending_raise :1;
+    unsigned _interactive :1;		/* user is dragging or resizing us */
+    unsigned _interactive_moved :1;	/* owe the client a ConfigureNotify */
 
     /* This differs from _current_frame.height in that it is the height
      * when the frame is not shaded.
@@ -111,6 +135,21 @@ @interface x_window : NSObject
     X11Rect _queued_frame;
     X11Rect _unzoomed_frame;
 
+    /* While _sync_waiting, resizes go to _queued_frame until the
+     client sets _sync_counter to _sync_value or _sync_timer fires. */
+
+    /* What the frame's bounding shape was last built from, while
+     _set_shape. Shapes are window-relative, so moving the frame never
+     needs a new one. */
+
+    XRectangle _shape_rects[2];
+    int _shape_n_rects;
+    int _shape_inner_x, _shape_inner_y;
+
+    XSyncCounter _sync_counter;
+    int64_t _sync_value;
+    NSTimer *_sync_timer;
+
     /* Stored result from XGetWMHints() and XGetWMNormalHints() */
     XWMHints *_wm_hints;
 
@@ -124,12 +163,15 @@ @interface x_window : NSObject
     Window *_colormap_windows;
     int _n_colormap_windows;
 
-    /* Store what our decorations were the last time we drew the frame.
+    /* Store what our decorations were when we created the frame.
      * This is different from _frame_decor because it may be NONE due
      * to _fullscreen.
      */
     xp_frame_class _drawn_frame_decor;
 
+    /* Everything about the last draw, to skip redrawing the same */
+    frame_draw_state _frame_draw_state;
+
     /* Mac IDs corresponding to these windows */
     xp_native_window_id _osx_id;
     xp_native_window_id _minimized_osx_id;
@@ -137,7 +179,8 @@ @interface x_window : NSObject
     /* Transience tree */
     Window _transient_for_id;
     x_window *_transient_for;
-    x_list *_transients;
+    x_chain _transients;		/* nodes are x_window->_transient_node */
+    x_chain_node _transient_node;
 }
 
 - (Window) toplevel_id;
@@ -147,14 +190,19 @@ - (void) send_configure;
 - init_with_id:(Window)xwindow_id screen:screen initializing:(BOOL)flag;
 - (void) resize_frame:(X11Rect)r;
 - (void) report_frame_size:(X11Rect)r;
+- (void) sync_alarm_notify:(XSyncAlarmNotifyEvent *)e;
 - (void) resize_client:(X11Rect)r;
 - (void) update_shaped;
 - (void) update_shape;
+- (void) reshape;
+- (void) reshape_now;
 - (void) expose;
 - (void) decorate;
+- (void) decorate_now;
 - (void) property_changed:(Atom)atom;
 - (void) update_net_wm_action_property;
 - (x_list *) window_group;
++ (unsigned int) new_visit_stamp;
 - (xp_native_window_id) get_osx_id;
 - (void) set_wm_state:(int)state;
 - (void) raise;
@@ -184,6 +232,8 @@ - (X11Rect) validate_frame_rect:(X11Rect)r;
 - (X11Rect) validate_frame_rect:(X11Rect)r from_user:(BOOL)flag;
 - (void) set_resizing_title:(X11Rect)r;
 - (void) remove_resizing_title;
+- (void) begin_interactive;
+- (void) end_interactive;
 - (void) error_shutdown;
 - (void) update_colormaps;
 - (void) install_colormaps;
@@ -30,6 +30,8 @@
 #import "x-window.h"
 #include "frame.h"
 #include "utils.h"
+#include "x-stats.h"
+#include "x-tree.h"
 
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
@@ -39,11 +41,22 @@
 #define WINDOW_PLACE_DELTA_X 20
 #define WINDOW_PLACE_DELTA_Y 20
 
+/* How long to wait for a client to answer _NET_WM_SYNC_REQUEST before
+   resizing it without waiting */
+#define SYNC_REQUEST_TIMEOUT 0.5
+
 #define XP_FRAME_CLASS_DECOR_MASK  (XP_FRAME_CLASS_DECOR_LARGE | XP_FRAME_CLASS_DECOR_SMALL | XP_FRAME_CLASS_DECOR_NONE)
 
 @interface x_window (local)
+- (void) set_osx_id:(xp_native_window_id)wid;
+- (void) update_osx_id;
 - (void) update_wm_name;
 - (void) update_wm_protocols;
+- (void) update_sync_counter;
+- (void) release_sync_alarm;
+- (void) send_sync_request;
+- (void) sync_finished;
+- (void) flush_queued_frame;
 - (void) update_wm_hints;
 - (void) update_size_hints;
 - (void) update_frame;
@@ -98,27 +111,47 @@ - (X11Rect) intended_frame;
     }
 }
 
+/* How x_tree_collect finds its way around the transient forest */
+
+static void *
+transient_parent (void *data)
+{
+    return ((x_window *) data)->_transient_for;
+}
+
+static x_chain *
+transient_children (void *data)
+{
+    return &((x_window *) data)->_transients;
+}
+
+static unsigned int *
+transient_visit_stamp (void *data)
+{
+    return &((x_window *) data)->_visit_stamp;
+}
+
+static const x_tree_ops transient_tree_ops = {
+    transient_parent, transient_children, transient_visit_stamp
+};
+
+unsigned long x_sync_requests, x_sync_timeouts;
+unsigned long x_shape_requests, x_shape_requests_avoided;
+
 @implementation x_window
 
 #undef TRACE
 #define TRACE() DB("TRACE: id: 0x%lx frame_id: 0x%lx", _id, _frame_id)
 
-#define DISABLE_EVENTS(wid, mask)				\
-do {							\
-x_grab_server (False);					\
-XSelectInput (x_dpy, wid, mask);			\
-} while (0)
-
-#define ENABLE_EVENTS(wid, mask)				\
-do {							\
-XSelectInput (x_dpy, wid, mask);			\
-x_ungrab_server ();					\
-} while (0)
+/* Our own map, unmap and reparent requests on the client generate
+   StructureNotify events that must not be mistaken for the client
+   withdrawing. Rather than grabbing the server and deselecting them,
+   note the request serials so x_input_run() can discard them. */
 
 #define BEFORE_LOCAL_MAP \
-DISABLE_EVENTS (_id, X_CLIENT_WINDOW_EVENTS & ~StructureNotifyMask)
-#define AFTER_LOCAL_MAP \
-ENABLE_EVENTS (_id, X_CLIENT_WINDOW_EVENTS)
+unsigned long local_serial = NextRequest (x_dpy)
+#define AFTER_LOCAL_MAP(type) \
+x_input_expect_event (_id, local_serial, type)
 
 - (Window) toplevel_id
 {
@@ -191,14 +224,34 @@ - (void) reparent_in
                                    attr_mask, &attr);
 
         XSelectInput (x_dpy, _frame_id, X_FRAME_WINDOW_EVENTS);
+        [_screen index_window:self id:_frame_id role:X_WINDOW_ROLE_FRAME];
+
+        /* Save the *decoration* of the new frame. Not at draw time:
+           that's deferred to the end of the batch, and update_frame
+           may look at this again before then. */
+        _drawn_frame_decor = [self get_xp_frame_class] & XP_FRAME_CLASS_DECOR_MASK;
     }
 
     [self update_shape];
 
-    BEFORE_LOCAL_MAP; // _frame_border_width
-    XReparentWindow (x_dpy, _id, _frame_id, 0, _frame_title_height);
-    XLowerWindow (x_dpy, _id);
-    AFTER_LOCAL_MAP;
+    {
+        /* Only a mapped window is unmapped and mapped again around the
+           reparent, and lowering it only restacks it if the frame has
+           other children already. Expecting events that never come
+           would swallow the client's own. */
+        BOOL mapped = !_client_unmapped;
+        BOOL restacked = _tracking_id != 0 || _growbox_id != 0;
+        BEFORE_LOCAL_MAP; // _frame_border_width
+        XReparentWindow (x_dpy, _id, _frame_id, 0, _frame_title_height);
+        XLowerWindow (x_dpy, _id);
+        if (mapped)
+            AFTER_LOCAL_MAP (UnmapNotify);
+        AFTER_LOCAL_MAP (ReparentNotify);
+        if (mapped)
+            AFTER_LOCAL_MAP (MapNotify);
+        if (restacked)
+            AFTER_LOCAL_MAP (ConfigureNotify);
+    }
 
     XAddToSaveSet (x_dpy, _id);
 
@@ -208,6 +261,9 @@ - (void) reparent_in
 
     [self raise];
     [self grab_events];
+
+    /* reparent_out dropped the alarm, e.g. when the frame was swapped */
+    [self update_sync_counter];
 }
 
 - (void) reparent_out {
@@ -230,11 +286,19 @@ - (void) reparent_out {
     }
 
     [self ungrab_events];
+    [self release_sync_alarm];
 
     ir = [self frame_inner_rect:_current_frame];
-    BEFORE_LOCAL_MAP;
-    XReparentWindow(x_dpy, _id, _screen->_root, ir.x, ir.y);
-    AFTER_LOCAL_MAP;
+    {
+        BOOL mapped = !_client_unmapped;
+        BEFORE_LOCAL_MAP;
+        XReparentWindow(x_dpy, _id, _screen->_root, ir.x, ir.y);
+        if (mapped)
+            AFTER_LOCAL_MAP (UnmapNotify);
+        AFTER_LOCAL_MAP (ReparentNotify);
+        if (mapped)
+            AFTER_LOCAL_MAP (MapNotify);
+    }
 
     XSetWindowBorderWidth(x_dpy, _id, _xattr.border_width);
     XRemoveFromSaveSet(x_dpy, _id);
@@ -242,29 +306,37 @@ - (void) reparent_out {
     [self map_unmap_client];
 
     if(_frame_id != 0) {
+        /* Destroying the frame takes its subwindows with it. */
+        if (_tracking_id != 0)
+            [_screen unindex_window:_tracking_id];
+        if (_growbox_id != 0)
+            [_screen unindex_window:_growbox_id];
+        [_screen unindex_window:_frame_id];
+
         XDestroyWindow (x_dpy, _frame_id);
         _frame_id = 0;
+        frame_draw_state_reset (&_frame_draw_state);
+        _set_shape = NO;	/* the next frame starts out unshaped */
         _tracking_id = 0;
         _growbox_id = 0;
-        _osx_id = XP_NULL_NATIVE_WINDOW_ID;
+        [self set_osx_id:XP_NULL_NATIVE_WINDOW_ID];
     }
 
     /* Mark us as not transient of a parent */
     if(_transient_for) {
-        _transient_for->_transients = x_list_remove(_transient_for->_transients, self);
+        x_chain_remove(&_transient_for->_transients, &_transient_node);
         _transient_for = NULL;
     }
 
     /* Update our children to not be transient for us */
-    if(_transients) {
-        x_list *node;
-        for(node = _transients; node; node = node->next) {
+    if(_transients.head) {
+        x_chain_node *node;
+        for(node = _transients.head; node; node = node->next) {
             x_window *child = node->data;
             child->_transient_for = NULL;
         }
 
-        x_list_free(_transients);
-        _transients = NULL;
+        x_chain_clear(&_transients);
     }
 
     _reparented = NO;
@@ -359,7 +431,12 @@ - (void) place_window {
         /* Document style placement. Find the topmost document window
          * in the group, then place ourselves down and to the right of it.
          */
-        if (order == NULL)
+        if (order == NULL && smart_placement)
+        {
+            /* Wherever there's the most room, on any head */
+            r = [_screen least_overlapped_rect:r];
+        }
+        else if (order == NULL)
         {
             /* No group members. Place ourselves below the menubar. */
             X11Rect zoom_rect = [_screen zoomed_rect];
@@ -491,23 +568,30 @@ - (X11Rect)construct_frame_from_winrect:(X11Rect) winrect {
 
     _id = xwindow_id;
     _screen = screen;
+    x_chain_node_init (&_window_node, self);
+    x_stack_node_init (&_stack_node, self);
+    x_grid_item_init (&_grid_item, self);
 
     _drawn_frame_decor = 0;
     _current_frame = X11EmptyRect;
 
     _transient_for = NULL;
     _transient_for_id = _screen->_root;
-    _transients = NULL;
+    x_chain_init (&_transients);
+    x_chain_node_init (&_transient_node, self);
 
     _fullscreen = NO;
+    _window_menu_index = -1;
 
     DB ("initializing: %s", flag ? "YES" : "NO");
 
     XSelectInput(x_dpy, _id, X_CLIENT_WINDOW_EVENTS);
     XShapeSelectInput(x_dpy, _id, ShapeNotifyMask);
+    x_property_cache_watch (_id);
 
     /* Get the initial attr of the child window */
-    XGetWindowAttributes(x_dpy, _id, &_xattr);
+    x_get_window_attributes (_id, &_xattr);
+    _client_unmapped = _xattr.map_state == IsUnmapped;
 
     /* Get unmutable hints from attributes on the window */
     [self update_shaped];
@@ -595,6 +679,7 @@ - (void) do_resize:(X11Rect)r
     /* The window is not yet mapped, so just adjust _current_frame */
     if(!_reparented) {
         _current_frame = r;
+        x_grid_move (&_screen->_grid, &_grid_item, r);
         [self update_net_wm_state_property];
         return;
     }
@@ -643,11 +728,16 @@ - (void) resize_frame:(X11Rect)r force:(BOOL)flag {
         if(!flag && X11RectEqualToRect(_current_frame, fr))
             return;
 
-        [self do_resize:fr];
-        return;
+        /* Moving doesn't need the client to redraw */
+        if(!_sync_waiting || (!_queued_frame_change
+                              && _current_frame.width == fr.width
+                              && _current_frame.height == fr.height)) {
+            [self do_resize:fr];
+            return;
+        }
     }
 
-    if(!_queued_frame_change) {
+    if(_pending_frame_change && !_queued_frame_change) {
         if(!flag && _pending_frame.width == r.width && _pending_frame.height == r.height) {
             if(_pending_frame.x == r.x && _pending_frame.y == r.y)
                 return;
@@ -695,39 +785,59 @@ - (void) report_frame_size:(X11Rect)r
         _xattr.width = r.width; // (_frame_border_width << 1);
         _xattr.height = _frame_height - _frame_title_height;
 
-        DISABLE_EVENTS(_id, 0);
-        XResizeWindow(x_dpy, _id, _xattr.width, _xattr.height);
-        ENABLE_EVENTS(_id, X_CLIENT_WINDOW_EVENTS);
+        if(_sync_alarm != None)
+            [self send_sync_request];
+
+        {
+            BEFORE_LOCAL_MAP;
+            XResizeWindow(x_dpy, _id, _xattr.width, _xattr.height);
+            AFTER_LOCAL_MAP (ConfigureNotify);
+        }
 
         resized = YES;
     }
 
     _current_frame = r;
+    x_grid_move (&_screen->_grid, &_grid_item, r);
     [self update_net_wm_state_property];
 
-    if(moved && !resized)
-        [self send_configure];
+    if(moved && !resized) {
+        /* Clients only need to know where they ended up after an
+           interactive move, not every step of the way. */
+        if(_interactive)
+            _interactive_moved = YES;
+        else
+            [self send_configure];
+    }
 
     if(_pending_frame_change) {
         _pending_frame_change = NO;
 
-        if(_queued_frame_change) {
-            X11Rect fr;
+        /* If the client is still drawing, sync_finished does this */
+        if(!_sync_waiting)
+            [self flush_queued_frame];
+    }
 
-            fr = _queued_frame;
+    if (!_pending_frame_change && _pending_decorate)
+        [self decorate];
+}
 
-            if(_shaded) {
-                fr.height = _frame_title_height;
-                _frame_height = r.height;
-            }
+- (void) flush_queued_frame
+{
+    X11Rect fr;
 
-            _queued_frame_change = NO;
-            [self do_resize:fr];
-        }
+    if(_pending_frame_change || !_queued_frame_change)
+        return;
+
+    fr = _queued_frame;
+
+    if(_shaded) {
+        fr.height = _frame_title_height;
+        _frame_height = _current_frame.height;
     }
 
-    if (!_pending_frame_change && _pending_decorate)
-        [self decorate];
+    _queued_frame_change = NO;
+    [self do_resize:fr];
 }
 
 - (void) resize_client:(X11Rect)r {
@@ -857,6 +967,7 @@ - (void) update_inner_windows:(BOOL)reposition outer:(X11Rect)or inner:(X11Rect)
                                       CWOverrideRedirect, &attr);
         XMapRaised (x_dpy, _tracking_id);
         XSelectInput (x_dpy, _tracking_id, X_TRACKING_WINDOW_EVENTS);
+        [_screen index_window:self id:_tracking_id role:X_WINDOW_ROLE_TRACKING];
     }
 
     if (_growbox_id == 0 && !_shaded && _resizable &&
@@ -886,39 +997,40 @@ - (void) update_inner_windows:(BOOL)reposition outer:(X11Rect)or inner:(X11Rect)
                                      attr_mask, &attr);
         XMapRaised (x_dpy, _growbox_id);
         XSelectInput (x_dpy, _growbox_id, X_GROWBOX_WINDOW_EVENTS);
+        [_screen index_window:self id:_growbox_id role:X_WINDOW_ROLE_GROWBOX];
     }
     else if (_growbox_id != 0 && (_shaded || !_resizable || !XP_FRAME_ATTR_IS_SET (_frame_attr, XP_FRAME_ATTR_GROW_BOX)))
     {
+        [_screen unindex_window:_growbox_id];
         XDestroyWindow (x_dpy, _growbox_id);
         _growbox_id = 0;
     }
     else if (_growbox_id != 0 && reposition)
     {
-#ifdef MORE_ROUNDTRIPS
-        _growbox_rect = frame_growbox_rect (or, ir, [self get_xp_frame_class]);
-#else
-        _growbox_rect.x = or.width - _growbox_rect.width;
-        _growbox_rect.y = or.height - _growbox_rect.height;
-#endif
-        XMoveResizeWindow (x_dpy, _growbox_id,
-                           _growbox_rect.x,
-                           _growbox_rect.y,
-                           _growbox_rect.width,
-                           _growbox_rect.height);
+        X11Rect gr = frame_growbox_rect (or, ir, [self get_xp_frame_class]);
+
+        if (!X11RectEqualToRect (gr, _growbox_rect))
+        {
+            _growbox_rect = gr;
+            XMoveResizeWindow (x_dpy, _growbox_id,
+                               _growbox_rect.x,
+                               _growbox_rect.y,
+                               _growbox_rect.width,
+                               _growbox_rect.height);
+        }
     }
 }
 
 - (void) update_shaped
 {
-    int xws, yws, xbs, ybs;
-    unsigned int wws, hws, wbs, hbs;
-    int bounding, clip;
+    unsigned int wws = 0, hws = 0;
+    Bool bounding = False;
 
-    XShapeQueryExtents (x_dpy, _id, &bounding, &xws, &yws,
-                        &wws, &hws, &clip, &xbs, &ybs, &wbs, &hbs);
+    x_get_shape_extents (_id, &bounding, &wws, &hws);
 
     _shaped = bounding ? YES : NO;
     _shaped_empty = (bounding && (wws <= 0 || hws <= 0));
+    _shape_changed = YES;
 }
 
 - (void) update_shape:(X11Rect)or
@@ -951,6 +1063,17 @@ - (void) update_shape:(X11Rect)or
             nr = 2;
         }
 
+        /* The frame's shape is the union of these and the client's,
+           so it only has to be rebuilt when one of them changed */
+        if (_set_shape && !_shape_changed
+            && nr == _shape_n_rects
+            && memcmp (r, _shape_rects, nr * sizeof (r[0])) == 0
+            && ir.x == _shape_inner_x && ir.y == _shape_inner_y)
+        {
+            x_shape_requests_avoided += 2;
+            return;
+        }
+
         XShapeCombineRectangles (x_dpy, _frame_id, ShapeBounding,
                                  0, 0, r, nr, ShapeSet, Unsorted);
 
@@ -958,15 +1081,25 @@ - (void) update_shape:(X11Rect)or
                             ir.x, ir.y, _id,
                             ShapeBounding, ShapeUnion);
 
+        x_shape_requests += 2;
+
+        memcpy (_shape_rects, r, nr * sizeof (r[0]));
+        _shape_n_rects = nr;
+        _shape_inner_x = ir.x;
+        _shape_inner_y = ir.y;
+
         _set_shape = YES;
     }
     else if (_set_shape)
     {
         XShapeCombineMask (x_dpy, _frame_id, ShapeBounding,
                            0, 0, None, ShapeSet);
+        x_shape_requests++;
 
         _set_shape = NO;
     }
+
+    _shape_changed = NO;
 }
 
 - (void) update_shape
@@ -975,18 +1108,61 @@ - (void) update_shape
     [self update_shape:[self frame_outer_rect]];
 }
 
-- (xp_native_window_id) get_osx_id
+/* ShapeNotify is answered once per event batch, when the screen calls
+   reshape_now */
+- (void) reshape
+{
+    [_screen queue_reshape:self];
+}
+
+- (void) reshape_now
 {
-    if (_osx_id == XP_NULL_NATIVE_WINDOW_ID) {
-        Window xwindow_id = [self toplevel_id];
-        long data;
+    X11Rect or;
+
+    /* Build it for the size we've asked for, not the one we last saw */
+    if (_pending_frame_change)
+        or = X11RectMake (0, 0, _pending_frame.width, _pending_frame.height);
+    else
+        or = [self frame_outer_rect];
+
+    [self update_shape:or];
+}
 
-        if (x_get_property (xwindow_id, atoms.native_window_id, &data, 1, 1))
-            _osx_id = (xp_native_window_id) data;
+- (void) set_osx_id:(xp_native_window_id)wid
+{
+    if (wid == _osx_id)
+        return;
 
-        DB("Window 0x%lx with frame 0x%lx has a new _osx_id: %u", _id, _frame_id, _osx_id);
+    if (_osx_id != XP_NULL_NATIVE_WINDOW_ID
+        && x_hash_table_lookup (_screen->_osx_index, _osx_id, NULL) == self)
+    {
+        [_screen unindex_osx_id:_osx_id];
     }
 
+    _osx_id = wid;
+
+    if (_osx_id != XP_NULL_NATIVE_WINDOW_ID)
+        [_screen index_window:self osx_id:_osx_id];
+}
+
+- (void) update_osx_id
+{
+    Window xwindow_id = [self toplevel_id];
+    long data;
+
+    if (x_get_property (xwindow_id, atoms.native_window_id, &data, 1, 1))
+        [self set_osx_id:(xp_native_window_id) data];
+    else
+        [self set_osx_id:XP_NULL_NATIVE_WINDOW_ID];
+
+    DB("Window 0x%lx with frame 0x%lx has a new _osx_id: %u", _id, _frame_id, _osx_id);
+}
+
+- (xp_native_window_id) get_osx_id
+{
+    if (_osx_id == XP_NULL_NATIVE_WINDOW_ID)
+        [self update_osx_id];
+
     return _osx_id;
 }
 
@@ -997,17 +1173,16 @@ - (void) set_wm_state:(int)state
     data[0] = state;
     data[1] = 0;			/* icon window */
 
-    XChangeProperty (x_dpy, _id, atoms.wm_state, atoms.wm_state,
-                     32, PropModeReplace, (unsigned char *) data, 2);
+    x_set_property_deferred (_id, atoms.wm_state, atoms.wm_state, data, 2);
 }
 
 /* Don't allow us to close the window if there are modal windows
  * <rdar://problem/5880438> Close widget should be disabled if window has modal children
  */
 - (BOOL) has_modal_descendents {
-    if(_transients) {
-        x_list *node;
-        for(node = _transients; node; node = node->next) {
+    if(_transients.head) {
+        x_chain_node *node;
+        for(node = _transients.head; node; node = node->next) {
             x_window *child = node->data;
             if(child->_modal) {
                 return YES;
@@ -1039,17 +1214,22 @@ - (void) decorate_rect:(X11Rect)or
         frame_attr &= ~XP_FRAME_ATTR_CLOSE_BOX;
     }
 
-    /* Save the *decoration* of our last draw */
-    _drawn_frame_decor = [self get_xp_frame_class] & XP_FRAME_CLASS_DECOR_MASK;
-
     draw_frame (_screen->_id, _frame_id, or, ir, [self get_xp_frame_class],
-                frame_attr, (CFStringRef) [self title], _shortcut_index);
+                frame_attr, (CFStringRef) [self title], _shortcut_index,
+                &_frame_draw_state);
 
     _decorated = YES;
     _pending_decorate = NO;
 }
 
+/* Decorations are drawn once per event batch, when the screen calls
+   decorate_now */
 - (void) decorate
+{
+    [_screen queue_decorate:self];
+}
+
+- (void) decorate_now
 {
     if (_pending_frame_change)
     {
@@ -1062,6 +1242,7 @@ - (void) decorate
 
 - (void) expose
 {
+    frame_draw_state_reset (&_frame_draw_state);
     [self decorate];
 }
 
@@ -1083,37 +1264,14 @@ - (NSString *) title
 
 - (void) update_wm_name
 {
-    XTextProperty prop;
     NSString *old, *new_;
 
     old = _title;
 
     new_ = x_get_string_property (_id, atoms.net_wm_name);
 
-    if (new_ == nil && XGetWMName (x_dpy, _id, &prop) && prop.value)
-    {
-        if (prop.nitems > 0)
-        {
-            char **list;
-            int err, count;
-
-            prop.nitems = strlen((char *) prop.value);
-            err = Xutf8TextPropertyToTextList (x_dpy, &prop, &list, &count);
-
-            if (err >= Success)
-            {
-                if (count > 0)
-                {
-                    new_ = [NSString stringWithUTF8String: list[0]];
-                    XFreeStringList (list);
-                }
-            }
-            else
-                new_ = [NSString stringWithUTF8String:(char *) prop.value];
-
-            XFree (prop.value);
-        }
-    }
+    if (new_ == nil)
+        new_ = x_get_text_property (_id, atoms.wm_name);
 
     if (new_ != nil && (old == nil || ![old isEqualToString:new_]))
     {
@@ -1139,8 +1297,10 @@ - (void) update_wm_protocols
 
     _does_wm_take_focus = NO;
     _does_wm_delete_window = NO;
+    _does_net_wm_sync_request = NO;
 
-    if (XGetWMProtocols (x_dpy, _id, &protocols, &n) != 0)
+    if (x_get_id_list_property (_id, atoms.wm_protocols, XA_ATOM,
+                                &protocols, &n) != 0)
     {
         for (i = 0; i < n; i++)
         {
@@ -1148,9 +1308,166 @@ - (void) update_wm_protocols
                 _does_wm_take_focus = YES;
             else if (protocols[i] == atoms.wm_delete_window)
                 _does_wm_delete_window = YES;
+            else if (protocols[i] == atoms.net_wm_sync_request)
+                _does_net_wm_sync_request = YES;
         }
         XFree (protocols);
     }
+
+    [self update_sync_counter];
+}
+
+/* _NET_WM_SYNC_REQUEST: before each resize of the client we ask it to
+   set its counter to a new value once it has redrawn, and an alarm on
+   the counter tells us when it has. Until then further resizes are
+   coalesced into _queued_frame, so a slow client gets resized as fast
+   as it can draw rather than as fast as the pointer moves. */
+
+- (void) update_sync_counter
+{
+    long counter = None;
+    XSyncAlarmAttributes attr;
+    XSyncValue value;
+
+    if (x_have_sync && _does_net_wm_sync_request)
+        x_get_property (_id, atoms.net_wm_sync_request_counter, &counter, 1, 1);
+
+    if ((XSyncCounter) counter == _sync_counter)
+        return;
+
+    [self release_sync_alarm];
+    [self flush_queued_frame];
+    _sync_counter = counter;
+
+    if (_sync_counter == None)
+        return;
+
+    /* Carry on from whatever value the client left it at */
+    x_stats_round_trip ();
+    if (XSyncQueryCounter (x_dpy, _sync_counter, &value))
+    {
+        _sync_value = ((int64_t) XSyncValueHigh32 (value) << 32)
+                      | XSyncValueLow32 (value);
+    }
+    else
+        _sync_value = 0;
+
+    attr.trigger.counter = _sync_counter;
+    attr.trigger.value_type = XSyncAbsolute;
+    attr.trigger.test_type = XSyncPositiveComparison;
+    XSyncIntsToValue (&attr.trigger.wait_value,
+                      (unsigned int) ((_sync_value + 1) & 0xffffffff),
+                      (int) ((_sync_value + 1) >> 32));
+    XSyncIntToValue (&attr.delta, 0);
+    attr.events = True;
+
+    _sync_alarm = XSyncCreateAlarm (x_dpy, XSyncCACounter | XSyncCAValueType
+                                     | XSyncCATestType | XSyncCAValue
+                                     | XSyncCADelta | XSyncCAEvents, &attr);
+    [_screen index_window:self id:_sync_alarm role:X_WINDOW_ROLE_SYNC_ALARM];
+
+    DB("id: 0x%lx counter: 0x%lx alarm: 0x%lx", _id, _sync_counter, _sync_alarm);
+}
+
+- (void) release_sync_alarm
+{
+    if (_sync_alarm != None)
+    {
+        [_screen unindex_window:_sync_alarm];
+        XSyncDestroyAlarm (x_dpy, _sync_alarm);
+        _sync_alarm = None;
+    }
+
+    _sync_counter = None;
+    _sync_waiting = NO;
+    _sync_unresponsive = NO;
+
+    [_sync_timer invalidate];
+    _sync_timer = nil;
+}
+
+- (void) send_sync_request
+{
+    XEvent e;
+    XSyncAlarmAttributes attr;
+
+    _sync_value++;
+
+    e.xclient.type = ClientMessage;
+    e.xclient.window = _id;
+    e.xclient.message_type = atoms.wm_protocols;
+    e.xclient.format = 32;
+    e.xclient.data.l[0] = atoms.net_wm_sync_request;
+    e.xclient.data.l[1] = x_current_timestamp ();
+    e.xclient.data.l[2] = (long) (_sync_value & 0xffffffff);
+    e.xclient.data.l[3] = (long) (_sync_value >> 32);
+    e.xclient.data.l[4] = 0;
+
+    XSendEvent (x_dpy, _id, False, 0, &e);
+
+    XSyncIntsToValue (&attr.trigger.wait_value,
+                      (unsigned int) (_sync_value & 0xffffffff),
+                      (int) (_sync_value >> 32));
+    XSyncChangeAlarm (x_dpy, _sync_alarm, XSyncCAValue, &attr);
+
+    x_sync_requests++;
+
+    /* Still resize a client that stopped answering, just don't wait */
+    if (_sync_unresponsive)
+        return;
+
+    _sync_waiting = YES;
+
+    [_sync_timer invalidate];
+    _sync_timer = [NSTimer scheduledTimerWithTimeInterval:SYNC_REQUEST_TIMEOUT
+                                                   target:self
+                                                 selector:@selector(sync_timed_out:)
+                                                 userInfo:nil repeats:NO];
+}
+
+- (void) sync_finished
+{
+    _sync_waiting = NO;
+
+    [_sync_timer invalidate];
+    _sync_timer = nil;
+
+    [self flush_queued_frame];
+}
+
+- (void) sync_alarm_notify:(XSyncAlarmNotifyEvent *)e
+{
+    int64_t value;
+
+    if (e->state == XSyncAlarmDestroyed)
+        return;
+
+    value = ((int64_t) XSyncValueHigh32 (e->counter_value) << 32)
+            | XSyncValueLow32 (e->counter_value);
+
+    /* An answer to an earlier request we've since superseded */
+    if (value < _sync_value)
+        return;
+
+    _sync_unresponsive = NO;
+
+    if (_sync_waiting)
+        [self sync_finished];
+}
+
+- (void) sync_timed_out:(NSTimer *)timer
+{
+    _sync_timer = nil;
+
+    if (_deleted || !_sync_waiting)
+        return;
+
+    DB("id: 0x%lx didn't answer sync request %lld", _id, (long long) _sync_value);
+
+    x_sync_timeouts++;
+    _sync_unresponsive = YES;
+    [self sync_finished];
+    XFlush (x_dpy);
 }
 
 - (void) update_wm_hints
@@ -1158,12 +1475,12 @@ - (void) update_wm_hints
     if (_wm_hints != NULL)
         XFree (_wm_hints);
 
-    _wm_hints = XGetWMHints (x_dpy, _id);
+    _wm_hints = x_get_wm_hints (_id);
 }
 
 - (void) update_size_hints
 {
-    XGetWMNormalHints (x_dpy, _id, &_size_hints, &_size_hints_supplied);
+    x_get_wm_normal_hints (_id, &_size_hints, &_size_hints_supplied);
 
     if ((_size_hints.flags & (PMinSize | PMaxSize)) == (PMinSize | PMaxSize) &&
         _size_hints.min_width >= _size_hints.max_width &&
@@ -1434,9 +1751,8 @@ - (void) update_net_wm_state_property
     if(_frame_behavior == XP_FRAME_CLASS_BEHAVIOR_STATIONARY)
         _atoms[n_atoms++] = atoms.net_wm_state_sticky;
 
-    XChangeProperty (x_dpy, _id, atoms.net_wm_state,
-                     atoms.atom, 32, PropModeReplace, (unsigned char *) _atoms,
-                     n_atoms);
+    x_set_property_deferred (_id, atoms.net_wm_state, atoms.atom,
+                             _atoms, n_atoms);
 }
 
 - (void) do_net_wm_state_change:(int)mode atom:(Atom)state
@@ -1516,8 +1832,8 @@ - (void) update_net_wm_action_property
         _atoms[n_atoms++] = atoms.net_wm_action_close;
     }
 
-    XChangeProperty (x_dpy, _id, atoms.net_wm_allowed_actions, atoms.atom,
-                     32, PropModeReplace, (unsigned char *) _atoms, n_atoms);
+    x_set_property_deferred (_id, atoms.net_wm_allowed_actions, atoms.atom,
+                             _atoms, n_atoms);
 }
 
 - (void) update_motif_hints
@@ -1628,6 +1944,9 @@ - (void) update_frame
             [self reparent_out];
             [self reparent_in];
 
+            /* The new frame has a new native window. */
+            [self update_osx_id];
+
             if(need_resize_frame)
                 [self resize_frame:new_frame_size force:YES];
 
@@ -1635,6 +1954,10 @@ - (void) update_frame
             if(_reparented)
                 XMapWindow(x_dpy, _frame_id);
 
+            /* The new frame went in on top of everything, not just of
+               its level, which may also have changed. */
+            [_screen restack_window:self];
+
             /* If we are focused, we need to re-acquire input focus after changing fullscreen
              * status because we have a new frame_id */
             if(_focused)
@@ -1643,6 +1966,7 @@ - (void) update_frame
             XAppleWMSetWindowLevel(x_dpy, _frame_id, _level);
         } else if(_level != old_level) {
             XAppleWMSetWindowLevel(x_dpy, _frame_id, _level);
+            [_screen restack_window:self];
         }
 
         [self decorate];
@@ -1662,7 +1986,7 @@ - (void) update_parent
 
         /* Remove this window from the parent's transient list */
         if(_transient_for) {
-            _transient_for->_transients = x_list_remove(_transient_for->_transients, self);
+            x_chain_remove(&_transient_for->_transients, &_transient_node);
         }
 
         /* Set our local state */
@@ -1675,7 +1999,7 @@ - (void) update_parent
             _transient_for = NULL;
         } else {
             /* Update the parent's transients */
-            _transient_for->_transients = x_list_prepend(_transient_for->_transients, self);
+            x_chain_prepend(&_transient_for->_transients, &_transient_node);
         }
     }
 
@@ -1692,12 +2016,21 @@ - (void) update_parent
 
 - (void) update_group
 {
+    Window group_id;
+
     if (_wm_hints != NULL && (_wm_hints->flags & WindowGroupHint) != 0)
-        _group_id = _wm_hints->window_group;
+        group_id = _wm_hints->window_group;
     else if (_transient_for)
-        _group_id = _transient_for->_group_id;
+        group_id = _transient_for->_group_id;
     else
-        _group_id = _id;
+        group_id = _id;
+
+    if (_grouped && group_id == _group_id)
+        return;
+
+    [_screen ungroup_window:self];
+    _group_id = group_id;
+    [_screen group_window:self];
 }
 
 - (void) property_changed:(Atom)atom
@@ -1718,17 +2051,19 @@ - (void) property_changed:(Atom)atom
         [self update_frame]; // calls [self update_size_hints]
     } else if(atom == atoms.wm_protocols) {
         [self update_wm_protocols];
+    } else if(atom == atoms.net_wm_sync_request_counter) {
+        [self update_sync_counter];
     } else if (atom == atoms.native_window_id) {
-        _osx_id = XP_NULL_NATIVE_WINDOW_ID;
+        [self update_osx_id];
 
         /* XAppleWMAttachTransient needs to be called again when the native_window_id changes
          *
          * TODO: Handle this in the server? Xplugin?
          */
         [self update_parent];
-        if(_transients) {
-            x_list *node;
-            for(node = _transients; node; node = node->next) {
+        if(_transients.head) {
+            x_chain_node *node;
+            for(node = _transients.head; node; node = node->next) {
                 x_window *child = node->data;
                 [child update_parent];
             }
@@ -1738,81 +2073,46 @@ - (void) property_changed:(Atom)atom
     }
 }
 
-- (BOOL) my_dialog:(x_window *)w {
-    x_window *ptr, *next;
-    x_list *seen = NULL;
-    BOOL ret = NO;
++ (unsigned int) new_visit_stamp
+{
+    static unsigned int stamp;
 
-    for (ptr = w; ptr != NULL && ptr->_transient_for; ptr = next) {
-        if (ptr->_transient_for == self) {
-            ret = YES;
-            break;
-        }
+    /* Zero is what every window starts with */
+    if (++stamp == 0)
+        ++stamp;
 
-        if(x_list_find(seen, ptr))
-            break;
+    return stamp;
+}
+
+/* Is W transient for us, directly or not? */
+- (BOOL) my_dialog:(x_window *)w {
+    x_window *ptr;
+    unsigned int stamp = [x_window new_visit_stamp];
+
+    /* WM_TRANSIENT_FOR can form cycles, so stop at a window seen before */
+    for (ptr = w; ptr != NULL && ptr->_visit_stamp != stamp;
+         ptr = ptr->_transient_for) {
+        ptr->_visit_stamp = stamp;
 
-        seen = x_list_prepend (seen, ptr);
-        next = ptr->_transient_for;
+        if (ptr->_transient_for == self)
+            return YES;
     }
 
-    x_list_free(seen);
-    return ret;
+    return NO;
 }
 
+/* Every window connected to us through WM_TRANSIENT_FOR: the tree
+   containing us, found by walking up to its root and back down. */
 - (x_list *) transient_group {
-    x_list *group, *node, *ptr;
-    BOOL again;
-
-    /* FIXME: this "algorithm" sucks */
-
-    group = x_list_prepend(NULL, self);
-
-    do {
-        again = NO;
-
-        for(node = _screen->_window_list; node != NULL; node = node->next) {
-            x_window *w = node->data;
-
-            if(x_list_find(group, w))
-                continue;
-
-            if(w->_transient_for && x_list_find(group, w->_transient_for)) {
-                group = x_list_prepend(group, w);
-                again = YES;
-            } else {
-                for (ptr = group; ptr != NULL; ptr = ptr->next) {
-                    x_window *p = ptr->data;
-                    if(p->_transient_for == w) {
-                        group = x_list_prepend(group, w);
-                        again = YES;
-                        break;
-                    }
-                }
-            }
-        }
-    } while (again);
+    unsigned int up_stamp = [x_window new_visit_stamp];
 
-    return group;
+    return x_tree_collect (self, &transient_tree_ops, up_stamp,
+                           [x_window new_visit_stamp]);
 }
 
 - (x_list *) window_group
 {
-    x_list *group, *node;
-
-    group = NULL;
-
-    for (node = _screen->_window_list; node != NULL; node = node->next)
-    {
-        x_window *w = node->data;
-
-        if (w->_group_id == _group_id)
-        {
-            group = x_list_prepend (group, w);
-        }
-    }
-
-    return group;
+    return x_list_copy ([_screen group_members:_group_id]);
 }
 
 - (void) raise
@@ -1983,8 +2283,8 @@ - (void) x_focus_in
     x_set_active_window (self);
 
     data = _id;
-    [_screen set_root_property:"_NET_ACTIVE_WINDOW"
-                          type:"WINDOW" length:1 data:&data];
+    [_screen set_root_property:atoms.net_active_window
+                          type:XA_WINDOW length:1 data:&data];
 }
 
 - (void) x_focus_out
@@ -2035,8 +2335,9 @@ - (void) dealloc {
     if(_shortcut_index != 0)
         x_release_window_shortcut (_shortcut_index);
 
-    if(_transients)
-        x_list_free(_transients);
+    x_chain_clear(&_transients);
+
+    frame_draw_state_free (&_frame_draw_state);
 
     [super dealloc];
 }
@@ -2071,16 +2372,21 @@ - (void) map_unmap_client
     {
         BEFORE_LOCAL_MAP;
         XUnmapWindow (x_dpy, _id);
-        AFTER_LOCAL_MAP;
+        AFTER_LOCAL_MAP (UnmapNotify);
     }
     else if (!unmapped && _client_unmapped)
     {
         BEFORE_LOCAL_MAP;
         XMapWindow (x_dpy, _id);
-        AFTER_LOCAL_MAP;
+        AFTER_LOCAL_MAP (MapNotify);
     }
 
     _client_unmapped = unmapped;
+
+    /* Nothing can be seen of a hidden or minimized window, so it
+       shouldn't keep new windows from being placed where it was */
+    x_grid_set_covering (&_screen->_grid, &_grid_item,
+                         !(_hidden || _minimized));
 }
 
 - (void) do_close:(Time)timestamp
@@ -2608,13 +2914,31 @@ - (void) remove_resizing_title
     }
 }
 
+- (void) begin_interactive
+{
+    _interactive = YES;
+    _interactive_moved = NO;
+}
+
+- (void) end_interactive
+{
+    _interactive = NO;
+
+    /* If a change is still in flight, report_frame_size: will tell the
+       client when it lands. */
+    if (_interactive_moved && !_pending_frame_change)
+        [self send_configure];
+
+    _interactive_moved = NO;
+}
+
 - (void) update_colormaps
 {
     if (_n_colormap_windows > 0)
         XFree (_colormap_windows);
 
-    if (!XGetWMColormapWindows (x_dpy, _id, &_colormap_windows,
-                                &_n_colormap_windows))
+    if (!x_get_id_list_property (_id, atoms.wm_colormap_windows, XA_WINDOW,
+                                 &_colormap_windows, &_n_colormap_windows))
     {
         _n_colormap_windows = 0;
     }
@@ -2633,6 +2957,7 @@ - (void) install_colormaps
     {
         for (i = _n_colormap_windows - 1; i >= 0; i--)
         {
+            x_stats_round_trip ();
             XGetWindowAttributes (x_dpy, _colormap_windows[i], &attr);
             XInstallColormap (x_dpy, attr.colormap);
 
@@ -2643,6 +2968,7 @@ - (void) install_colormaps
 
     if (!done_this_one)
     {
+        x_stats_round_trip ();
         XGetWindowAttributes (x_dpy, _id, &attr);
         XInstallColormap (x_dpy, attr.colormap);
     }